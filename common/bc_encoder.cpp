@@ -0,0 +1,734 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bc_encoder.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BC_ENCODER_SSE 1
+#endif
+
+
+namespace {
+
+// 4x4 pixels, one array per channel (r, g, b, a) in [0,255]
+struct alignas(16) Block
+{
+  float c[4][16];
+};
+
+struct QualitySettings
+{
+  uint32_t powerIterations;
+  uint32_t refinePasses;
+  bool     allPBits;  // BC7: try the 4 p-bit combinations instead of the closest one per endpoint
+};
+
+QualitySettings settings(BcEncoder::Quality quality)
+{
+  switch(quality)
+  {
+    case BcEncoder::Quality::eFast:
+      return {2, 0, false};
+    case BcEncoder::Quality::eNormal:
+      return {4, 1, false};
+    default:
+      return {8, 3, true};
+  }
+}
+
+// Position of each palette index between endpoint 0 and endpoint 1
+const float kBc1Weights[4]   = {0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+const float kAlphaWeights[8] = {0.f, 1.f, 1.f / 7.f, 2.f / 7.f, 3.f / 7.f, 4.f / 7.f, 5.f / 7.f, 6.f / 7.f};
+const int   kBc7Weights[16]  = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, Block& block)
+{
+  for(uint32_t y = 0; y < 4; y++)
+  {
+    const uint32_t sy = std::min(by * 4 + y, height - 1);
+    for(uint32_t x = 0; x < 4; x++)
+    {
+      const uint8_t* p = rgba + (size_t(sy) * width + std::min(bx * 4 + x, width - 1)) * 4;
+      for(uint32_t c = 0; c < 4; c++)
+        block.c[c][y * 4 + x] = p[c];
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Best palette entry of each pixel, with the per-channel `weights` of the distance.
+// Returns the total weighted squared error.
+//
+float fitIndices(const Block& block,
+                 const float (*palette)[4],
+                 uint32_t     nbEntries,
+                 const float  weights[4],
+                 uint8_t      indices[16])
+{
+#ifdef BC_ENCODER_SSE
+  __m128 total = _mm_setzero_ps();
+  for(uint32_t g = 0; g < 16; g += 4)
+  {
+    __m128 c[4];
+    for(uint32_t ch = 0; ch < 4; ch++)
+      c[ch] = _mm_load_ps(&block.c[ch][g]);
+
+    __m128  best    = _mm_set1_ps(FLT_MAX);
+    __m128i bestIdx = _mm_setzero_si128();
+    for(uint32_t i = 0; i < nbEntries; i++)
+    {
+      __m128 d = _mm_setzero_ps();
+      for(uint32_t ch = 0; ch < 4; ch++)
+      {
+        if(weights[ch] == 0.f)
+          continue;
+        __m128 diff = _mm_sub_ps(c[ch], _mm_set1_ps(palette[i][ch]));
+        d           = _mm_add_ps(d, _mm_mul_ps(_mm_mul_ps(diff, diff), _mm_set1_ps(weights[ch])));
+      }
+      __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+      best           = _mm_min_ps(d, best);
+      bestIdx = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(int(i))), _mm_andnot_si128(closer, bestIdx));
+    }
+    total = _mm_add_ps(total, best);
+
+    alignas(16) int32_t idx[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(idx), bestIdx);
+    for(uint32_t k = 0; k < 4; k++)
+      indices[g + k] = static_cast<uint8_t>(idx[k]);
+  }
+  alignas(16) float sums[4];
+  _mm_store_ps(sums, total);
+  return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+  float total = 0.f;
+  for(uint32_t p = 0; p < 16; p++)
+  {
+    float best = FLT_MAX;
+    for(uint32_t i = 0; i < nbEntries; i++)
+    {
+      float d = 0.f;
+      for(uint32_t ch = 0; ch < 4; ch++)
+      {
+        float diff = block.c[ch][p] - palette[i][ch];
+        d += diff * diff * weights[ch];
+      }
+      if(d < best)
+      {
+        best       = d;
+        indices[p] = static_cast<uint8_t>(i);
+      }
+    }
+    total += best;
+  }
+  return total;
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+// Endpoints at the extremes of the projection of the pixels on the principal axis, for the
+// channels [first, first + nb)
+//
+void principalEndpoints(const Block& block, uint32_t first, uint32_t nb, uint32_t iterations, float e0[4], float e1[4])
+{
+  float mean[4] = {};
+  for(uint32_t k = 0; k < nb; k++)
+  {
+    for(uint32_t p = 0; p < 16; p++)
+      mean[k] += block.c[first + k][p];
+    mean[k] /= 16.f;
+  }
+
+  float cov[4][4] = {};
+  for(uint32_t p = 0; p < 16; p++)
+  {
+    float d[4];
+    for(uint32_t k = 0; k < nb; k++)
+      d[k] = block.c[first + k][p] - mean[k];
+    for(uint32_t j = 0; j < nb; j++)
+      for(uint32_t k = 0; k < nb; k++)
+        cov[j][k] += d[j] * d[k];
+  }
+
+  // Power iteration, started from the row of the channel with the largest variance
+  uint32_t start = 0;
+  for(uint32_t k = 1; k < nb; k++)
+    start = cov[k][k] > cov[start][start] ? k : start;
+  float axis[4] = {};
+  for(uint32_t k = 0; k < nb; k++)
+    axis[k] = cov[start][k];
+  for(uint32_t it = 0; it < iterations; it++)
+  {
+    float next[4] = {}, norm = 0.f;
+    for(uint32_t j = 0; j < nb; j++)
+    {
+      for(uint32_t k = 0; k < nb; k++)
+        next[j] += cov[j][k] * axis[k];
+      norm = std::max(norm, std::abs(next[j]));
+    }
+    if(norm < 1e-6f)
+      break;
+    for(uint32_t k = 0; k < nb; k++)
+      axis[k] = next[k] / norm;
+  }
+
+  float axisLength2 = 0.f;
+  for(uint32_t k = 0; k < nb; k++)
+    axisLength2 += axis[k] * axis[k];
+
+  float tMin = 0.f, tMax = 0.f;
+  if(axisLength2 > 1e-12f)
+  {
+    tMin = FLT_MAX;
+    tMax = -FLT_MAX;
+    for(uint32_t p = 0; p < 16; p++)
+    {
+      float t = 0.f;
+      for(uint32_t k = 0; k < nb; k++)
+        t += (block.c[first + k][p] - mean[k]) * axis[k];
+      tMin = std::min(tMin, t);
+      tMax = std::max(tMax, t);
+    }
+    tMin /= axisLength2;
+    tMax /= axisLength2;
+  }
+  for(uint32_t k = 0; k < nb; k++)
+  {
+    e0[first + k] = std::min(std::max(mean[k] + tMin * axis[k], 0.f), 255.f);
+    e1[first + k] = std::min(std::max(mean[k] + tMax * axis[k], 0.f), 255.f);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Least squares endpoints for fixed indices: minimizes sum |(1-t) e0 + t e1 - x|^2
+// Returns false when all pixels use the same position (singular system).
+//
+bool refineEndpoints(const Block&  block,
+                     const uint8_t indices[16],
+                     const float*  positions,
+                     uint32_t      first,
+                     uint32_t      nb,
+                     float         e0[4],
+                     float         e1[4])
+{
+  float a = 0.f, b = 0.f, c = 0.f, r0[4] = {}, r1[4] = {};
+  for(uint32_t p = 0; p < 16; p++)
+  {
+    const float t = positions[indices[p]];
+    const float s = 1.f - t;
+    a += s * s;
+    b += s * t;
+    c += t * t;
+    for(uint32_t k = 0; k < nb; k++)
+    {
+      r0[k] += s * block.c[first + k][p];
+      r1[k] += t * block.c[first + k][p];
+    }
+  }
+  const float det = a * c - b * b;
+  if(std::abs(det) < 1e-6f)
+    return false;
+  for(uint32_t k = 0; k < nb; k++)
+  {
+    e0[first + k] = std::min(std::max((c * r0[k] - b * r1[k]) / det, 0.f), 255.f);
+    e1[first + k] = std::min(std::max((a * r1[k] - b * r0[k]) / det, 0.f), 255.f);
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// BC1 color block
+//
+uint16_t pack565(const float c[4])
+{
+  uint32_t r = static_cast<uint32_t>(c[0] * 31.f / 255.f + 0.5f);
+  uint32_t g = static_cast<uint32_t>(c[1] * 63.f / 255.f + 0.5f);
+  uint32_t b = static_cast<uint32_t>(c[2] * 31.f / 255.f + 0.5f);
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+// Palette as decoded, the encoder matches against the exact decoded colors
+void bc1Palette(uint16_t c0, uint16_t c1, bool fourColors, uint8_t palette[4][4])
+{
+  const uint16_t c[2] = {c0, c1};
+  for(int i = 0; i < 2; i++)
+  {
+    uint32_t r    = (c[i] >> 11) & 31, g = (c[i] >> 5) & 63, b = c[i] & 31;
+    palette[i][0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+    palette[i][1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+    palette[i][2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+    palette[i][3] = 255;
+  }
+  for(int ch = 0; ch < 3; ch++)
+  {
+    const uint32_t a = palette[0][ch], b = palette[1][ch];
+    palette[2][ch]   = static_cast<uint8_t>(fourColors ? (2 * a + b + 1) / 3 : (a + b + 1) / 2);
+    palette[3][ch]   = static_cast<uint8_t>(fourColors ? (a + 2 * b + 1) / 3 : 0);
+  }
+  palette[2][3] = 255;
+  palette[3][3] = fourColors ? 255 : 0;
+}
+
+void encodeColorBlock(const Block& block, const QualitySettings& quality, uint8_t* out)
+{
+  const float channelWeights[4] = {1.f, 1.f, 1.f, 0.f};
+
+  float e0[4] = {}, e1[4] = {};
+  principalEndpoints(block, 0, 3, quality.powerIterations, e0, e1);
+
+  uint16_t bestC0 = 0, bestC1 = 0;
+  uint8_t  bestIndices[16] = {};
+  float    bestError       = FLT_MAX;
+  for(uint32_t pass = 0; pass <= quality.refinePasses; pass++)
+  {
+    uint16_t c0 = pack565(e0), c1 = pack565(e1);
+    if(c0 < c1)
+      std::swap(c0, c1);
+
+    // c0 == c1 would select the 3-color mode, where index 0 is still c0
+    uint8_t palette8[4][4];
+    bc1Palette(c0, c1, true, palette8);
+    float palette[4][4];
+    for(int i = 0; i < 4; i++)
+      for(int ch = 0; ch < 4; ch++)
+        palette[i][ch] = palette8[i][ch];
+
+    uint8_t indices[16];
+    float   error = fitIndices(block, palette, c0 == c1 ? 1 : 4, channelWeights, indices);
+    if(error < bestError)
+    {
+      bestError = error;
+      bestC0    = c0;
+      bestC1    = c1;
+      memcpy(bestIndices, indices, sizeof(indices));
+    }
+    if(pass == quality.refinePasses || error == 0.f || !refineEndpoints(block, indices, kBc1Weights, 0, 3, e0, e1))
+      break;
+  }
+
+  uint32_t bits = 0;
+  for(uint32_t p = 0; p < 16; p++)
+    bits |= uint32_t(bestIndices[p]) << (p * 2);
+  out[0] = static_cast<uint8_t>(bestC0);
+  out[1] = static_cast<uint8_t>(bestC0 >> 8);
+  out[2] = static_cast<uint8_t>(bestC1);
+  out[3] = static_cast<uint8_t>(bestC1 >> 8);
+  memcpy(out + 4, &bits, 4);
+}
+
+void decodeColorBlock(const uint8_t* in, bool alwaysFourColors, uint8_t rgba[16][4])
+{
+  const uint16_t c0 = uint16_t(in[0] | (in[1] << 8));
+  const uint16_t c1 = uint16_t(in[2] | (in[3] << 8));
+  uint8_t        palette[4][4];
+  bc1Palette(c0, c1, alwaysFourColors || c0 > c1, palette);
+  uint32_t bits;
+  memcpy(&bits, in + 4, 4);
+  for(uint32_t p = 0; p < 16; p++)
+    memcpy(rgba[p], palette[(bits >> (p * 2)) & 3], 4);
+}
+
+//--------------------------------------------------------------------------------------------------
+// BC3 alpha block, 8-alpha mode (a0 > a1)
+//
+void alphaPalette(uint32_t a0, uint32_t a1, uint8_t palette[8])
+{
+  palette[0] = static_cast<uint8_t>(a0);
+  palette[1] = static_cast<uint8_t>(a1);
+  if(a0 > a1)
+  {
+    for(uint32_t i = 1; i < 7; i++)
+      palette[i + 1] = static_cast<uint8_t>(((7 - i) * a0 + i * a1 + 3) / 7);
+  }
+  else
+  {
+    for(uint32_t i = 1; i < 5; i++)
+      palette[i + 1] = static_cast<uint8_t>(((5 - i) * a0 + i * a1 + 2) / 5);
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+void encodeAlphaBlock(const Block& block, const QualitySettings& quality, uint8_t* out)
+{
+  const float channelWeights[4] = {0.f, 0.f, 0.f, 1.f};
+
+  float e0[4] = {}, e1[4] = {};
+  e0[3] = *std::max_element(block.c[3], block.c[3] + 16);
+  e1[3] = *std::min_element(block.c[3], block.c[3] + 16);
+
+  uint32_t bestA0 = 0, bestA1 = 0;
+  uint8_t  bestIndices[16] = {};
+  float    bestError       = FLT_MAX;
+  for(uint32_t pass = 0; pass <= quality.refinePasses; pass++)
+  {
+    uint32_t a0 = static_cast<uint32_t>(e0[3] + 0.5f), a1 = static_cast<uint32_t>(e1[3] + 0.5f);
+    if(a0 < a1)
+      std::swap(a0, a1);
+
+    uint8_t palette8[8];
+    alphaPalette(a0, a1, palette8);
+    float palette[8][4] = {};
+    for(int i = 0; i < 8; i++)
+      palette[i][3] = palette8[i];
+
+    uint8_t indices[16];
+    float   error = fitIndices(block, palette, a0 == a1 ? 1 : 8, channelWeights, indices);
+    if(error < bestError)
+    {
+      bestError = error;
+      bestA0    = a0;
+      bestA1    = a1;
+      memcpy(bestIndices, indices, sizeof(indices));
+    }
+    if(pass == quality.refinePasses || error == 0.f || !refineEndpoints(block, indices, kAlphaWeights, 3, 1, e0, e1))
+      break;
+  }
+
+  uint64_t bits = 0;
+  for(uint32_t p = 0; p < 16; p++)
+    bits |= uint64_t(bestIndices[p]) << (p * 3);
+  out[0] = static_cast<uint8_t>(bestA0);
+  out[1] = static_cast<uint8_t>(bestA1);
+  for(uint32_t i = 0; i < 6; i++)
+    out[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+}
+
+void decodeAlphaBlock(const uint8_t* in, uint8_t rgba[16][4])
+{
+  uint8_t palette[8];
+  alphaPalette(in[0], in[1], palette);
+  uint64_t bits = 0;
+  for(uint32_t i = 0; i < 6; i++)
+    bits |= uint64_t(in[2 + i]) << (i * 8);
+  for(uint32_t p = 0; p < 16; p++)
+    rgba[p][3] = palette[(bits >> (p * 3)) & 7];
+}
+
+//--------------------------------------------------------------------------------------------------
+// BC7 mode 6: RGBA endpoints of 7 bits + one p-bit each, 4-bit indices
+//
+struct Bc7Endpoints
+{
+  uint32_t q[2][4];  // 7-bit values
+  uint32_t p[2];     // p-bits
+};
+
+void bc7Palette(const Bc7Endpoints& ep, float palette[16][4])
+{
+  for(uint32_t ch = 0; ch < 4; ch++)
+  {
+    const int v0 = int((ep.q[0][ch] << 1) | ep.p[0]);
+    const int v1 = int((ep.q[1][ch] << 1) | ep.p[1]);
+    for(uint32_t i = 0; i < 16; i++)
+      palette[i][ch] = float(((64 - kBc7Weights[i]) * v0 + kBc7Weights[i] * v1 + 32) >> 6);
+  }
+}
+
+// Quantizes one endpoint with the given p-bit, returns the squared error
+float bc7Quantize(const float e[4], uint32_t pBit, uint32_t q[4])
+{
+  float error = 0.f;
+  for(uint32_t ch = 0; ch < 4; ch++)
+  {
+    int v = int(std::floor((e[ch] - float(pBit)) * 0.5f + 0.5f));
+    q[ch] = uint32_t(std::min(std::max(v, 0), 127));
+    float d = float((q[ch] << 1) | pBit) - e[ch];
+    error += d * d;
+  }
+  return error;
+}
+
+struct BitWriter
+{
+  uint8_t* out;
+  uint32_t pos{0};
+  void     write(uint32_t value, uint32_t nbBits)
+  {
+    for(uint32_t i = 0; i < nbBits; i++, pos++)
+      out[pos >> 3] |= uint8_t(((value >> i) & 1) << (pos & 7));
+  }
+};
+
+struct BitReader
+{
+  const uint8_t* in;
+  uint32_t       pos{0};
+  uint32_t       read(uint32_t nbBits)
+  {
+    uint32_t value = 0;
+    for(uint32_t i = 0; i < nbBits; i++, pos++)
+      value |= uint32_t((in[pos >> 3] >> (pos & 7)) & 1) << i;
+    return value;
+  }
+};
+
+void encodeBc7Block(const Block& block, const QualitySettings& quality, uint8_t* out)
+{
+  const float channelWeights[4] = {1.f, 1.f, 1.f, 1.f};
+  float       positions[16];
+  for(uint32_t i = 0; i < 16; i++)
+    positions[i] = kBc7Weights[i] / 64.f;
+
+  float e0[4], e1[4];
+  principalEndpoints(block, 0, 4, quality.powerIterations, e0, e1);
+
+  Bc7Endpoints best{};
+  uint8_t      bestIndices[16] = {};
+  float        bestError       = FLT_MAX;
+  for(uint32_t pass = 0; pass <= quality.refinePasses; pass++)
+  {
+    // P-bit candidates: all 4 combinations, or the closest p-bit of each endpoint
+    Bc7Endpoints candidates[4];
+    uint32_t     nbCandidates = 0;
+    if(quality.allPBits)
+    {
+      for(uint32_t p = 0; p < 4; p++)
+      {
+        Bc7Endpoints& ep = candidates[nbCandidates++];
+        ep.p[0]          = p & 1;
+        ep.p[1]          = p >> 1;
+        bc7Quantize(e0, ep.p[0], ep.q[0]);
+        bc7Quantize(e1, ep.p[1], ep.q[1]);
+      }
+    }
+    else
+    {
+      Bc7Endpoints& ep   = candidates[nbCandidates++];
+      const float*  e[2] = {e0, e1};
+      for(uint32_t i = 0; i < 2; i++)
+      {
+        uint32_t q0[4], q1[4];
+        bool     one = bc7Quantize(e[i], 1, q1) < bc7Quantize(e[i], 0, q0);
+        ep.p[i]      = one ? 1 : 0;
+        memcpy(ep.q[i], one ? q1 : q0, sizeof(q0));
+      }
+    }
+
+    uint8_t indices[16];
+    float   passError = FLT_MAX;
+    for(uint32_t c = 0; c < nbCandidates; c++)
+    {
+      float palette[16][4];
+      bc7Palette(candidates[c], palette);
+      uint8_t candidateIndices[16];
+      float   error = fitIndices(block, palette, 16, channelWeights, candidateIndices);
+      if(error < passError)
+      {
+        passError = error;
+        memcpy(indices, candidateIndices, sizeof(indices));
+      }
+      if(error < bestError)
+      {
+        bestError = error;
+        best      = candidates[c];
+        memcpy(bestIndices, candidateIndices, sizeof(bestIndices));
+      }
+    }
+    if(pass == quality.refinePasses || passError == 0.f || !refineEndpoints(block, indices, positions, 0, 4, e0, e1))
+      break;
+  }
+
+  // The MSB of the first index is implicit (0): swapping the endpoints mirrors the palette
+  if(bestIndices[0] & 8)
+  {
+    std::swap(best.q[0], best.q[1]);
+    std::swap(best.p[0], best.p[1]);
+    for(auto& index : bestIndices)
+      index = static_cast<uint8_t>(15 - index);
+  }
+
+  memset(out, 0, 16);
+  BitWriter writer{out};
+  writer.write(1 << 6, 7);  // Mode 6
+  for(uint32_t ch = 0; ch < 4; ch++)
+  {
+    writer.write(best.q[0][ch], 7);
+    writer.write(best.q[1][ch], 7);
+  }
+  writer.write(best.p[0], 1);
+  writer.write(best.p[1], 1);
+  writer.write(bestIndices[0], 3);
+  for(uint32_t p = 1; p < 16; p++)
+    writer.write(bestIndices[p], 4);
+}
+
+void decodeBc7Block(const uint8_t* in, uint8_t rgba[16][4])
+{
+  BitReader reader{in};
+  if(reader.read(7) != (1 << 6))
+  {
+    // Not written by encodeBc7Block: magenta, so it shows in the PSNR
+    for(uint32_t p = 0; p < 16; p++)
+    {
+      const uint8_t magenta[4] = {255, 0, 255, 255};
+      memcpy(rgba[p], magenta, 4);
+    }
+    return;
+  }
+
+  Bc7Endpoints ep;
+  for(uint32_t ch = 0; ch < 4; ch++)
+  {
+    ep.q[0][ch] = reader.read(7);
+    ep.q[1][ch] = reader.read(7);
+  }
+  ep.p[0] = reader.read(1);
+  ep.p[1] = reader.read(1);
+
+  float palette[16][4];
+  bc7Palette(ep, palette);
+  for(uint32_t p = 0; p < 16; p++)
+  {
+    uint32_t index = reader.read(p == 0 ? 3 : 4);
+    for(uint32_t ch = 0; ch < 4; ch++)
+      rgba[p][ch] = static_cast<uint8_t>(palette[index][ch]);
+  }
+}
+
+double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Rows of blocks are encoded in parallel
+//
+void BcEncoder::encode(const uint8_t* rgba,
+                       uint32_t       width,
+                       uint32_t       height,
+                       Format         format,
+                       Quality        quality,
+                       uint8_t*       blocks,
+                       ThreadPool&    pool)
+{
+  const uint32_t        blocksX = (width + 3) / 4;
+  const uint32_t        blocksY = (height + 3) / 4;
+  const uint32_t        size    = blockBytes(format);
+  const QualitySettings qs      = settings(quality);
+
+  pool.parallelBatches(blocksY, 4, [&](size_t begin, size_t end) {
+    Block block;
+    for(size_t by = begin; by < end; by++)
+    {
+      for(uint32_t bx = 0; bx < blocksX; bx++)
+      {
+        uint8_t* out = blocks + (by * blocksX + bx) * size;
+        loadBlock(rgba, width, height, bx, static_cast<uint32_t>(by), block);
+        switch(format)
+        {
+          case Format::eBC1:
+            encodeColorBlock(block, qs, out);
+            break;
+          case Format::eBC3:
+            encodeAlphaBlock(block, qs, out);
+            encodeColorBlock(block, qs, out + 8);
+            break;
+          case Format::eBC7:
+            encodeBc7Block(block, qs, out);
+            break;
+        }
+      }
+    }
+  });
+}
+
+void BcEncoder::decode(const uint8_t* blocks, uint32_t width, uint32_t height, Format format, uint8_t* rgba)
+{
+  const uint32_t blocksX = (width + 3) / 4;
+  const uint32_t blocksY = (height + 3) / 4;
+  const uint32_t size    = blockBytes(format);
+  for(uint32_t by = 0; by < blocksY; by++)
+  {
+    for(uint32_t bx = 0; bx < blocksX; bx++)
+    {
+      const uint8_t* in = blocks + (size_t(by) * blocksX + bx) * size;
+      uint8_t        pixels[16][4];
+      switch(format)
+      {
+        case Format::eBC1:
+          decodeColorBlock(in, false, pixels);
+          break;
+        case Format::eBC3:
+          decodeColorBlock(in + 8, true, pixels);
+          decodeAlphaBlock(in, pixels);
+          break;
+        case Format::eBC7:
+          decodeBc7Block(in, pixels);
+          break;
+      }
+      for(uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+        for(uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+          memcpy(rgba + ((size_t(by) * 4 + y) * width + bx * 4 + x) * 4, pixels[y * 4 + x], 4);
+    }
+  }
+}
+
+void BcEncoder::compress(TextureMips& texture, Format format, Quality quality, ThreadPool& pool)
+{
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::vector<size_t> offsets;
+  size_t              total = 0;
+  for(uint32_t level = 0; level < texture.levelCount(); level++)
+  {
+    offsets.push_back(total);
+    total += compressedSize(format, texture.levelWidth(level), texture.levelHeight(level));
+  }
+
+  std::vector<uint8_t> blocks(total);
+  for(uint32_t level = 0; level < texture.levelCount(); level++)
+    encode(texture.data.data() + texture.levelOffsets[level], texture.levelWidth(level), texture.levelHeight(level),
+           format, quality, blocks.data() + offsets[level], pool);
+  texture.compressMs = elapsedMs(start);
+
+  std::vector<uint8_t> decoded(texture.levelSize(0));
+  decode(blocks.data(), texture.width, texture.height, format, decoded.data());
+  const size_t nbPixels = size_t(texture.width) * texture.height;
+  texture.psnr          = psnr(texture.data.data(), decoded.data(), nbPixels, format != Format::eBC1);
+
+  texture.data.swap(blocks);
+  texture.levelOffsets.swap(offsets);
+  texture.blockBytes = blockBytes(format);
+}
+
+double BcEncoder::psnr(const uint8_t* reference, const uint8_t* test, size_t nbPixels, bool withAlpha)
+{
+  const uint32_t nbChannels = withAlpha ? 4 : 3;
+  double         sum        = 0.0;
+  for(size_t p = 0; p < nbPixels; p++)
+  {
+    for(uint32_t ch = 0; ch < nbChannels; ch++)
+    {
+      double d = double(reference[p * 4 + ch]) - double(test[p * 4 + ch]);
+      sum += d * d;
+    }
+  }
+  const double mse = sum / (double(nbPixels) * nbChannels);
+  return mse == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
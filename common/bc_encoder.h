@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "texture_loader.h"
+#include "thread_pool.h"
+
+//--------------------------------------------------------------------------------------------------
+// CPU block compression of RGBA8 images, run when textures are imported (baked)
+// - BC1: opaque RGB, 4-color mode only (8 bytes per 4x4 block)
+// - BC3: BC1 color block + interpolated alpha (16 bytes)
+// - BC7: mode 6 only, one RGBA subset with 16 levels (16 bytes); good on smooth content, less so
+//   on blocks with several distinct colors, which other modes handle
+// Endpoints come from the principal axis of the block, then are refined by least squares on the
+// chosen indices. Palette matching is SSE2, blocks are encoded in parallel.
+// The decoders only support what the encoder writes, they are used for the PSNR check.
+//
+class BcEncoder
+{
+public:
+  enum class Format
+  {
+    eBC1,
+    eBC3,
+    eBC7,
+  };
+
+  // Speed/quality knob: more power iterations, refinement passes and BC7 p-bit trials
+  enum class Quality
+  {
+    eFast,
+    eNormal,
+    eHigh,
+  };
+
+  static uint32_t blockBytes(Format format) { return format == Format::eBC1 ? 8 : 16; }
+  static size_t   compressedSize(Format format, uint32_t width, uint32_t height)
+  {
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+  }
+
+  // Encodes an RGBA8 image, edge blocks repeat the last row/column
+  static void encode(const uint8_t* rgba,
+                     uint32_t       width,
+                     uint32_t       height,
+                     Format         format,
+                     Quality        quality,
+                     uint8_t*       blocks,
+                     ThreadPool&    pool = ThreadPool::global());
+  static void decode(const uint8_t* blocks, uint32_t width, uint32_t height, Format format, uint8_t* rgba);
+
+  // Replaces all levels by their compressed blocks, fills compressMs and psnr (level 0)
+  static void compress(TextureMips& texture, Format format, Quality quality, ThreadPool& pool = ThreadPool::global());
+
+  // Peak signal to noise ratio in dB over RGB, and alpha when `withAlpha`
+  static double psnr(const uint8_t* reference, const uint8_t* test, size_t nbPixels, bool withAlpha);
+};
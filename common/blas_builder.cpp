@@ -0,0 +1,422 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "blas_builder.h"
+#include "nvh/nvprint.hpp"
+
+#include <algorithm>
+
+
+namespace {
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
+
+void BlasBuilder::setup(VkDevice                 device,
+                        nvvk::ResourceAllocator* allocator,
+                        uint32_t                 queueIndex,
+                        VkPhysicalDevice         physicalDevice)
+{
+  m_device = device;
+  m_alloc  = allocator;
+  vkGetDeviceQueue(m_device, queueIndex, 0, &m_queue);
+
+  VkPhysicalDeviceAccelerationStructurePropertiesKHR asProperties{};
+  asProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+  VkPhysicalDeviceProperties2 properties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+  properties.pNext = &asProperties;
+  vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+  m_timestampPeriod  = properties.properties.limits.timestampPeriod;
+  m_scratchAlignment = std::max<VkDeviceSize>(asProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+
+  // Queues without timestamps report build times of 0
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+  if(queueIndex < familyCount && families[queueIndex].timestampValidBits == 0)
+    m_timestampPeriod = 0.f;
+
+  VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  poolInfo.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = queueIndex;
+  vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_cmdPool);
+
+  VkSemaphoreTypeCreateInfo typeInfo{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue  = 0;
+  VkSemaphoreCreateInfo semaphoreInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+  semaphoreInfo.pNext = &typeInfo;
+  vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_timeline);
+  m_value = 0;
+}
+
+void BlasBuilder::destroy()
+{
+  if(m_device == VK_NULL_HANDLE)
+    return;
+
+  clearBlas();
+  vkDestroyCommandPool(m_device, m_cmdPool, nullptr);
+  vkDestroySemaphore(m_device, m_timeline, nullptr);
+  m_cmdPool  = VK_NULL_HANDLE;
+  m_timeline = VK_NULL_HANDLE;
+  m_device   = VK_NULL_HANDLE;
+}
+
+void BlasBuilder::clearBlas()
+{
+  for(size_t i = 0; i < m_blas.size(); i++)
+    destroyAccel(m_blas[i], m_reports[i].compactedSize);
+  m_blas.clear();
+  m_addresses.clear();
+  m_reports.clear();
+  m_batches.clear();
+}
+
+nvvk::AccelKHR BlasBuilder::createAccel(VkDeviceSize size)
+{
+  VkAccelerationStructureCreateInfoKHR createInfo{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
+  createInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+  createInfo.size = size;
+  m_liveBytes += size;
+  m_peakBytes = std::max(m_peakBytes, m_liveBytes);
+  return m_alloc->createAcceleration(createInfo);
+}
+
+void BlasBuilder::destroyAccel(nvvk::AccelKHR& accel, VkDeviceSize size)
+{
+  m_alloc->destroy(accel);
+  m_liveBytes -= size;
+}
+
+VkCommandBuffer BlasBuilder::beginCommandBuffer()
+{
+  VkCommandBufferAllocateInfo allocInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  allocInfo.commandPool        = m_cmdPool;
+  allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  VkCommandBuffer cmdBuf;
+  vkAllocateCommandBuffers(m_device, &allocInfo, &cmdBuf);
+  m_cmdBufs.push_back(cmdBuf);
+
+  VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(cmdBuf, &beginInfo);
+  return cmdBuf;
+}
+
+uint64_t BlasBuilder::submit(VkCommandBuffer cmdBuf)
+{
+  vkEndCommandBuffer(cmdBuf);
+
+  const uint64_t                value = ++m_value;
+  VkTimelineSemaphoreSubmitInfo timelineInfo{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+  timelineInfo.signalSemaphoreValueCount = 1;
+  timelineInfo.pSignalSemaphoreValues    = &value;
+  VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.pNext                = &timelineInfo;
+  submitInfo.commandBufferCount   = 1;
+  submitInfo.pCommandBuffers      = &cmdBuf;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores    = &m_timeline;
+  vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE);
+  return value;
+}
+
+void BlasBuilder::wait(uint64_t value)
+{
+  VkSemaphoreWaitInfo waitInfo{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores    = &m_timeline;
+  waitInfo.pValues        = &value;
+  vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Waits for the builds of the batch, then submits the copies to the compacted structures. They
+// execute after the batch already submitted behind this one.
+//
+void BlasBuilder::compactBatch(Batch& batch, VkQueryPool sizePool)
+{
+  wait(batch.buildValue);
+  const uint32_t count = batch.end - batch.begin;
+  if(sizePool == VK_NULL_HANDLE)
+  {
+    for(uint32_t i = batch.begin; i < batch.end; i++)
+      m_reports[i].compactedSize = m_reports[i].buildSize;
+    return;
+  }
+
+  std::vector<VkDeviceSize> compactSizes(count);
+  vkGetQueryPoolResults(m_device, sizePool, batch.begin, count, compactSizes.size() * sizeof(VkDeviceSize),
+                        compactSizes.data(), sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+  batch.originals.assign(m_blas.begin() + batch.begin, m_blas.begin() + batch.end);
+  VkCommandBuffer cmdBuf = beginCommandBuffer();
+  for(uint32_t i = batch.begin; i < batch.end; i++)
+  {
+    m_reports[i].compactedSize = compactSizes[i - batch.begin];
+    m_blas[i]                  = createAccel(m_reports[i].compactedSize);
+
+    VkCopyAccelerationStructureInfoKHR copyInfo{VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR};
+    copyInfo.src  = batch.originals[i - batch.begin].accel;
+    copyInfo.dst  = m_blas[i].accel;
+    copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+    vkCmdCopyAccelerationStructureKHR(cmdBuf, &copyInfo);
+  }
+  batch.copyValue = submit(cmdBuf);
+}
+
+// Uncompacted structures of the batches whose copies completed
+void BlasBuilder::releaseOriginals(std::vector<Batch>& batches, bool waitAll)
+{
+  uint64_t completed = 0;
+  if(waitAll)
+    wait(completed = m_value);
+  else
+    vkGetSemaphoreCounterValue(m_device, m_timeline, &completed);
+
+  for(Batch& batch : batches)
+  {
+    if(batch.originals.empty() || batch.copyValue > completed)
+      continue;
+    for(uint32_t i = batch.begin; i < batch.end; i++)
+      destroyAccel(batch.originals[i - batch.begin], m_reports[i].buildSize);
+    batch.originals.clear();
+  }
+}
+
+void BlasBuilder::buildBlas(const std::vector<nvvk::RaytracingBuilderKHR::BlasInput>& input,
+                            VkBuildAccelerationStructureFlagsKHR                      flags)
+{
+  clearBlas();
+  const uint32_t nbBlas  = static_cast<uint32_t>(input.size());
+  const bool     compact = (flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR) != 0;
+  if(nbBlas == 0)
+    return;
+  m_blas.resize(nbBlas);
+  m_addresses.resize(nbBlas);
+  m_reports.resize(nbBlas);
+  m_peakBytes = m_liveBytes;
+
+  // Sizes of each structure and of its aligned range of scratch memory
+  std::vector<VkAccelerationStructureBuildGeometryInfoKHR>     buildInfos(nbBlas);
+  std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> ranges(nbBlas);
+  std::vector<VkDeviceSize>                                    scratchSizes(nbBlas);
+  for(uint32_t i = 0; i < nbBlas; i++)
+  {
+    VkAccelerationStructureBuildGeometryInfoKHR& buildInfo = buildInfos[i];
+    buildInfo.sType         = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+    buildInfo.type          = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+    buildInfo.mode          = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    buildInfo.flags         = input[i].flags | flags;
+    buildInfo.geometryCount = static_cast<uint32_t>(input[i].asGeometry.size());
+    buildInfo.pGeometries   = input[i].asGeometry.data();
+    ranges[i]               = input[i].asBuildOffsetInfo.data();
+
+    std::vector<uint32_t> maxPrimCount(input[i].asBuildOffsetInfo.size());
+    for(size_t g = 0; g < maxPrimCount.size(); g++)
+    {
+      maxPrimCount[g] = input[i].asBuildOffsetInfo[g].primitiveCount;
+      m_reports[i].primitiveCount += maxPrimCount[g];
+    }
+    VkAccelerationStructureBuildSizesInfoKHR sizeInfo{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR};
+    vkGetAccelerationStructureBuildSizesKHR(m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo,
+                                            maxPrimCount.data(), &sizeInfo);
+    m_reports[i].buildSize = sizeInfo.accelerationStructureSize;
+    scratchSizes[i]        = alignUp(sizeInfo.buildScratchSize, m_scratchAlignment);
+  }
+
+  // Batches under the budgets, at least one structure each; the scratch buffer fits the largest
+  std::vector<Batch> batches;
+  VkDeviceSize       scratchSize = 0;
+  for(uint32_t begin = 0; begin < nbBlas;)
+  {
+    BatchReport  report;
+    VkDeviceSize resultBytes = 0;
+    uint32_t     end         = begin;
+    while(end < nbBlas
+          && (end == begin
+              || (report.scratchSize + scratchSizes[end] <= m_scratchBudget
+                  && resultBytes + m_reports[end].buildSize <= m_batchBytes)))
+    {
+      report.scratchSize += scratchSizes[end];
+      resultBytes += m_reports[end].buildSize;
+      m_reports[end++].batch = static_cast<uint32_t>(batches.size());
+    }
+    report.firstBlas = begin;
+    report.blasCount = end - begin;
+    scratchSize      = std::max(scratchSize, report.scratchSize);
+    m_batches.push_back(report);
+    Batch batch;
+    batch.begin = begin;
+    batch.end   = end;
+    batches.push_back(batch);
+    begin = end;
+  }
+
+  // Pooled scratch, its start aligned in a buffer over-allocated by the alignment
+  const VkDeviceSize scratchBytes = scratchSize + m_scratchAlignment;
+  nvvk::Buffer       scratch      = m_alloc->createBuffer(scratchBytes, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+                                                                           | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  VkBufferDeviceAddressInfo bufferInfo{VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, nullptr, scratch.buffer};
+  const VkDeviceAddress     scratchAddress =
+      alignUp(vkGetBufferDeviceAddress(m_device, &bufferInfo), m_scratchAlignment);
+  m_liveBytes += scratchBytes;
+  m_peakBytes = std::max(m_peakBytes, m_liveBytes);
+
+  VkQueryPoolCreateInfo queryInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+  VkQueryPool           sizePool{VK_NULL_HANDLE};
+  VkQueryPool           timePool{VK_NULL_HANDLE};
+  if(compact)
+  {
+    queryInfo.queryType  = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+    queryInfo.queryCount = nbBlas;
+    vkCreateQueryPool(m_device, &queryInfo, nullptr, &sizePool);
+  }
+  if(m_timestampPeriod > 0.f)
+  {
+    // For batch b: its start at batches[b].begin + b, then the end of each of its builds
+    queryInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    queryInfo.queryCount = static_cast<uint32_t>(nbBlas + batches.size());
+    vkCreateQueryPool(m_device, &queryInfo, nullptr, &timePool);
+  }
+
+  for(uint32_t b = 0; b < batches.size(); b++)
+  {
+    Batch&          batch     = batches[b];
+    const uint32_t  count     = batch.end - batch.begin;
+    const uint32_t  firstTime = batch.begin + b;
+    VkCommandBuffer cmdBuf    = beginCommandBuffer();
+    if(sizePool != VK_NULL_HANDLE)
+      vkCmdResetQueryPool(cmdBuf, sizePool, batch.begin, count);
+    if(timePool != VK_NULL_HANDLE)
+      vkCmdResetQueryPool(cmdBuf, timePool, firstTime, count + 1);
+
+    // The scratch buffer may still be in use by the previous batch
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    barrier.dstAccessMask =
+        VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+    if(timePool != VK_NULL_HANDLE)
+      vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timePool, firstTime);
+
+    // One command per structure, each in its own scratch range: no barrier between them, so they
+    // can still execute concurrently
+    VkDeviceSize scratchOffset = 0;
+    for(uint32_t i = batch.begin; i < batch.end; i++)
+    {
+      m_blas[i]                               = createAccel(m_reports[i].buildSize);
+      buildInfos[i].dstAccelerationStructure  = m_blas[i].accel;
+      buildInfos[i].scratchData.deviceAddress = scratchAddress + scratchOffset;
+      scratchOffset += scratchSizes[i];
+      vkCmdBuildAccelerationStructuresKHR(cmdBuf, 1, &buildInfos[i], &ranges[i]);
+      if(timePool != VK_NULL_HANDLE)
+        vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timePool, firstTime + 1 + i - batch.begin);
+    }
+
+    // Results read by the size queries, the compaction copies and the next batch
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+    if(sizePool != VK_NULL_HANDLE)
+    {
+      std::vector<VkAccelerationStructureKHR> accels(count);
+      for(uint32_t i = 0; i < count; i++)
+        accels[i] = m_blas[batch.begin + i].accel;
+      vkCmdWriteAccelerationStructuresPropertiesKHR(cmdBuf, count, accels.data(),
+                                                    VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, sizePool,
+                                                    batch.begin);
+    }
+    batch.buildValue = submit(cmdBuf);
+
+    // This batch executes while the previous one is compacted and the next one recorded
+    if(b > 0)
+      compactBatch(batches[b - 1], sizePool);
+    releaseOriginals(batches, false);
+  }
+  compactBatch(batches.back(), sizePool);
+  releaseOriginals(batches, true);
+
+  if(timePool != VK_NULL_HANDLE)
+  {
+    std::vector<uint64_t> ticks(nbBlas + batches.size());
+    vkGetQueryPoolResults(m_device, timePool, 0, static_cast<uint32_t>(ticks.size()), ticks.size() * sizeof(uint64_t),
+                          ticks.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    auto toMs = [&](uint64_t start, uint64_t end) { return (end - start) * double(m_timestampPeriod) / 1e6; };
+    for(uint32_t b = 0; b < batches.size(); b++)
+    {
+      const uint32_t firstTime = batches[b].begin + b;
+      for(uint32_t i = batches[b].begin; i < batches[b].end; i++)
+        m_reports[i].buildMs = toMs(ticks[i + b], ticks[i + b + 1]);
+      m_batches[b].buildMs = toMs(ticks[firstTime], ticks[batches[b].end + b]);
+    }
+  }
+
+  for(uint32_t i = 0; i < nbBlas; i++)
+  {
+    VkAccelerationStructureDeviceAddressInfoKHR addressInfo{};
+    addressInfo.sType                 = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+    addressInfo.accelerationStructure = m_blas[i].accel;
+    m_addresses[i]                    = vkGetAccelerationStructureDeviceAddressKHR(m_device, &addressInfo);
+  }
+
+  if(sizePool != VK_NULL_HANDLE)
+    vkDestroyQueryPool(m_device, sizePool, nullptr);
+  if(timePool != VK_NULL_HANDLE)
+    vkDestroyQueryPool(m_device, timePool, nullptr);
+  m_alloc->destroy(scratch);
+  m_liveBytes -= scratchBytes;
+  vkFreeCommandBuffers(m_device, m_cmdPool, static_cast<uint32_t>(m_cmdBufs.size()), m_cmdBufs.data());
+  m_cmdBufs.clear();
+}
+
+void BlasBuilder::logReport() const
+{
+  const double kMB = 1.0 / (1024.0 * 1024.0);
+  LOGI("BLAS  primitives   build MB  compact MB  batch   build ms\n");
+  VkDeviceSize buildTotal   = 0;
+  VkDeviceSize compactTotal = 0;
+  for(size_t i = 0; i < m_reports.size(); i++)
+  {
+    const Report& r = m_reports[i];
+    LOGI("%4zu %11u %10.3f %11.3f %6u %10.3f\n", i, r.primitiveCount, r.buildSize * kMB, r.compactedSize * kMB,
+         r.batch, r.buildMs);
+    buildTotal += r.buildSize;
+    compactTotal += r.compactedSize;
+  }
+  double msTotal = 0;
+  for(size_t b = 0; b < m_batches.size(); b++)
+  {
+    const BatchReport& batch = m_batches[b];
+    LOGI("Batch %zu: %u BLAS, %.2f MB scratch, %.3f ms\n", b, batch.blasCount, batch.scratchSize * kMB, batch.buildMs);
+    msTotal += batch.buildMs;
+  }
+  LOGI("Total %zu BLAS in %zu batches: %.2f MB -> %.2f MB (%.1f%% saved), %.2f ms\n", m_reports.size(),
+       m_batches.size(), buildTotal * kMB, compactTotal * kMB,
+       buildTotal > 0 ? 100.0 * (buildTotal - compactTotal) / buildTotal : 0.0, msTotal);
+  LOGI("Peak memory of the builder %.2f MB, scratch budget %.2f MB\n", m_peakBytes * kMB, m_scratchBudget * kMB);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "nvvk/raytraceKHR_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// BLAS builder with a memory budget, compaction and a per-structure report, in place of
+// RaytracingBuilderKHR::buildBlas (same inputs, same setup/destroy)
+// - Builds are split in batches whose scratch memory fits `m_scratchBudget` (and whose uncompacted
+//   structures fit `m_batchBytes`). The structures of a batch are built in ranges of a single
+//   scratch buffer allocated once for the largest batch, aligned as the device requires. Their
+//   builds are not serialized: a timestamp after each one gives its time, which is exact for a
+//   structure alone in its batch, and the sum over a batch is the batch time.
+// - Batches are submitted without waiting: batch N+1 is recorded while batch N executes, the
+//   queue order and a barrier protect the shared scratch buffer
+// - With VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR, the compacted sizes of a batch
+//   are read once it completed and the structures are copied to right-sized allocations; the
+//   originals are released when the copy completed
+// - The memory held by the builder (scratch, uncompacted and compacted structures) is tracked and
+//   its peak reported, to be checked against the budget
+// The TLAS is still built by RaytracingBuilderKHR, from the addresses of getBlasDeviceAddress().
+//
+class BlasBuilder
+{
+public:
+  struct Report
+  {
+    uint32_t     primitiveCount{0};
+    VkDeviceSize buildSize{0};      // Size requested for the build
+    VkDeviceSize compactedSize{0};  // Final size, buildSize without compaction
+    uint32_t     batch{0};
+    double       buildMs{0};  // GPU time from the completion of the previous build of the batch (or its start)
+  };
+
+  struct BatchReport
+  {
+    uint32_t     firstBlas{0};
+    uint32_t     blasCount{0};
+    VkDeviceSize scratchSize{0};
+    double       buildMs{0};  // GPU time of the batch, 0 when the queue has no timestamps
+  };
+
+  void setup(VkDevice device, nvvk::ResourceAllocator* allocator, uint32_t queueIndex, VkPhysicalDevice physicalDevice);
+  void destroy();
+
+  void buildBlas(const std::vector<nvvk::RaytracingBuilderKHR::BlasInput>& input,
+                 VkBuildAccelerationStructureFlagsKHR                      flags);
+
+  VkDeviceAddress            getBlasDeviceAddress(uint32_t blasId) const { return m_addresses[blasId]; }
+  VkAccelerationStructureKHR getAccelerationStructure(uint32_t blasId) const { return m_blas[blasId].accel; }
+  uint32_t                   count() const { return static_cast<uint32_t>(m_blas.size()); }
+
+  const std::vector<Report>&      reports() const { return m_reports; }
+  const std::vector<BatchReport>& batchReports() const { return m_batches; }
+  VkDeviceSize                    peakBytes() const { return m_peakBytes; }
+  // Table of the sizes and build times, with the totals and the peak memory
+  void logReport() const;
+
+  VkDeviceSize m_scratchBudget{64 * 1024 * 1024};  // A larger build gets a batch of its own
+  VkDeviceSize m_batchBytes{256 * 1024 * 1024};
+
+private:
+  struct Batch
+  {
+    uint32_t                    begin{0};
+    uint32_t                    end{0};
+    uint64_t                    buildValue{0};  // Timeline value of the builds
+    uint64_t                    copyValue{0};   // Of the compaction copies, the originals are released after
+    std::vector<nvvk::AccelKHR> originals;
+  };
+
+  VkCommandBuffer beginCommandBuffer();
+  uint64_t        submit(VkCommandBuffer cmdBuf);
+  void            wait(uint64_t value);
+  void            compactBatch(Batch& batch, VkQueryPool sizePool);
+  void            releaseOriginals(std::vector<Batch>& batches, bool waitAll);
+  nvvk::AccelKHR  createAccel(VkDeviceSize size);
+  void            destroyAccel(nvvk::AccelKHR& accel, VkDeviceSize size);
+  void            clearBlas();
+
+  VkDevice                 m_device{VK_NULL_HANDLE};
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  VkQueue                  m_queue{VK_NULL_HANDLE};
+  VkCommandPool            m_cmdPool{VK_NULL_HANDLE};
+  VkSemaphore              m_timeline{VK_NULL_HANDLE};
+  uint64_t                 m_value{0};
+  float                    m_timestampPeriod{1.f};  // Nanoseconds per timestamp tick
+  VkDeviceSize             m_scratchAlignment{256};
+
+  std::vector<nvvk::AccelKHR>  m_blas;
+  std::vector<VkDeviceAddress> m_addresses;
+  std::vector<Report>          m_reports;
+  std::vector<BatchReport>     m_batches;
+  std::vector<VkCommandBuffer> m_cmdBufs;  // Of the current build, freed at its end
+  VkDeviceSize                 m_liveBytes{0};
+  VkDeviceSize                 m_peakBytes{0};
+};
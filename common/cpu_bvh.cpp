@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "cpu_bvh.h"
+#include "nvh/nvprint.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <float.h>
+
+
+namespace {
+constexpr int      kBins             = 16;
+constexpr uint32_t kParallelBuild    = 4096;   // Children of larger nodes are built as separate tasks
+constexpr uint32_t kParallelReduce   = 65536;  // Binning of larger nodes is split in batches
+constexpr size_t   kReduceBatchSize  = 16384;
+
+struct Aabb
+{
+  glm::vec3 bmin{FLT_MAX};
+  glm::vec3 bmax{-FLT_MAX};
+
+  void grow(const glm::vec3& p)
+  {
+    bmin = glm::min(bmin, p);
+    bmax = glm::max(bmax, p);
+  }
+  void grow(const Aabb& b)
+  {
+    bmin = glm::min(bmin, b.bmin);
+    bmax = glm::max(bmax, b.bmax);
+  }
+  float area() const
+  {
+    if(bmin.x > bmax.x)
+      return 0.f;
+    glm::vec3 e = bmax - bmin;
+    return 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
+  }
+};
+
+// Axes where all centroids are equal have a scale of 0: everything goes in the first bin
+glm::vec3 binScale(const Aabb& centroidBounds)
+{
+  glm::vec3 scale;
+  for(int axis = 0; axis < 3; axis++)
+  {
+    float extent = centroidBounds.bmax[axis] - centroidBounds.bmin[axis];
+    scale[axis]  = extent > 0.f ? float(kBins) / extent : 0.f;
+  }
+  return scale;
+}
+
+int binIndex(float centroid, float axisMin, float scale)
+{
+  return std::min(kBins - 1, std::max(0, static_cast<int>((centroid - axisMin) * scale)));
+}
+
+struct Bin
+{
+  Aabb     bounds;
+  uint32_t count{0};
+};
+
+// Bounds of the triangles and of their centroids
+struct RangeBounds
+{
+  Aabb bounds;
+  Aabb centroids;
+
+  void grow(const RangeBounds& r)
+  {
+    bounds.grow(r.bounds);
+    centroids.grow(r.centroids);
+  }
+};
+
+struct BinSet
+{
+  Bin bins[3][kBins];
+
+  void grow(const BinSet& s)
+  {
+    for(int axis = 0; axis < 3; axis++)
+    {
+      for(int b = 0; b < kBins; b++)
+      {
+        bins[axis][b].bounds.grow(s.bins[axis][b].bounds);
+        bins[axis][b].count += s.bins[axis][b].count;
+      }
+    }
+  }
+};
+
+// Triangle bounds, partitioned in place: the passes over a node read memory sequentially
+struct Reference
+{
+  Aabb     bounds;
+  uint32_t triangle;
+
+  glm::vec3 centroid() const { return (bounds.bmin + bounds.bmax) * 0.5f; }
+};
+
+struct Builder
+{
+  std::vector<CpuBvh::Node>& nodes;
+  std::vector<Reference>     refs;
+  std::atomic<uint32_t>      nodeCount{0};
+  uint32_t                   maxLeafSize;
+  uint32_t                   maxSahLeaf;
+  ThreadPool&                pool;
+
+  Builder(std::vector<CpuBvh::Node>& n, uint32_t leaf, uint32_t sahLeaf, ThreadPool& p)
+      : nodes(n)
+      , maxLeafSize(leaf)
+      , maxSahLeaf(sahLeaf)
+      , pool(p)
+  {
+  }
+
+  // Accumulates fn(begin, end, T&) over [begin, end), in parallel batches merged with T::grow for large ranges
+  template <typename T, typename F>
+  T reduce(uint32_t begin, uint32_t end, F&& fn)
+  {
+    T              result;
+    const uint32_t count = end - begin;
+    if(count < kParallelReduce)
+    {
+      fn(begin, end, result);
+      return result;
+    }
+    std::vector<T> partial((count + kReduceBatchSize - 1) / kReduceBatchSize);
+    pool.parallelBatches(count, kReduceBatchSize, [&](size_t b, size_t e) {
+      fn(begin + static_cast<uint32_t>(b), begin + static_cast<uint32_t>(e), partial[b / kReduceBatchSize]);
+    });
+    for(const T& p : partial)
+      result.grow(p);
+    return result;
+  }
+
+  RangeBounds rangeBounds(uint32_t begin, uint32_t end)
+  {
+    return reduce<RangeBounds>(begin, end, [&](uint32_t b, uint32_t e, RangeBounds& r) {
+      for(uint32_t i = b; i < e; i++)
+      {
+        r.bounds.grow(refs[i].bounds);
+        r.centroids.grow(refs[i].centroid());
+      }
+    });
+  }
+
+  BinSet binRange(uint32_t begin, uint32_t end, const Aabb& centroidBounds)
+  {
+    const glm::vec3 scale = binScale(centroidBounds);
+    return reduce<BinSet>(begin, end, [&](uint32_t b, uint32_t e, BinSet& set) {
+      for(uint32_t i = b; i < e; i++)
+      {
+        const glm::vec3 c = refs[i].centroid();
+        for(int axis = 0; axis < 3; axis++)
+        {
+          Bin& bin = set.bins[axis][binIndex(c[axis], centroidBounds.bmin[axis], scale[axis])];
+          bin.bounds.grow(refs[i].bounds);
+          bin.count++;
+        }
+      }
+    });
+  }
+
+  void makeLeaf(uint32_t nodeIndex, uint32_t begin, uint32_t end)
+  {
+    nodes[nodeIndex].first = begin;
+    nodes[nodeIndex].count = end - begin;
+  }
+
+  void buildNode(uint32_t nodeIndex, uint32_t begin, uint32_t end)
+  {
+    const uint32_t    count  = end - begin;
+    const RangeBounds bounds = rangeBounds(begin, end);
+    CpuBvh::Node&     node   = nodes[nodeIndex];
+    node.bmin                = bounds.bounds.bmin;
+    node.bmax                = bounds.bounds.bmax;
+    if(count <= maxLeafSize)
+    {
+      makeLeaf(nodeIndex, begin, end);
+      return;
+    }
+
+    // Best split among the bin boundaries of the 3 axes
+    int   bestAxis  = -1;
+    int   bestSplit = 0;
+    float bestCost  = FLT_MAX;
+    const glm::vec3 extent = bounds.centroids.bmax - bounds.centroids.bmin;
+    if(std::max(extent.x, std::max(extent.y, extent.z)) > 0.f)
+    {
+      const BinSet set = binRange(begin, end, bounds.centroids);
+      for(int axis = 0; axis < 3; axis++)
+      {
+        if(extent[axis] <= 0.f)
+          continue;
+        // Right side areas and counts, swept from the last bin
+        float    rightCost[kBins];
+        Aabb     right;
+        uint32_t rightCount = 0;
+        for(int b = kBins - 1; b > 0; b--)
+        {
+          right.grow(set.bins[axis][b].bounds);
+          rightCount += set.bins[axis][b].count;
+          rightCost[b] = rightCount * right.area();
+        }
+        Aabb     left;
+        uint32_t leftCount = 0;
+        for(int b = 0; b < kBins - 1; b++)
+        {
+          left.grow(set.bins[axis][b].bounds);
+          leftCount += set.bins[axis][b].count;
+          float cost = leftCount * left.area() + rightCost[b + 1];
+          if(leftCount > 0 && leftCount < count && cost < bestCost)
+          {
+            bestCost  = cost;
+            bestAxis  = axis;
+            bestSplit = b + 1;
+          }
+        }
+      }
+    }
+
+    // Splitting costs one traversal step and the children's intersections
+    const float nodeArea = bounds.bounds.area();
+    if(bestAxis >= 0 && count <= maxSahLeaf && nodeArea + bestCost >= count * nodeArea)
+    {
+      makeLeaf(nodeIndex, begin, end);
+      return;
+    }
+
+    uint32_t middle = begin + count / 2;
+    if(bestAxis >= 0)
+    {
+      const float axisMin = bounds.centroids.bmin[bestAxis];
+      const float scale   = binScale(bounds.centroids)[bestAxis];
+      auto        it      = std::partition(refs.begin() + begin, refs.begin() + end, [&](const Reference& ref) {
+        return binIndex(ref.centroid()[bestAxis], axisMin, scale) < bestSplit;
+      });
+      middle = static_cast<uint32_t>(it - refs.begin());
+    }
+    else if(count <= maxSahLeaf)
+    {
+      // All centroids at the same place: no split separates them
+      makeLeaf(nodeIndex, begin, end);
+      return;
+    }
+    if(middle == begin || middle == end)
+      middle = begin + count / 2;
+
+    const uint32_t left = nodeCount.fetch_add(2);
+    node.first          = left;
+    node.count          = 0;
+    if(count >= kParallelBuild)
+    {
+      pool.parallelBatches(2, 1, [&](size_t child, size_t) {
+        if(child == 0)
+          buildNode(left, begin, middle);
+        else
+          buildNode(left + 1, middle, end);
+      });
+    }
+    else
+    {
+      buildNode(left, begin, middle);
+      buildNode(left + 1, middle, end);
+    }
+  }
+};
+}  // namespace
+
+
+void CpuBvh::build(const glm::vec3* positions, const uint32_t* indices, uint32_t triangleCount, ThreadPool& pool)
+{
+  auto startTime = std::chrono::high_resolution_clock::now();
+  m_nodes.clear();
+  m_triangles.resize(triangleCount);
+  m_stats = {};
+  if(triangleCount == 0)
+    return;
+
+  Builder builder(m_nodes, m_maxLeafSize, m_maxSahLeaf, pool);
+  builder.refs.resize(triangleCount);
+  pool.parallelBatches(triangleCount, kReduceBatchSize, [&](size_t begin, size_t end) {
+    for(size_t t = begin; t < end; t++)
+    {
+      Reference& ref = builder.refs[t];
+      for(int k = 0; k < 3; k++)
+        ref.bounds.grow(positions[indices[t * 3 + k]]);
+      ref.triangle = static_cast<uint32_t>(t);
+    }
+  });
+
+  // At most 2N-1 nodes; node 1 is left unused so that pairs of children start on even indices
+  m_nodes.resize(2 * static_cast<size_t>(triangleCount) + 1);
+  builder.nodeCount = 2;
+  builder.buildNode(0, 0, triangleCount);
+  m_nodes.resize(builder.nodeCount);
+  for(uint32_t i = 0; i < triangleCount; i++)
+    m_triangles[i] = builder.refs[i].triangle;
+
+  auto endTime     = std::chrono::high_resolution_clock::now();
+  m_stats.buildMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+  computeStats();
+}
+
+void CpuBvh::computeStats()
+{
+  const Node& root     = m_nodes[0];
+  glm::vec3   e        = root.bmax - root.bmin;
+  const float rootArea = std::max(2.f * (e.x * e.y + e.y * e.z + e.z * e.x), FLT_MIN);
+
+  m_stats.triangleCount = static_cast<uint32_t>(m_triangles.size());
+  m_stats.nodeCount     = 0;
+  double   sah          = 0.0;
+  uint64_t leafDepths   = 0;
+  std::vector<std::pair<uint32_t, uint32_t>> stack{{0, 0}};  // Node, depth
+  while(!stack.empty())
+  {
+    auto [index, depth] = stack.back();
+    stack.pop_back();
+    const Node& node = m_nodes[index];
+    glm::vec3   d    = node.bmax - node.bmin;
+    double      area = 2.0 * (d.x * d.y + d.y * d.z + d.z * d.x) / rootArea;
+    m_stats.nodeCount++;
+    m_stats.maxDepth = std::max(m_stats.maxDepth, depth);
+    if(node.count > 0)
+    {
+      sah += area * node.count;
+      m_stats.leafCount++;
+      leafDepths += depth;
+      continue;
+    }
+    sah += area;
+    stack.emplace_back(node.first, depth + 1);
+    stack.emplace_back(node.first + 1, depth + 1);
+  }
+  m_stats.sahCost          = sah;
+  m_stats.averageLeafDepth = double(leafDepths) / std::max(m_stats.leafCount, 1u);
+  m_stats.averageLeafSize  = double(m_stats.triangleCount) / std::max(m_stats.leafCount, 1u);
+}
+
+void CpuBvh::logStats(const char* name) const
+{
+  LOGI("CPU BVH %s: %u triangles in %.2f ms (%.2f Mtris/s), %u nodes, %u leaves of %.2f triangles\n", name,
+       m_stats.triangleCount, m_stats.buildMs, m_stats.triangleCount / std::max(m_stats.buildMs * 1000.0, 1e-9),
+       m_stats.nodeCount, m_stats.leafCount, m_stats.averageLeafSize);
+  LOGI("  SAH cost %.2f, depth max %u, average leaf depth %.2f\n", m_stats.sahCost, m_stats.maxDepth,
+       m_stats.averageLeafDepth);
+}
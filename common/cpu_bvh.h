@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "thread_pool.h"
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// BVH of triangles built on the CPU, for tools, validation and devices without ray tracing
+// - Binned SAH: centroids are binned on the 3 axes and the split minimizing the surface area
+//   heuristic is taken, or a leaf when splitting costs more than intersecting the triangles
+// - Children are built as tasks of the thread pool; the binning of large nodes is parallel too
+// - Flat layout: 32-byte nodes with the two children adjacent, each pair on its own 64 bytes
+//
+class CpuBvh
+{
+public:
+  struct Node
+  {
+    glm::vec3 bmin;
+    uint32_t  first;  // Leaf: first entry in triangles(), inner node: left child, the right one is first + 1
+    glm::vec3 bmax;
+    uint32_t  count;  // Number of triangles of a leaf, 0 for inner nodes
+  };
+
+  struct Stats
+  {
+    uint32_t triangleCount{0};
+    uint32_t nodeCount{0};
+    uint32_t leafCount{0};
+    uint32_t maxDepth{0};
+    double   averageLeafDepth{0};
+    double   averageLeafSize{0};
+    double   sahCost{0};  // Traversal and intersection costs of 1, relative to the root area
+    double   buildMs{0};
+  };
+
+  // Triangles are `indices` triplets in `positions`
+  void build(const glm::vec3* positions,
+             const uint32_t*  indices,
+             uint32_t         triangleCount,
+             ThreadPool&      pool = ThreadPool::global());
+  void build(const std::vector<glm::vec3>& positions,
+             const std::vector<uint32_t>&  indices,
+             ThreadPool&                   pool = ThreadPool::global())
+  {
+    build(positions.data(), indices.data(), static_cast<uint32_t>(indices.size() / 3), pool);
+  }
+
+  // Root is nodes()[0] and nodes()[1] is unused; empty without triangles
+  const std::vector<Node>&     nodes() const { return m_nodes; }
+  const std::vector<uint32_t>& triangles() const { return m_triangles; }  // Triangle indices in the order of the leaves
+  const Stats&                 stats() const { return m_stats; }
+  void                         logStats(const char* name) const;
+
+  uint32_t m_maxLeafSize{4};   // Leaves are created below this count, or above when SAH prefers them
+  uint32_t m_maxSahLeaf{16};   // Larger nodes are always split
+
+private:
+  void computeStats();
+
+  std::vector<Node>     m_nodes;
+  std::vector<uint32_t> m_triangles;
+  Stats                 m_stats;
+};
@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "cpu_traversal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <float.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CPU_TRAVERSAL_SSE 1
+#endif
+
+
+namespace {
+// Each level of the 4-wide BVH pushes at most 3 more entries; deeper subtrees are merged in a leaf
+constexpr uint32_t kMaxDepth  = 60;
+constexpr uint32_t kStackSize = 3 * kMaxDepth + 4;
+
+// Slab distances are widened by this factor so rounding does not miss boxes of watertight hits (Ize 2013)
+constexpr float kSlabScale = 1.f + 2.f * 3.f * FLT_EPSILON;
+
+struct StackEntry
+{
+  uint32_t first;
+  uint32_t count;  // 0 for a node
+  float    tNear;
+};
+
+float boxArea(const CpuBvh::Node& node)
+{
+  glm::vec3 e = node.bmax - node.bmin;
+  return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+// Range of m_triangles covered by a subtree: the builder partitions contiguous ranges
+void subtreeRange(const std::vector<CpuBvh::Node>& nodes, uint32_t index, uint32_t& begin, uint32_t& end)
+{
+  const CpuBvh::Node& node = nodes[index];
+  if(node.count > 0)
+  {
+    begin = std::min(begin, node.first);
+    end   = std::max(end, node.first + node.count);
+    return;
+  }
+  subtreeRange(nodes, node.first, begin, end);
+  subtreeRange(nodes, node.first + 1, begin, end);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Per-ray setup of the watertight test: the ray is sheared so its direction is +Z, kz being the
+// largest dimension of the direction
+//
+struct RaySetup
+{
+  glm::vec3 origin;
+  glm::vec3 invDir;
+  int       kx, ky, kz;
+  float     sx, sy, sz;
+
+  explicit RaySetup(const CpuTraversal::Ray& ray)
+      : origin(ray.origin)
+  {
+    const glm::vec3& d = ray.direction;
+    for(int i = 0; i < 3; i++)
+    {
+      // No infinity: 0 * inf would be NaN for origins on a slab plane
+      float di  = std::fabs(d[i]) < 1e-20f ? std::copysign(1e-20f, d[i]) : d[i];
+      invDir[i] = 1.f / di;
+    }
+    const glm::vec3 ad = glm::abs(d);
+    kz                 = ad.x > ad.y ? (ad.x > ad.z ? 0 : 2) : (ad.y > ad.z ? 1 : 2);
+    kx = (kz + 1) % 3;
+    ky = (kx + 1) % 3;
+    if(d[kz] < 0.f)
+      std::swap(kx, ky);  // Keeps the winding
+    sx = d[kx] / d[kz];
+    sy = d[ky] / d[kz];
+    sz = 1.f / d[kz];
+  }
+
+  // Hit distance in (tMin, tMax) and barycentrics of v1, v2
+  bool intersect(const glm::vec3& v0,
+                 const glm::vec3& v1,
+                 const glm::vec3& v2,
+                 float            tMin,
+                 float            tMax,
+                 float&           t,
+                 float&           u,
+                 float&           v) const
+  {
+    const glm::vec3 a  = v0 - origin;
+    const glm::vec3 b  = v1 - origin;
+    const glm::vec3 c  = v2 - origin;
+    const float     ax = a[kx] - sx * a[kz];
+    const float     ay = a[ky] - sy * a[kz];
+    const float     bx = b[kx] - sx * b[kz];
+    const float     by = b[ky] - sy * b[kz];
+    const float     cx = c[kx] - sx * c[kz];
+    const float     cy = c[ky] - sy * c[kz];
+
+    // Scaled barycentrics, recomputed in double when an edge goes through the ray
+    float wu = cx * by - cy * bx;
+    float wv = ax * cy - ay * cx;
+    float ww = bx * ay - by * ax;
+    if(wu == 0.f || wv == 0.f || ww == 0.f)
+    {
+      wu = static_cast<float>(double(cx) * double(by) - double(cy) * double(bx));
+      wv = static_cast<float>(double(ax) * double(cy) - double(ay) * double(cx));
+      ww = static_cast<float>(double(bx) * double(ay) - double(by) * double(ax));
+    }
+    if((wu < 0.f || wv < 0.f || ww < 0.f) && (wu > 0.f || wv > 0.f || ww > 0.f))
+      return false;
+
+    const float det = wu + wv + ww;
+    if(det == 0.f)
+      return false;
+
+    const float scaledT = wu * (sz * a[kz]) + wv * (sz * b[kz]) + ww * (sz * c[kz]);
+    const float invDet  = 1.f / det;
+    t                   = scaledT * invDet;
+    if(!(t > tMin && t < tMax))
+      return false;
+    u = wv * invDet;
+    v = ww * invDet;
+    return true;
+  }
+};
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Each 4-wide node takes the children of a binary node, then opens its largest inner child until
+// it has 4 children
+//
+uint32_t CpuTraversal::collapse(const std::vector<CpuBvh::Node>& nodes, uint32_t binaryNode, uint32_t depth)
+{
+  m_depth = std::max(m_depth, depth);
+
+  uint32_t children[4];
+  uint32_t childCount = 0;
+  if(nodes[binaryNode].count > 0)
+  {
+    children[childCount++] = binaryNode;
+  }
+  else
+  {
+    children[childCount++] = nodes[binaryNode].first;
+    children[childCount++] = nodes[binaryNode].first + 1;
+  }
+  while(childCount < 4)
+  {
+    int   open     = -1;
+    float openArea = -1.f;
+    for(uint32_t i = 0; i < childCount; i++)
+    {
+      if(nodes[children[i]].count == 0 && boxArea(nodes[children[i]]) > openArea)
+      {
+        open     = int(i);
+        openArea = boxArea(nodes[children[i]]);
+      }
+    }
+    if(open < 0)
+      break;
+    const uint32_t first   = nodes[children[open]].first;
+    children[open]         = first;
+    children[childCount++] = first + 1;
+  }
+
+  const uint32_t index = static_cast<uint32_t>(m_nodes.size());
+  m_nodes.emplace_back();
+  Node4 node{};
+  node.childCount = childCount;
+  for(uint32_t i = 0; i < childCount; i++)
+  {
+    const CpuBvh::Node& child = nodes[children[i]];
+    for(int k = 0; k < 3; k++)
+    {
+      node.bmin[k][i] = child.bmin[k];
+      node.bmax[k][i] = child.bmax[k];
+    }
+    if(child.count > 0)
+    {
+      node.first[i] = child.first;
+      node.count[i] = child.count;
+    }
+    else if(depth + 1 >= kMaxDepth)
+    {
+      uint32_t begin = UINT32_MAX, end = 0;
+      subtreeRange(nodes, children[i], begin, end);
+      node.first[i] = begin;
+      node.count[i] = end - begin;
+    }
+    else
+    {
+      node.first[i] = collapse(nodes, children[i], depth + 1);
+      node.count[i] = 0;
+    }
+  }
+  m_nodes[index] = node;
+  return index;
+}
+
+void CpuTraversal::build(const CpuBvh& bvh, const glm::vec3* positions, const uint32_t* indices)
+{
+  m_nodes.clear();
+  m_triangles.clear();
+  m_depth = 0;
+  if(bvh.nodes().empty())
+    return;
+
+  m_triangles.resize(bvh.triangles().size());
+  for(size_t i = 0; i < m_triangles.size(); i++)
+  {
+    const uint32_t t = bvh.triangles()[i];
+    m_triangles[i]   = {positions[indices[t * 3 + 0]], positions[indices[t * 3 + 1]], positions[indices[t * 3 + 2]], t};
+  }
+
+  m_nodes.reserve(bvh.nodes().size() / 2);
+  collapse(bvh.nodes(), 0, 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Stack traversal: the children of a node hit by the ray are pushed farthest first, leaves are
+// pushed as triangle ranges. With `anyHit`, the first hit found ends the traversal.
+//
+namespace {
+template <bool anyHit, typename Node4, typename Triangle>
+bool traverse(const std::vector<Node4>&    nodes,
+              const std::vector<Triangle>& triangles,
+              const CpuTraversal::Ray&     ray,
+              CpuTraversal::Hit&           hit)
+{
+  if(nodes.empty())
+    return false;
+
+  const RaySetup setup(ray);
+  float          tMax  = ray.tMax;
+  bool           found = false;
+
+  StackEntry stack[kStackSize];
+  uint32_t   stackSize = 0;
+  stack[stackSize++]   = {0, 0, ray.tMin};
+
+#ifdef CPU_TRAVERSAL_SSE
+  const __m128 origin[3] = {_mm_set1_ps(ray.origin.x), _mm_set1_ps(ray.origin.y), _mm_set1_ps(ray.origin.z)};
+  const __m128 invDir[3] = {_mm_set1_ps(setup.invDir.x), _mm_set1_ps(setup.invDir.y), _mm_set1_ps(setup.invDir.z)};
+  const __m128 tMin      = _mm_set1_ps(ray.tMin);
+#endif
+
+  while(stackSize > 0)
+  {
+    const StackEntry entry = stack[--stackSize];
+    if(entry.tNear > tMax)
+      continue;
+
+    if(entry.count > 0)
+    {
+      for(uint32_t i = entry.first; i < entry.first + entry.count; i++)
+      {
+        const Triangle& tri = triangles[i];
+        float           t, u, v;
+        if(setup.intersect(tri.v0, tri.v1, tri.v2, ray.tMin, tMax, t, u, v))
+        {
+          found = true;
+          tMax  = t;
+          hit   = {t, tri.id, u, v};
+          if(anyHit)
+            return true;
+        }
+      }
+      continue;
+    }
+
+    // Slab test of the 4 children
+    const Node4& node = nodes[entry.first];
+    alignas(16) float tNear[4];
+    int               mask = 0;
+#ifdef CPU_TRAVERSAL_SSE
+    __m128 t0[3], t1[3];
+    for(int k = 0; k < 3; k++)
+    {
+      __m128 a = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bmin[k]), origin[k]), invDir[k]);
+      __m128 b = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bmax[k]), origin[k]), invDir[k]);
+      t0[k]    = _mm_min_ps(a, b);
+      t1[k]    = _mm_max_ps(a, b);
+    }
+    __m128 nearT = _mm_max_ps(_mm_max_ps(t0[0], t0[1]), _mm_max_ps(t0[2], tMin));
+    __m128 farT  = _mm_min_ps(_mm_min_ps(t1[0], t1[1]), _mm_min_ps(t1[2], _mm_set1_ps(tMax)));
+    farT         = _mm_mul_ps(farT, _mm_set1_ps(kSlabScale));
+    _mm_store_ps(tNear, nearT);
+    mask = _mm_movemask_ps(_mm_cmple_ps(nearT, farT)) & ((1 << node.childCount) - 1);
+#else
+    for(uint32_t i = 0; i < node.childCount; i++)
+    {
+      float nearT = ray.tMin;
+      float farT  = tMax;
+      for(int k = 0; k < 3; k++)
+      {
+        float a = (node.bmin[k][i] - ray.origin[k]) * setup.invDir[k];
+        float b = (node.bmax[k][i] - ray.origin[k]) * setup.invDir[k];
+        nearT   = std::max(nearT, std::min(a, b));
+        farT    = std::min(farT, std::max(a, b));
+      }
+      tNear[i] = nearT;
+      if(nearT <= farT * kSlabScale)
+        mask |= 1 << i;
+    }
+#endif
+    if(mask == 0)
+      continue;
+
+    // Farthest first, so the nearest is popped next
+    uint32_t order[4];
+    uint32_t orderCount = 0;
+    for(uint32_t i = 0; i < 4; i++)
+    {
+      if((mask & (1 << i)) == 0)
+        continue;
+      uint32_t j = orderCount++;
+      for(; !anyHit && j > 0 && tNear[order[j - 1]] < tNear[i]; j--)
+        order[j] = order[j - 1];
+      order[j] = i;
+    }
+    for(uint32_t j = 0; j < orderCount; j++)
+    {
+      const uint32_t i   = order[j];
+      stack[stackSize++] = {node.first[i], node.count[i], tNear[i]};
+    }
+  }
+  return found;
+}
+}  // namespace
+
+bool CpuTraversal::closestHit(const Ray& ray, Hit& hit) const
+{
+  return traverse<false>(m_nodes, m_triangles, ray, hit);
+}
+
+bool CpuTraversal::anyHit(const Ray& ray) const
+{
+  Hit hit;
+  return traverse<true>(m_nodes, m_triangles, ray, hit);
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "cpu_bvh.h"
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Ray queries on the CPU against a CpuBvh, the reference of the hardware traversal
+// - The binary BVH is collapsed to a 4-wide BVH: the 4 child boxes of a node are tested at once
+//   with SSE (scalar elsewhere) and the children are visited front to back
+// - Watertight ray/triangle test (Woop et al. 2013): rays through shared edges and vertices hit
+//   one of the triangles; both faces are hit, as opaque geometry without culling flags
+// - closestHit() is the query of a closest hit shader, anyHit() the shadow query ending at the
+//   first hit found (gl_RayFlagsTerminateOnFirstHitEXT)
+// - The queries are const and can be called from any thread
+//
+class CpuTraversal
+{
+public:
+  struct Ray
+  {
+    glm::vec3 origin;
+    float     tMin{0.f};
+    glm::vec3 direction;
+    float     tMax{1e30f};
+  };
+
+  struct Hit
+  {
+    float    t{0.f};
+    uint32_t triangle{0};  // Triangle of the indices given to build()
+    float    u{0.f};       // Barycentrics of the 2nd and 3rd vertices, as hitAttributeEXT
+    float    v{0.f};
+  };
+
+  // The triangles `bvh` was built from
+  void build(const CpuBvh& bvh, const glm::vec3* positions, const uint32_t* indices);
+  void build(const CpuBvh& bvh, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+  {
+    build(bvh, positions.data(), indices.data());
+  }
+
+  bool closestHit(const Ray& ray, Hit& hit) const;
+  bool anyHit(const Ray& ray) const;
+
+  size_t nodeCount() const { return m_nodes.size(); }
+
+private:
+  // 4 children in SoA, packed at the start of the node
+  struct alignas(16) Node4
+  {
+    float    bmin[3][4];
+    float    bmax[3][4];
+    uint32_t first[4];  // Inner child: index of its node, leaf: first triangle in m_triangles
+    uint32_t count[4];  // Triangles of a leaf, 0 for an inner child
+    uint32_t childCount;
+  };
+
+  struct Triangle
+  {
+    glm::vec3 v0, v1, v2;
+    uint32_t  id;
+  };
+
+  uint32_t collapse(const std::vector<CpuBvh::Node>& nodes, uint32_t binaryNode, uint32_t depth);
+
+  std::vector<Node4>    m_nodes;
+  std::vector<Triangle> m_triangles;  // In the order of the leaves
+  uint32_t              m_depth{0};
+};
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "geometry_dedup.h"
+
+#include <cstring>
+#include <unordered_map>
+
+
+//--------------------------------------------------------------------------------------------------
+// FNV-1a on 64-bit words, the sizes included so that moving bytes between spans changes the hash
+//
+uint64_t GeometryDedup::hash(const std::vector<Span>& spans)
+{
+  uint64_t h = 14695981039346656037ull;
+  for(const auto& span : spans)
+  {
+    h                    = (h ^ span.size) * 1099511628211ull;
+    const uint8_t* bytes = static_cast<const uint8_t*>(span.data);
+    size_t         i     = 0;
+    for(; i + sizeof(uint64_t) <= span.size; i += sizeof(uint64_t))
+    {
+      uint64_t word;
+      memcpy(&word, bytes + i, sizeof(word));
+      h = (h ^ word) * 1099511628211ull;
+      h ^= h >> 32;
+    }
+    for(; i < span.size; i++)
+      h = (h ^ bytes[i]) * 1099511628211ull;
+  }
+  return h;
+}
+
+void GeometryDedup::build(const std::vector<std::vector<Span>>& meshes, ThreadPool& pool)
+{
+  const size_t          nbMeshes = meshes.size();
+  std::vector<uint64_t> hashes(nbMeshes);
+  pool.parallelBatches(nbMeshes, 1, [&](size_t begin, size_t end) {
+    for(size_t m = begin; m < end; m++)
+      hashes[m] = hash(meshes[m]);
+  });
+
+  auto sameContent = [&](size_t a, size_t b) {
+    if(meshes[a].size() != meshes[b].size())
+      return false;
+    for(size_t s = 0; s < meshes[a].size(); s++)
+    {
+      const Span& sa = meshes[a][s];
+      const Span& sb = meshes[b][s];
+      if(sa.size != sb.size || (sa.data != sb.data && sa.size != 0 && memcmp(sa.data, sb.data, sa.size) != 0))
+        return false;
+    }
+    return true;
+  };
+
+  // Canonical meshes of each hash, usually one
+  std::unordered_multimap<uint64_t, uint32_t> byHash;
+  m_canonical.resize(nbMeshes);
+  m_uniqueCount    = 0;
+  m_duplicateBytes = 0;
+  for(uint32_t m = 0; m < nbMeshes; m++)
+  {
+    m_canonical[m] = m;
+    auto range     = byHash.equal_range(hashes[m]);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+      if(sameContent(it->second, m))
+      {
+        m_canonical[m] = it->second;
+        break;
+      }
+    }
+
+    if(m_canonical[m] == m)
+    {
+      byHash.emplace(hashes[m], m);
+      m_uniqueCount++;
+    }
+    else
+    {
+      for(const auto& span : meshes[m])
+        m_duplicateBytes += span.size;
+    }
+  }
+}
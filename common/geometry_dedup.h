@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "thread_pool.h"
+
+#include <stdint.h>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Content dedup of meshes, to share acceleration structures between identical geometry
+// - A mesh is a list of byte ranges (positions, indices, ...), all meshes having the same number
+// - Meshes are hashed in parallel, then meshes with the same hash are compared byte for byte:
+//   a hash collision never merges different geometry
+// - Each mesh maps to the first mesh with identical content, its canonical mesh
+//
+class GeometryDedup
+{
+public:
+  struct Span
+  {
+    const void* data{nullptr};
+    size_t      size{0};  // Bytes
+  };
+
+  void build(const std::vector<std::vector<Span>>& meshes, ThreadPool& pool = ThreadPool::global());
+
+  const std::vector<uint32_t>& canonical() const { return m_canonical; }
+  uint32_t                     canonical(uint32_t mesh) const { return m_canonical[mesh]; }
+  bool                         isCanonical(uint32_t mesh) const { return m_canonical[mesh] == mesh; }
+  uint32_t                     uniqueCount() const { return m_uniqueCount; }
+  size_t                       duplicateBytes() const { return m_duplicateBytes; }  // Bytes of the non-canonical meshes
+
+  static uint64_t hash(const std::vector<Span>& spans);
+
+private:
+  std::vector<uint32_t> m_canonical;
+  uint32_t              m_uniqueCount{0};
+  size_t                m_duplicateBytes{0};
+};
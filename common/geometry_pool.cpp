@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "geometry_pool.h"
+#include "nvvk/buffers_vk.hpp"
+
+#include <algorithm>
+
+
+void GeometryPool::init(nvvk::ResourceAllocator* alloc,
+                        VkDevice                 device,
+                        UploadManager*           upload,
+                        VkDeviceSize             initialSize)
+{
+  m_alloc  = alloc;
+  m_device = device;
+  m_upload = upload;
+
+  const VkBufferUsageFlags common = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+                                    | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  const VkBufferUsageFlags buildInput = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+  m_streams[eVertices].usage          = common | buildInput | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  m_streams[eIndices].usage           = common | buildInput | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+  m_streams[eMaterials].usage         = common;
+  m_streams[eMaterialIndices].usage   = common;
+
+  // Never empty, so the buffers can always be bound
+  for(auto& stream : m_streams)
+    grow(stream, initialSize);
+}
+
+void GeometryPool::deinit()
+{
+  for(auto& stream : m_streams)
+  {
+    m_alloc->destroy(stream.buffer);
+    stream = {};
+  }
+  m_allocationCount = 0;
+}
+
+VkDeviceSize GeometryPool::add(Stream stream, const void* data, VkDeviceSize size, VkDeviceSize alignment)
+{
+  StreamBuffer&      s      = m_streams[stream];
+  const VkDeviceSize offset = (s.size + alignment - 1) / alignment * alignment;
+  if(size == 0)
+    return offset;
+
+  if(offset + size > s.capacity)
+    grow(s, offset + size);
+  m_upload->copyToBuffer(s.buffer.buffer, offset, size, data);
+  s.size = offset + size;
+  return offset;
+}
+
+VkDeviceAddress GeometryPool::address(Stream stream) const
+{
+  return nvvk::getBufferDeviceAddress(m_device, m_streams[stream].buffer.buffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The content is copied on the GPU after the uploads already recorded to the old buffer
+//
+void GeometryPool::grow(StreamBuffer& stream, VkDeviceSize minCapacity)
+{
+  const VkDeviceSize capacity = std::max(stream.capacity * 2, minCapacity);
+  nvvk::Buffer       buffer   = m_alloc->createBuffer(capacity, stream.usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_allocationCount++;
+
+  if(stream.size > 0)
+  {
+    VkCommandBuffer cmdBuf = m_upload->commandBuffer();
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+    VkBufferCopy region{0, 0, stream.size};
+    vkCmdCopyBuffer(cmdBuf, stream.buffer.buffer, buffer.buffer, 1, &region);
+  }
+  if(stream.buffer.buffer != VK_NULL_HANDLE)
+    m_upload->release(stream.buffer);
+
+  stream.buffer   = buffer;
+  stream.capacity = capacity;
+}
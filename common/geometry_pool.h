@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "upload_manager.h"
+
+//--------------------------------------------------------------------------------------------------
+// Scene-wide geometry buffers
+// - The vertices, indices, materials and material indices of all models are sub-allocated from one
+//   buffer per stream instead of four buffers per model. Shaders index the streams with the element
+//   offsets returned by add().
+// - A stream grows by doubling: a larger buffer is created and the content copied on the GPU in the
+//   upload batches, the old buffer is released when the copy completed. The number of allocations
+//   is logarithmic in the scene size and does not depend on the number of models.
+// - Buffers and addresses change when a stream grows: read them once all models are added.
+//
+class GeometryPool
+{
+public:
+  enum Stream
+  {
+    eVertices,
+    eIndices,
+    eMaterials,
+    eMaterialIndices,
+    eStreamCount
+  };
+
+  void init(nvvk::ResourceAllocator* alloc,
+            VkDevice                 device,
+            UploadManager*           upload,
+            VkDeviceSize             initialSize = 1024 * 1024);
+  void deinit();
+
+  // Appends `size` bytes at a multiple of `alignment`, returns their byte offset in the stream
+  VkDeviceSize add(Stream stream, const void* data, VkDeviceSize size, VkDeviceSize alignment);
+  // Appends the elements, returns the index of the first one in the stream
+  template <typename T>
+  uint32_t add(Stream stream, const std::vector<T>& data)
+  {
+    return static_cast<uint32_t>(add(stream, data.data(), sizeof(T) * data.size(), sizeof(T)) / sizeof(T));
+  }
+
+  const nvvk::Buffer& buffer(Stream stream) const { return m_streams[stream].buffer; }
+  VkDeviceSize        size(Stream stream) const { return m_streams[stream].size; }
+  VkDeviceAddress     address(Stream stream) const;
+  uint32_t            allocationCount() const { return m_allocationCount; }
+
+private:
+  struct StreamBuffer
+  {
+    nvvk::Buffer       buffer;
+    VkBufferUsageFlags usage{0};
+    VkDeviceSize       capacity{0};
+    VkDeviceSize       size{0};  // Bytes in use
+  };
+
+  void grow(StreamBuffer& stream, VkDeviceSize minCapacity);
+
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  VkDevice                 m_device{VK_NULL_HANDLE};
+  UploadManager*           m_upload{nullptr};
+  StreamBuffer             m_streams[eStreamCount];
+  uint32_t                 m_allocationCount{0};
+};
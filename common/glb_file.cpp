@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "glb_file.h"
+
+#include <cstring>
+
+namespace {
+constexpr uint32_t kGlbMagic   = 0x46546C67;  // "glTF"
+constexpr uint32_t kChunkJson  = 0x4E4F534A;  // "JSON"
+constexpr uint32_t kChunkBin   = 0x004E4942;  // "BIN\0"
+constexpr size_t   kHeaderSize = 12;
+
+uint32_t readU32(const uint8_t* data)
+{
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Layout: header (magic, version, length), then chunks (length, type, data padded to 4 bytes).
+// The first chunk is the JSON, the optional second one the BIN; other chunks are ignored.
+//
+bool GlbFile::open(const std::string& filename)
+{
+  close();
+  if(!m_file.open(filename))
+    return false;
+
+  const uint8_t* data = m_file.data();
+  const size_t   size = m_file.size();
+  if(size < kHeaderSize || readU32(data) != kGlbMagic || readU32(data + 4) != 2 || readU32(data + 8) > size)
+  {
+    close();
+    return false;
+  }
+
+  const size_t length = readU32(data + 8);
+  size_t       offset = kHeaderSize;
+  for(uint32_t chunk = 0; offset + 8 <= length; chunk++)
+  {
+    const size_t   chunkSize = readU32(data + offset);
+    const uint32_t chunkType = readU32(data + offset + 4);
+    offset += 8;
+    if(chunkSize > length - offset)
+      break;
+
+    if(chunk == 0 && chunkType == kChunkJson)
+    {
+      m_json     = reinterpret_cast<const char*>(data + offset);
+      m_jsonSize = chunkSize;
+    }
+    else if(chunk == 1 && chunkType == kChunkBin)
+    {
+      m_bin     = data + offset;
+      m_binSize = chunkSize;
+    }
+    offset += (chunkSize + 3) & ~size_t(3);
+  }
+
+  if(m_json == nullptr)
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void GlbFile::close()
+{
+  m_file.close();
+  m_json     = nullptr;
+  m_jsonSize = 0;
+  m_bin      = nullptr;
+  m_binSize  = 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "mapped_file.h"
+
+//--------------------------------------------------------------------------------------------------
+// Binary glTF (.glb) container, read through a memory mapping
+// The JSON and BIN chunks point in the mapped file: nothing is copied, and the pointers are valid
+// until close() or destruction.
+//
+class GlbFile
+{
+public:
+  // Returns false when the file cannot be mapped or is not a version 2 binary glTF
+  bool open(const std::string& filename);
+  void close();
+
+  const char*    json() const { return m_json; }
+  size_t         jsonSize() const { return m_jsonSize; }
+  const uint8_t* bin() const { return m_bin; }  // nullptr when the file has no BIN chunk
+  size_t         binSize() const { return m_binSize; }
+  size_t         fileSize() const { return m_file.size(); }
+
+private:
+  MappedFile     m_file;
+  const char*    m_json{nullptr};
+  size_t         m_jsonSize{0};
+  const uint8_t* m_bin{nullptr};
+  size_t         m_binSize{0};
+};
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "mesh_optimize.h"
+
+#include <algorithm>
+
+
+//--------------------------------------------------------------------------------------------------
+// Tipsify: from the current fanning vertex, all its remaining triangles are emitted. The next
+// fanning vertex is the one among the vertices just emitted that is the most likely to still be in
+// cache once all its triangles are done. When none qualifies, the most recently emitted vertex with
+// live triangles is taken (dead-end stack), and finally the next vertex in input order.
+//
+std::vector<uint32_t> MeshOptimizer::reorderTriangles(std::vector<uint32_t>& indices, uint32_t nbVertices, uint32_t cacheSize)
+{
+  const uint32_t nbTriangles = static_cast<uint32_t>(indices.size() / 3);
+
+  // Vertex -> triangles adjacency
+  std::vector<uint32_t> liveCount(nbVertices, 0);
+  for(uint32_t index : indices)
+    liveCount[index]++;
+  std::vector<uint32_t> offsets(nbVertices + 1, 0);
+  for(uint32_t v = 0; v < nbVertices; v++)
+    offsets[v + 1] = offsets[v] + liveCount[v];
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for(uint32_t t = 0; t < nbTriangles; t++)
+      for(uint32_t c = 0; c < 3; c++)
+        adjacency[fill[indices[t * 3 + c]]++] = t;
+  }
+
+  std::vector<uint32_t> cacheTime(nbVertices, 0);
+  std::vector<bool>     emitted(nbTriangles, false);
+  std::vector<uint32_t> deadEnd;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> order;
+  order.reserve(nbTriangles);
+
+  uint32_t timeStamp = cacheSize + 1;
+  uint32_t cursor    = 0;  // Next vertex in input order for the dead-end fallback
+  int64_t  fanning   = nbVertices > 0 ? 0 : -1;
+
+  while(fanning >= 0)
+  {
+    candidates.clear();
+    for(uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+    {
+      uint32_t t = adjacency[a];
+      if(emitted[t])
+        continue;
+      for(uint32_t c = 0; c < 3; c++)
+      {
+        uint32_t v = indices[t * 3 + c];
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        liveCount[v]--;
+        if(timeStamp - cacheTime[v] > cacheSize)
+          cacheTime[v] = timeStamp++;
+      }
+      emitted[t] = true;
+      order.push_back(t);
+    }
+
+    // Best candidate: still has triangles and will still be in cache after emitting them
+    fanning          = -1;
+    int64_t bestPrio = -1;
+    for(uint32_t v : candidates)
+    {
+      if(liveCount[v] == 0)
+        continue;
+      int64_t prio = 0;
+      if(timeStamp - cacheTime[v] + 2 * liveCount[v] <= cacheSize)
+        prio = timeStamp - cacheTime[v];
+      if(prio > bestPrio)
+      {
+        bestPrio = prio;
+        fanning  = v;
+      }
+    }
+
+    // Dead end
+    while(fanning < 0 && !deadEnd.empty())
+    {
+      uint32_t v = deadEnd.back();
+      deadEnd.pop_back();
+      if(liveCount[v] > 0)
+        fanning = v;
+    }
+    while(fanning < 0 && cursor < nbVertices)
+    {
+      if(liveCount[cursor] > 0)
+        fanning = cursor;
+      cursor++;
+    }
+  }
+
+  std::vector<uint32_t> reordered(order.size() * 3);
+  for(size_t t = 0; t < order.size(); t++)
+    for(uint32_t c = 0; c < 3; c++)
+      reordered[t * 3 + c] = indices[order[t] * 3 + c];
+  indices.swap(reordered);
+
+  return order;
+}
+
+std::vector<uint32_t> MeshOptimizer::reorderVertices(std::vector<uint32_t>& indices, uint32_t nbVertices)
+{
+  std::vector<uint32_t> remap(nbVertices, ~0u);
+  uint32_t              next = 0;
+  for(uint32_t& index : indices)
+  {
+    if(remap[index] == ~0u)
+      remap[index] = next++;
+    index = remap[index];
+  }
+  return remap;
+}
+
+//--------------------------------------------------------------------------------------------------
+// FIFO cache of `cacheSize` entries: a vertex is in cache when fewer than `cacheSize` misses
+// happened since it was loaded.
+//
+uint64_t MeshOptimizer::cacheMisses(const std::vector<uint32_t>& indices, uint32_t nbVertices, uint32_t cacheSize)
+{
+  std::vector<uint64_t> loadTime(nbVertices, 0);
+  uint64_t              misses = cacheSize + 1;
+  for(uint32_t index : indices)
+  {
+    if(misses - loadTime[index] > cacheSize)
+      loadTime[index] = misses++;
+  }
+  return misses - (cacheSize + 1);
+}
+
+float MeshOptimizer::acmr(const std::vector<uint32_t>& indices, uint32_t nbVertices, uint32_t cacheSize)
+{
+  size_t nbTriangles = indices.size() / 3;
+  return nbTriangles ? float(cacheMisses(indices, nbVertices, cacheSize)) / float(nbTriangles) : 0.f;
+}
+
+float MeshOptimizer::atvr(const std::vector<uint32_t>& indices, uint32_t nbVertices, uint32_t cacheSize)
+{
+  return nbVertices ? float(cacheMisses(indices, nbVertices, cacheSize)) / float(nbVertices) : 0.f;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Reordering of indexed triangle lists for the GPU
+// - reorderTriangles: Tipsify (Sander et al. 2007), triangles are emitted in fans around vertices
+//   still in the post-transform cache, which also keeps consecutive triangles spatially close
+// - reorderVertices: vertices are renumbered in order of first use, for linear fetches
+// - acmr/atvr: vertex transforms per triangle / per vertex, simulating a FIFO cache
+//
+class MeshOptimizer
+{
+public:
+  static constexpr uint32_t kCacheSize = 16;
+
+  // Reorders the triangles of `indices`, returns for each new triangle its original index
+  static std::vector<uint32_t> reorderTriangles(std::vector<uint32_t>& indices, uint32_t nbVertices, uint32_t cacheSize = kCacheSize);
+  // Renumbers the vertices of `indices`, returns for each original vertex its new index (~0u when unused)
+  static std::vector<uint32_t> reorderVertices(std::vector<uint32_t>& indices, uint32_t nbVertices);
+
+  static float acmr(const std::vector<uint32_t>& indices, uint32_t nbVertices, uint32_t cacheSize = kCacheSize);
+  static float atvr(const std::vector<uint32_t>& indices, uint32_t nbVertices, uint32_t cacheSize = kCacheSize);
+
+private:
+  static uint64_t cacheMisses(const std::vector<uint32_t>& indices, uint32_t nbVertices, uint32_t cacheSize);
+};
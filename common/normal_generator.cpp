@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "normal_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NORMAL_GENERATOR_SSE 1
+#endif
+
+
+void NormalGenerator::faceDataScalar(const std::vector<VertexObj>& vertices,
+                                     const std::vector<uint32_t>&  indices,
+                                     size_t                        begin,
+                                     size_t                        end,
+                                     FaceData*                     out)
+{
+  for(size_t t = begin; t < end; t++)
+  {
+    const glm::vec3& p0 = vertices[indices[t * 3 + 0]].pos;
+    const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+    const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+    glm::vec3        e1 = p1 - p0;
+    glm::vec3        e2 = p2 - p0;
+    glm::vec3        e3 = p2 - p1;
+    glm::vec3        n  = glm::cross(e1, e2);
+    float            l  = std::sqrt(glm::dot(n, n));
+
+    FaceData& f = out[t - begin];
+    f.normal    = l > 0.f ? n * (1.f / l) : glm::vec3(0.f);
+    f.area2     = l;
+    // Corner angles from |e x e'| = 2 * area and their dot products
+    f.angle[0] = std::atan2(l, glm::dot(e1, e2));
+    f.angle[1] = std::atan2(l, -glm::dot(e1, e3));
+    f.angle[2] = std::atan2(l, glm::dot(e2, e3));
+  }
+}
+
+void NormalGenerator::faceData(const std::vector<VertexObj>& vertices,
+                               const std::vector<uint32_t>&  indices,
+                               size_t                        begin,
+                               size_t                        end,
+                               FaceData*                     out)
+{
+  size_t t = begin;
+#ifdef NORMAL_GENERATOR_SSE
+  // 4 triangles per iteration, positions transposed to x/y/z registers
+  for(; t + 4 <= end; t += 4)
+  {
+    __m128 p[3][3];
+    for(int k = 0; k < 3; k++)
+    {
+      const glm::vec3& a = vertices[indices[t * 3 + k]].pos;
+      const glm::vec3& b = vertices[indices[t * 3 + 3 + k]].pos;
+      const glm::vec3& c = vertices[indices[t * 3 + 6 + k]].pos;
+      const glm::vec3& d = vertices[indices[t * 3 + 9 + k]].pos;
+      p[k][0]            = _mm_setr_ps(a.x, b.x, c.x, d.x);
+      p[k][1]            = _mm_setr_ps(a.y, b.y, c.y, d.y);
+      p[k][2]            = _mm_setr_ps(a.z, b.z, c.z, d.z);
+    }
+    __m128 e1[3], e2[3], e3[3];
+    for(int i = 0; i < 3; i++)
+    {
+      e1[i] = _mm_sub_ps(p[1][i], p[0][i]);
+      e2[i] = _mm_sub_ps(p[2][i], p[0][i]);
+      e3[i] = _mm_sub_ps(p[2][i], p[1][i]);
+    }
+    __m128 nx = _mm_sub_ps(_mm_mul_ps(e1[1], e2[2]), _mm_mul_ps(e1[2], e2[1]));
+    __m128 ny = _mm_sub_ps(_mm_mul_ps(e1[2], e2[0]), _mm_mul_ps(e1[0], e2[2]));
+    __m128 nz = _mm_sub_ps(_mm_mul_ps(e1[0], e2[1]), _mm_mul_ps(e1[1], e2[0]));
+    __m128 l  = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+    // Normalized, 0 for degenerated triangles
+    __m128 valid = _mm_cmpgt_ps(l, _mm_setzero_ps());
+    __m128 inv   = _mm_div_ps(_mm_set1_ps(1.f), l);
+    nx           = _mm_and_ps(_mm_mul_ps(nx, inv), valid);
+    ny           = _mm_and_ps(_mm_mul_ps(ny, inv), valid);
+    nz           = _mm_and_ps(_mm_mul_ps(nz, inv), valid);
+
+    auto   dot = [](const __m128* a, const __m128* b) {
+      return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+    };
+    __m128 d0 = dot(e1, e2);
+    __m128 d1 = _mm_xor_ps(dot(e1, e3), _mm_set1_ps(-0.f));  // Negated as in the scalar code: -0 when 0, for atan2
+    __m128 d2 = dot(e2, e3);
+
+    alignas(16) float r[7][4];
+    _mm_store_ps(r[0], nx);
+    _mm_store_ps(r[1], ny);
+    _mm_store_ps(r[2], nz);
+    _mm_store_ps(r[3], l);
+    _mm_store_ps(r[4], d0);
+    _mm_store_ps(r[5], d1);
+    _mm_store_ps(r[6], d2);
+    for(int j = 0; j < 4; j++)
+    {
+      FaceData& f = out[t + j - begin];
+      f.normal    = {r[0][j], r[1][j], r[2][j]};
+      f.area2     = r[3][j];
+      f.angle[0]  = std::atan2(r[3][j], r[4][j]);
+      f.angle[1]  = std::atan2(r[3][j], r[5][j]);
+      f.angle[2]  = std::atan2(r[3][j], r[6][j]);
+    }
+  }
+#endif
+  faceDataScalar(vertices, indices, t, end, out + (t - begin));
+}
+
+//--------------------------------------------------------------------------------------------------
+// Smooth normals:
+// 1. Face data, in parallel
+// 2. Position id per corner: corners are bucketed on a hash of their position bits into a fixed
+//    number of shards, each shard numbers its positions in its own task
+// 3. Corners are bucketed by position id (counting sort), then each position sums the weighted
+//    normals of its corners' triangles, in parallel and without atomics
+//
+void NormalGenerator::generate(std::vector<VertexObj>&      vertices,
+                               const std::vector<uint32_t>& indices,
+                               NormalMode                   mode,
+                               float                        creaseAngle,
+                               ThreadPool&                  pool)
+{
+  const size_t nbTriangles = indices.size() / 3;
+  const size_t nbCorners   = nbTriangles * 3;
+  const size_t kBatch      = 16 * 1024;
+
+  std::vector<FaceData> faces(nbTriangles);
+  pool.parallelBatches(nbTriangles, kBatch, [&](size_t begin, size_t end) {
+    faceData(vertices, indices, begin, end, faces.data() + begin);
+  });
+
+  if(mode == NormalMode::eFlat)
+  {
+    pool.parallelBatches(nbCorners, kBatch, [&](size_t begin, size_t end) {
+      for(size_t c = begin; c < end; c++)
+        vertices[indices[c]].nrm = faces[c / 3].normal;
+    });
+    return;
+  }
+
+  // Position ids, numbered per shard
+  const uint32_t       kNbShards = 64;
+  std::vector<uint8_t> shardOf(nbCorners);
+  pool.parallelBatches(nbCorners, kBatch, [&](size_t begin, size_t end) {
+    for(size_t c = begin; c < end; c++)
+    {
+      uint32_t bits[3];
+      memcpy(bits, &vertices[indices[c]].pos, sizeof(bits));
+      uint64_t h = 14695981039346656037ull;
+      for(uint32_t b : bits)
+        h = (h ^ b) * 1099511628211ull;
+      shardOf[c] = static_cast<uint8_t>((h ^ (h >> 32)) % kNbShards);
+    }
+  });
+
+  std::vector<uint32_t> shardCorners(nbCorners);
+  std::vector<uint32_t> shardBegin(kNbShards + 1, 0);
+  for(size_t c = 0; c < nbCorners; c++)
+    shardBegin[shardOf[c] + 1]++;
+  for(uint32_t s = 0; s < kNbShards; s++)
+    shardBegin[s + 1] += shardBegin[s];
+  {
+    std::vector<uint32_t> fill(shardBegin.begin(), shardBegin.end() - 1);
+    for(size_t c = 0; c < nbCorners; c++)
+      shardCorners[fill[shardOf[c]]++] = static_cast<uint32_t>(c);
+  }
+
+  std::vector<uint32_t> positionId(nbCorners);
+  std::vector<uint32_t> shardCount(kNbShards, 0);
+  pool.parallelBatches(kNbShards, 1, [&](size_t shard, size_t) {
+    // Open addressing table of corners, keyed on their position bits
+    const uint32_t        count    = shardBegin[shard + 1] - shardBegin[shard];
+    uint32_t              capacity = 16;
+    while(capacity < count * 2)
+      capacity *= 2;
+    std::vector<uint32_t> table(capacity, ~0u);  // First corner of each position
+    uint32_t              nbIds = 0;
+    for(uint32_t i = shardBegin[shard]; i < shardBegin[shard + 1]; i++)
+    {
+      const uint32_t   c = shardCorners[i];
+      const glm::vec3& p = vertices[indices[c]].pos;
+      uint32_t         bits[3];
+      memcpy(bits, &p, sizeof(bits));
+      uint32_t slot = (bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u) & (capacity - 1);
+      for(;; slot = (slot + 1) & (capacity - 1))
+      {
+        if(table[slot] == ~0u)
+        {
+          table[slot]   = c;
+          positionId[c] = nbIds++;
+          break;
+        }
+        if(memcmp(&vertices[indices[table[slot]]].pos, &p, sizeof(glm::vec3)) == 0)
+        {
+          positionId[c] = positionId[table[slot]];
+          break;
+        }
+      }
+    }
+    shardCount[shard] = nbIds;
+  });
+  shardCorners = {};
+
+  std::vector<uint32_t> shardOffset(kNbShards + 1, 0);
+  for(uint32_t s = 0; s < kNbShards; s++)
+    shardOffset[s + 1] = shardOffset[s] + shardCount[s];
+  const uint32_t nbPositions = shardOffset[kNbShards];
+
+  // Corners per position
+  std::vector<uint32_t> cornerOffset(nbPositions + 1, 0);
+  for(size_t c = 0; c < nbCorners; c++)
+  {
+    positionId[c] += shardOffset[shardOf[c]];
+    cornerOffset[positionId[c] + 1]++;
+  }
+  shardOf = {};
+  for(uint32_t p = 0; p < nbPositions; p++)
+    cornerOffset[p + 1] += cornerOffset[p];
+  std::vector<uint32_t> corners(nbCorners);
+  {
+    std::vector<uint32_t> fill(cornerOffset.begin(), cornerOffset.end() - 1);
+    for(size_t c = 0; c < nbCorners; c++)
+      corners[fill[positionId[c]]++] = static_cast<uint32_t>(c);
+  }
+
+  const float cosCrease = std::cos(glm::radians(std::min(creaseAngle, 180.f)));
+  const bool  angle     = mode == NormalMode::eSmoothAngle;
+  pool.parallelBatches(nbPositions, 4096, [&](size_t begin, size_t end) {
+    std::vector<glm::vec4> around;  // Normal and weight of the triangles around the position
+    for(size_t p = begin; p < end; p++)
+    {
+      around.clear();
+      for(uint32_t i = cornerOffset[p]; i < cornerOffset[p + 1]; i++)
+      {
+        const FaceData& f = faces[corners[i] / 3];
+        around.emplace_back(f.normal, angle ? f.angle[corners[i] % 3] : f.area2);
+      }
+      for(uint32_t i = cornerOffset[p]; i < cornerOffset[p + 1]; i++)
+      {
+        const glm::vec4& self = around[i - cornerOffset[p]];
+        const glm::vec3  faceN(self.x, self.y, self.z);
+        glm::vec3        sum(0.f);
+        for(const glm::vec4& a : around)
+        {
+          glm::vec3 n(a.x, a.y, a.z);
+          if(&a == &self || glm::dot(n, faceN) >= cosCrease)
+            sum += n * a.w;
+        }
+        float l                           = glm::length(sum);
+        vertices[indices[corners[i]]].nrm = l > 0.f ? sum / l : faceN;
+      }
+    }
+  });
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "obj_loader.h"
+#include "thread_pool.h"
+
+//--------------------------------------------------------------------------------------------------
+// Normals for meshes without them (see NormalMode)
+// - Face normals are computed 4 triangles at a time with SSE (scalar elsewhere)
+// - Smooth normals: corners are grouped by position, then each position is reduced in parallel.
+//   Triangles whose normal is more than the crease angle away from the corner's triangle do not
+//   contribute, keeping hard edges.
+// Each corner must own its vertex, as the loaders emit them before welding.
+//
+class NormalGenerator
+{
+public:
+  static void generate(std::vector<VertexObj>&      vertices,
+                       const std::vector<uint32_t>& indices,
+                       NormalMode                   mode,
+                       float                        creaseAngle = 60.f,  // Degrees
+                       ThreadPool&                  pool        = ThreadPool::global());
+
+  // Unit normal, doubled area and corner angles (radians) of triangles [begin, end)
+  struct FaceData
+  {
+    glm::vec3 normal;
+    float     area2;
+    float     angle[3];
+  };
+  static void faceData(const std::vector<VertexObj>& vertices,
+                       const std::vector<uint32_t>&  indices,
+                       size_t                        begin,
+                       size_t                        end,
+                       FaceData*                     out);
+  // Same without SIMD, the reference for faceData()
+  static void faceDataScalar(const std::vector<VertexObj>& vertices,
+                             const std::vector<uint32_t>&  indices,
+                             size_t                        begin,
+                             size_t                        end,
+                             FaceData*                     out);
+};
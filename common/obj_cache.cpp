@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "obj_cache.h"
+#include "nvh/nvprint.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+const char     kMagic[8]  = {'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E'};
+const uint64_t kAlignment = 64;
+
+uint64_t alignUp(uint64_t v)
+{
+  return (v + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+template <typename T>
+void copySection(const uint8_t* base, uint64_t offset, uint64_t count, std::vector<T>& out)
+{
+  out.resize(count);
+  if(count)
+    memcpy(out.data(), base + offset, count * sizeof(T));
+}
+
+// Null terminated strings of a section, false when the last one is not terminated (truncated or
+// corrupt cache): the strings never extend past the section
+bool readNames(const uint8_t* base, uint64_t offset, uint64_t size, std::vector<std::string>& out)
+{
+  out.clear();
+  const char* names    = reinterpret_cast<const char*>(base + offset);
+  const char* namesEnd = names + size;
+  while(names < namesEnd)
+  {
+    size_t length = strnlen(names, namesEnd - names);
+    if(length == static_cast<size_t>(namesEnd - names))
+      return false;
+    out.emplace_back(names, length);
+    names += length + 1;
+  }
+  return true;
+}
+}  // namespace
+
+
+bool ObjCache::sourceKey(const std::string& objFilename, uint64_t& size, int64_t& time)
+{
+  std::error_code ec;
+  size = std::filesystem::file_size(objFilename, ec);
+  if(ec)
+    return false;
+  time = static_cast<int64_t>(std::filesystem::last_write_time(objFilename, ec).time_since_epoch().count());
+  return !ec;
+}
+
+ObjCache::FileKey ObjCache::fileKey(const std::string& filename)
+{
+  FileKey key{kMissing, 0};
+  if(!sourceKey(filename, key.size, key.time))
+    key = {kMissing, 0};
+  return key;
+}
+
+//--------------------------------------------------------------------------------------------------
+// All names of the `mtllib` lines, relative to the directory of the OBJ as for tinyobj and
+// ObjParser. Names that do not exist are kept: creating one of them also invalidates the cache.
+//
+void ObjCache::materialFiles(const MappedFile& obj, const std::string& objFilename, std::vector<std::string>& files)
+{
+  std::string searchPath;
+  size_t      slash = objFilename.find_last_of("/\\");
+  if(slash != std::string::npos)
+    searchPath = objFilename.substr(0, slash + 1);
+
+  auto        isSpace = [](char c) { return c == ' ' || c == '\t'; };
+  const char* p       = reinterpret_cast<const char*>(obj.data());
+  const char* end     = p + obj.size();
+  while(p < end)
+  {
+    const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    eol             = eol ? eol : end;
+    while(p < eol && isSpace(*p))
+      p++;
+    if(eol - p > 6 && memcmp(p, "mtllib", 6) == 0 && isSpace(p[6]))
+    {
+      p += 6;
+      while(p < eol)
+      {
+        while(p < eol && (isSpace(*p) || *p == '\r'))
+          p++;
+        const char* token = p;
+        while(p < eol && !isSpace(*p) && *p != '\r')
+          p++;
+        if(p > token)
+          files.push_back(searchPath + std::string(token, p));
+      }
+    }
+    p = eol + 1;
+  }
+}
+
+bool ObjCache::read(const std::string& objFilename, uint32_t options, ObjLoader& loader)
+{
+  uint64_t sourceSize;
+  int64_t  sourceTime;
+  if(!sourceKey(objFilename, sourceSize, sourceTime))
+    return false;
+
+  MappedFile file;
+  if(!file.open(cacheFilename(objFilename)) || file.size() < sizeof(Header))
+    return false;
+
+  const uint8_t* base = file.data();
+  Header         header;
+  memcpy(&header, base, sizeof(Header));
+  if(memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || header.options != options
+     || header.sourceSize != sourceSize || header.sourceTime != sourceTime || header.nbSections != eNbSections)
+    return false;
+
+  uint64_t tableOffset = sizeof(Header) + header.pathLength;
+  if(tableOffset + sizeof(Section) * eNbSections > file.size() || header.pathLength != objFilename.size()
+     || memcmp(base + sizeof(Header), objFilename.data(), header.pathLength) != 0)
+    return false;
+
+  Section sections[eNbSections];
+  memcpy(sections, base + tableOffset, sizeof(sections));
+
+  const uint32_t elementSizes[eNbSections] = {sizeof(VertexObj), sizeof(uint32_t), sizeof(MaterialObj), sizeof(int32_t),
+                                             1, 1, sizeof(FileKey)};
+  for(uint32_t i = 0; i < eNbSections; i++)
+  {
+    const Section& s = sections[i];
+    if(s.id != i || s.elementSize != elementSizes[i] || s.offset > file.size()
+       || s.count > (file.size() - s.offset) / s.elementSize)
+      return false;
+  }
+
+  // Checked before filling the loader, which must stay empty when the cache is rejected
+  std::vector<std::string> textures;
+  if(!readNames(base, sections[eTextures].offset, sections[eTextures].count, textures))
+    return false;
+
+  // The materials come from the MTL files, which must not have changed either
+  std::vector<std::string> materialFiles;
+  if(!readNames(base, sections[eMaterialFiles].offset, sections[eMaterialFiles].count, materialFiles)
+     || materialFiles.size() != sections[eMaterialKeys].count)
+    return false;
+  for(size_t i = 0; i < materialFiles.size(); i++)
+  {
+    FileKey cached;
+    memcpy(&cached, base + sections[eMaterialKeys].offset + i * sizeof(FileKey), sizeof(FileKey));
+    FileKey current = fileKey(materialFiles[i]);
+    if(cached.size != current.size || cached.time != current.time)
+      return false;
+  }
+
+  copySection(base, sections[eVertices].offset, sections[eVertices].count, loader.m_vertices);
+  copySection(base, sections[eIndices].offset, sections[eIndices].count, loader.m_indices);
+  copySection(base, sections[eMaterials].offset, sections[eMaterials].count, loader.m_materials);
+  copySection(base, sections[eMatIndices].offset, sections[eMatIndices].count, loader.m_matIndx);
+  loader.m_textures.swap(textures);
+
+  return true;
+}
+
+bool ObjCache::write(const std::string& objFilename, uint32_t options, const ObjLoader& loader)
+{
+  Header header{};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version    = kVersion;
+  header.options    = options;
+  header.pathLength = static_cast<uint32_t>(objFilename.size());
+  header.nbSections = eNbSections;
+  if(!sourceKey(objFilename, header.sourceSize, header.sourceTime))
+    return false;
+
+  std::string textureNames;
+  for(const auto& name : loader.m_textures)
+    textureNames.append(name.c_str(), name.size() + 1);
+
+  // The OBJ is mapped again only for its `mtllib` lines, on the cold path
+  std::vector<std::string> materialFileList;
+  {
+    MappedFile obj;
+    if(!obj.open(objFilename))
+      return false;
+    materialFiles(obj, objFilename, materialFileList);
+  }
+  std::string          materialFileNames;
+  std::vector<FileKey> materialKeys;
+  for(const auto& name : materialFileList)
+  {
+    materialFileNames.append(name.c_str(), name.size() + 1);
+    materialKeys.push_back(fileKey(name));
+  }
+
+  const void* blobs[eNbSections] = {loader.m_vertices.data(), loader.m_indices.data(), loader.m_materials.data(),
+                                    loader.m_matIndx.data(), textureNames.data(), materialFileNames.data(),
+                                    materialKeys.data()};
+  Section     sections[eNbSections] = {
+      {eVertices, sizeof(VertexObj), 0, loader.m_vertices.size()},
+      {eIndices, sizeof(uint32_t), 0, loader.m_indices.size()},
+      {eMaterials, sizeof(MaterialObj), 0, loader.m_materials.size()},
+      {eMatIndices, sizeof(int32_t), 0, loader.m_matIndx.size()},
+      {eTextures, 1, 0, textureNames.size()},
+      {eMaterialFiles, 1, 0, materialFileNames.size()},
+      {eMaterialKeys, sizeof(FileKey), 0, materialKeys.size()},
+  };
+
+  uint64_t offset = alignUp(sizeof(Header) + header.pathLength + sizeof(sections));
+  for(auto& s : sections)
+  {
+    s.offset = offset;
+    offset   = alignUp(offset + s.count * s.elementSize);
+  }
+
+  // Written to a temporary file first, so a concurrent reader never sees a partial cache
+  std::string cacheName = cacheFilename(objFilename);
+  std::string tempName  = cacheName + ".tmp";
+  {
+    std::ofstream out(tempName, std::ios::binary | std::ios::trunc);
+    if(!out)
+      return false;
+
+    const char zeros[kAlignment] = {};
+    auto       pad               = [&]() {
+      uint64_t pos = static_cast<uint64_t>(out.tellp());
+      out.write(zeros, alignUp(pos) - pos);
+    };
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    out.write(objFilename.data(), objFilename.size());
+    out.write(reinterpret_cast<const char*>(sections), sizeof(sections));
+    for(uint32_t i = 0; i < eNbSections; i++)
+    {
+      pad();
+      out.write(static_cast<const char*>(blobs[i]), sections[i].count * sections[i].elementSize);
+    }
+    if(!out)
+      return false;
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tempName, cacheName, ec);
+  if(ec)
+  {
+    std::filesystem::remove(tempName, ec);
+    return false;
+  }
+  return true;
+}
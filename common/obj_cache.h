@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "mapped_file.h"
+#include "obj_loader.h"
+
+//--------------------------------------------------------------------------------------------------
+// Binary cache of the ObjLoader result, stored next to the OBJ as <file>.objcache
+//
+// Layout (little endian, all blobs aligned to 64 bytes):
+//   Header | source path | Section table | blobs...
+// The cache is valid when version, loader options, source path, size and modification time match,
+// and the size and modification time of each material library named by `mtllib` lines too: a warm
+// load does not read the MTL files.
+// It is read through a memory mapping: the arrays are copied from the mapped pages, nothing is parsed.
+//
+class ObjCache
+{
+public:
+  static constexpr uint32_t kVersion = 2;
+
+  static std::string cacheFilename(const std::string& objFilename) { return objFilename + ".objcache"; }
+
+  // Returns false when there is no valid cache for this file and options
+  static bool read(const std::string& objFilename, uint32_t options, ObjLoader& loader);
+  static bool write(const std::string& objFilename, uint32_t options, const ObjLoader& loader);
+
+private:
+  enum SectionId : uint32_t
+  {
+    eVertices,
+    eIndices,
+    eMaterials,
+    eMatIndices,
+    eTextures,       // Texture names, each one null terminated
+    eMaterialFiles,  // Paths of the MTL files named by the OBJ, each one null terminated
+    eMaterialKeys,   // FileKey of each MTL file, in the same order
+    eNbSections
+  };
+
+  struct Header
+  {
+    char     magic[8];
+    uint32_t version;
+    uint32_t options;
+    uint64_t sourceSize;
+    int64_t  sourceTime;
+    uint32_t pathLength;
+    uint32_t nbSections;
+  };
+
+  struct Section
+  {
+    uint32_t id;
+    uint32_t elementSize;
+    uint64_t offset;  // From the start of the file
+    uint64_t count;
+  };
+
+  // Size and modification time of a file, kMissing when it does not exist
+  struct FileKey
+  {
+    uint64_t size;
+    int64_t  time;
+  };
+  static constexpr uint64_t kMissing = ~0ull;
+
+  static bool    sourceKey(const std::string& objFilename, uint64_t& size, int64_t& time);
+  static FileKey fileKey(const std::string& filename);
+  // Paths of the files named by the `mtllib` lines, resolved as the parsers do
+  static void materialFiles(const MappedFile& obj, const std::string& objFilename, std::vector<std::string>& files);
+};
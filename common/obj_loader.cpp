@@ -21,43 +21,394 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "obj_loader.h"
 #include "nvh/nvprint.hpp"
+#include "mesh_optimize.h"
+#include "normal_generator.h"
+#include "obj_cache.h"
+#include "obj_parser.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 
 
 void ObjLoader::loadModel(const std::string& filename)
 {
-  tinyobj::ObjReader reader;
-  reader.ParseFromFile(filename);
-  if(!reader.Valid())
+  auto start   = std::chrono::high_resolution_clock::now();
+  auto elapsed = [&]() {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+  };
+
+  // Warm start: the result of a previous load of the same file
+  if(m_useCache && ObjCache::read(filename, cacheOptions(), *this))
   {
-    LOGE("Cannot load %s: %s", filename.c_str(), reader.Error().c_str());
-    assert(reader.Valid());
+    extractPositions();
+    LOGI("Loaded %s from cache in %.2f ms (warm)\n", ObjCache::cacheFilename(filename).c_str(), elapsed());
+    return;
   }
 
-  // Collecting the material in the scene
-  for(const auto& material : reader.GetMaterials())
+  bool        hasNormals = false;
+  bool        welded     = false;  // Streaming already welded the vertices
+  const char* path       = "tinyobj";
+  if(m_streamWindow > 0 && loadStreaming(filename, hasNormals, welded))
+    path = "streaming";
+  else if(m_parallelParse && loadParallel(filename, hasNormals))
+    path = "parallel";
+  else
+    hasNormals = loadTinyObj(filename);
+
+  std::error_code ec;
+  double          sizeMB = static_cast<double>(std::filesystem::file_size(filename, ec)) / (1024.0 * 1024.0);
+  double          timeMs = elapsed();
+  LOGI("Parsed %.2f MB in %.2f ms (%.1f MB/s, %s)\n", sizeMB, timeMs, sizeMB / (timeMs / 1000.0), path);
+
+  // Fixing material indices
+  for(auto& mi : m_matIndx)
   {
-    MaterialObj m;
-    m.ambient       = glm::vec3(material.ambient[0], material.ambient[1], material.ambient[2]);
-    m.diffuse       = glm::vec3(material.diffuse[0], material.diffuse[1], material.diffuse[2]);
-    m.specular      = glm::vec3(material.specular[0], material.specular[1], material.specular[2]);
-    m.emission      = glm::vec3(material.emission[0], material.emission[1], material.emission[2]);
-    m.transmittance = glm::vec3(material.transmittance[0], material.transmittance[1], material.transmittance[2]);
-    m.dissolve      = material.dissolve;
-    m.ior           = material.ior;
-    m.shininess     = material.shininess;
-    m.illum         = material.illum;
-    if(!material.diffuse_texname.empty())
+    if(mi < 0 || mi > m_materials.size())
+      mi = 0;
+  }
+
+
+  // Compute normal when no normal were provided.
+  // Done before welding: each face still owns its vertices, so normals are not overwritten.
+  if(!hasNormals)
+  {
+    double normalStart = elapsed();
+    NormalGenerator::generate(m_vertices, m_indices, m_normalMode, m_creaseAngle);
+    LOGI("Generated %s normals in %.2f ms\n", m_normalMode == NormalMode::eFlat ? "flat" : "smooth",
+         elapsed() - normalStart);
+  }
+
+  if(m_weld && !welded)
+    weldVertices();
+  if(m_optimize)
+    optimizeMesh();
+
+  extractPositions();
+
+  if(m_useCache)
+  {
+    bool written = ObjCache::write(filename, cacheOptions(), *this);
+    LOGI("Loaded %s in %.2f ms (cold%s)\n", filename.c_str(), elapsed(), written ? ", cache written" : ", cache not written");
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Options changing the loaded data, a cache written with other options is not used
+// Streaming welds by (v, vt, vn) index instead of bitwise: its vertices and indices can differ
+//
+uint32_t ObjLoader::cacheOptions() const
+{
+  uint32_t options = (m_weld ? 1u : 0u) | (m_optimize ? 2u : 0u) | (static_cast<uint32_t>(m_normalMode) << 2);
+  if(m_streamWindow > 0)
+    options |= 16u;
+  if(m_normalMode != NormalMode::eFlat)
+    options |= static_cast<uint32_t>(m_creaseAngle * 10.f) << 8;
+  return options;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The loader emits one vertex per face corner. Vertices sharing all attributes are merged, which
+// shrinks the vertex buffer and gives the index buffer real reuse.
+// Vertices are compared bitwise, so the result is exact and the order of first use is kept.
+//
+void ObjLoader::weldVertices()
+{
+  static_assert(sizeof(VertexObj) == 11 * sizeof(float), "VertexObj must not have padding to be hashed");
+
+  struct VertexHash
+  {
+    size_t operator()(const VertexObj& v) const
     {
-      m_textures.push_back(material.diffuse_texname);
-      m.textureID = static_cast<int>(m_textures.size()) - 1;
+      // FNV-1a over the raw bytes
+      const auto* bytes = reinterpret_cast<const uint8_t*>(&v);
+      uint64_t    hash  = 14695981039346656037ull;
+      for(size_t i = 0; i < sizeof(VertexObj); i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+      return static_cast<size_t>(hash);
     }
+  };
+  struct VertexEqual
+  {
+    bool operator()(const VertexObj& a, const VertexObj& b) const { return memcmp(&a, &b, sizeof(VertexObj)) == 0; }
+  };
 
-    m_materials.emplace_back(m);
+  const size_t nbBefore = m_vertices.size();
+
+  std::unordered_map<VertexObj, uint32_t, VertexHash, VertexEqual> uniqueVertices;
+  uniqueVertices.reserve(nbBefore);
+
+  std::vector<VertexObj> vertices;
+  vertices.reserve(nbBefore);
+  for(auto& index : m_indices)
+  {
+    const VertexObj& vertex = m_vertices[index];
+    auto             it     = uniqueVertices.find(vertex);
+    if(it == uniqueVertices.end())
+    {
+      it = uniqueVertices.emplace(vertex, static_cast<uint32_t>(vertices.size())).first;
+      vertices.push_back(vertex);
+    }
+    index = it->second;
   }
+  vertices.shrink_to_fit();
+  m_vertices.swap(vertices);
 
-  // If there were none, add a default
-  if(m_materials.empty())
-    m_materials.emplace_back(MaterialObj());
+  LOGI("Welded vertices: %zu -> %zu (%zu indices)\n", nbBefore, m_vertices.size(), m_indices.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+// The triangle order of the file is rarely good for the post-transform cache. Triangles are
+// reordered (the material per triangle follows), then vertices are renumbered by first use.
+//
+void ObjLoader::optimizeMesh()
+{
+  const uint32_t nbVertices = static_cast<uint32_t>(m_vertices.size());
+  const float    acmrBefore = MeshOptimizer::acmr(m_indices, nbVertices);
+  const float    atvrBefore = MeshOptimizer::atvr(m_indices, nbVertices);
+
+  std::vector<uint32_t> triangleOrder = MeshOptimizer::reorderTriangles(m_indices, nbVertices);
+  if(m_matIndx.size() == triangleOrder.size())
+  {
+    std::vector<int32_t> matIndx(m_matIndx.size());
+    for(size_t t = 0; t < triangleOrder.size(); t++)
+      matIndx[t] = m_matIndx[triangleOrder[t]];
+    m_matIndx.swap(matIndx);
+  }
+
+  std::vector<uint32_t>  remap = MeshOptimizer::reorderVertices(m_indices, nbVertices);
+  std::vector<VertexObj> vertices(m_vertices.size());
+  uint32_t               used = 0;
+  for(uint32_t v = 0; v < nbVertices; v++)
+  {
+    if(remap[v] != ~0u)
+    {
+      vertices[remap[v]] = m_vertices[v];
+      used++;
+    }
+  }
+  vertices.resize(used);
+  m_vertices.swap(vertices);
+
+  LOGI("Optimized mesh: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (FIFO %u)\n", acmrBefore,
+       MeshOptimizer::acmr(m_indices, used), atvrBefore, MeshOptimizer::atvr(m_indices, used), MeshOptimizer::kCacheSize);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Positions are also kept in their own tightly packed stream: the BLAS build and position-only
+// passes read 12 bytes per vertex instead of striding over the whole VertexObj.
+//
+void ObjLoader::extractPositions()
+{
+  m_positions.resize(m_vertices.size());
+  for(size_t i = 0; i < m_vertices.size(); i++)
+    m_positions[i] = m_vertices[i].pos;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Octahedral normal encoding: the normal is projected on the octahedron |x|+|y|+|z| = 1 and the
+// lower half is folded over the upper one, which maps the sphere onto the [-1,1] square.
+// Of the four snorm16 values around the projection, the one decoding closest to the normal is kept.
+// Must match octDecode() in wavefront.glsl
+//
+static glm::vec3 octDecode(glm::vec2 e)
+{
+  glm::vec3 n(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+  if(n.z < 0.f)
+  {
+    n.x = (1.f - std::abs(e.y)) * (e.x >= 0.f ? 1.f : -1.f);
+    n.y = (1.f - std::abs(e.x)) * (e.y >= 0.f ? 1.f : -1.f);
+  }
+  return glm::normalize(n);
+}
+
+static uint32_t octEncode(const glm::vec3& n)
+{
+  float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  if(l1 == 0.f)
+    return glm::packSnorm2x16(glm::vec2(0.f));  // Degenerated normal, decodes to +Z
+
+  glm::vec2 p(n.x / l1, n.y / l1);
+  if(n.z < 0.f)
+  {
+    p = glm::vec2((1.f - std::abs(n.y / l1)) * (n.x >= 0.f ? 1.f : -1.f),
+                  (1.f - std::abs(n.x / l1)) * (n.y >= 0.f ? 1.f : -1.f));
+  }
+
+  const glm::vec3 nn      = n / std::sqrt(glm::dot(n, n));
+  const float     kScale  = 32767.f;
+  const float     fx      = std::floor(p.x * kScale);
+  const float     fy      = std::floor(p.y * kScale);
+  uint32_t        best    = 0;
+  float           bestDot = -2.f;
+  for(int i = 0; i < 4; i++)
+  {
+    glm::vec2 q(std::min(fx + float(i & 1), kScale) / kScale, std::min(fy + float(i >> 1), kScale) / kScale);
+    uint32_t  packed = glm::packSnorm2x16(q);
+    float     d      = glm::dot(octDecode(glm::unpackSnorm2x16(packed)), nn);
+    if(d > bestDot)
+    {
+      bestDot = d;
+      best    = packed;
+    }
+  }
+  return best;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compact layout: 12 bytes of attributes + 12 bytes of position (m_positions), instead of 44 bytes per vertex.
+// The closest-hit shader only fetches the attributes, the hit position comes from the ray.
+// The error is measured by decoding each vertex as the shaders do.
+//
+void ObjLoader::encodeCompactVertices(std::vector<VertexCompactObj>& attributes) const
+{
+  attributes.resize(m_vertices.size());
+
+  double maxNrmError   = 0.0;  // Degrees
+  double sumNrmError   = 0.0;
+  float  maxUvError    = 0.f;
+  float  maxColorError = 0.f;
+  for(size_t i = 0; i < m_vertices.size(); i++)
+  {
+    const VertexObj&  v = m_vertices[i];
+    VertexCompactObj& c = attributes[i];
+    c.nrm               = octEncode(v.nrm);
+    c.texCoord          = glm::packHalf2x16(v.texCoord);
+    c.color             = glm::packUnorm4x8(glm::vec4(v.color, 1.f));
+
+    float len = glm::length(v.nrm);
+    if(len > 0.f)
+    {
+      glm::vec3 n     = v.nrm / len;
+      glm::vec3 d     = octDecode(glm::unpackSnorm2x16(c.nrm));
+      double    angle = std::atan2(glm::length(glm::cross(n, d)), glm::dot(n, d)) * 180.0 / 3.14159265358979;
+      maxNrmError  = std::max(maxNrmError, angle);
+      sumNrmError += angle;
+    }
+    glm::vec2 uv    = glm::unpackHalf2x16(c.texCoord);
+    glm::vec4 color = glm::unpackUnorm4x8(c.color);
+    maxUvError      = std::max(maxUvError, std::max(std::abs(uv.x - v.texCoord.x), std::abs(uv.y - v.texCoord.y)));
+    for(int k = 0; k < 3; k++)
+      maxColorError = std::max(maxColorError, std::abs(color[k] - v.color[k]));
+  }
+
+  size_t before = m_vertices.size() * sizeof(VertexObj);
+  size_t after  = m_vertices.size() * (sizeof(glm::vec3) + sizeof(VertexCompactObj));
+  LOGI("Compact vertices: %zu -> %zu bytes (%.1f%%), attributes fetched per hit: %zu -> %zu bytes\n", before, after,
+       100.0 * double(after) / double(std::max<size_t>(before, 1)), 3 * sizeof(VertexObj), 3 * sizeof(VertexCompactObj));
+  LOGI("  error: normal max %.4f deg (mean %.4f), texCoord max %g, color max %g\n", maxNrmError,
+       sumNrmError / double(std::max<size_t>(m_vertices.size(), 1)), maxUvError, maxColorError);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Most models have few materials, in long runs of triangles: 8 or 16 bits per triangle are enough,
+// and a table of runs is often much smaller. The runs are searched with a binary search in the
+// shader, so they are only used when the table is at most a quarter of the fixed width array.
+//
+MatIndexEncoding ObjLoader::encodeMaterialIndices(std::vector<uint32_t>& words) const
+{
+  const uint32_t nbTriangles = static_cast<uint32_t>(m_matIndx.size());
+  uint32_t       maxIndex    = 0;
+  uint32_t       nbRuns      = 0;
+  for(uint32_t t = 0; t < nbTriangles; t++)
+  {
+    maxIndex = std::max(maxIndex, static_cast<uint32_t>(m_matIndx[t]));
+    if(t == 0 || m_matIndx[t] != m_matIndx[t - 1])
+      nbRuns++;
+  }
+
+  const uint32_t   bits       = maxIndex < 256 ? 8 : (maxIndex < 65536 ? 16 : 32);
+  const size_t     fixedWords = (static_cast<size_t>(nbTriangles) * bits + 31) / 32;
+  const size_t     runWords   = 1 + 2 * static_cast<size_t>(nbRuns);
+  MatIndexEncoding encoding   = MatIndexEncoding::e32Bit;
+  if(runWords * 4 <= fixedWords)
+    encoding = MatIndexEncoding::eRuns;
+  else if(bits == 8)
+    encoding = MatIndexEncoding::e8Bit;
+  else if(bits == 16)
+    encoding = MatIndexEncoding::e16Bit;
+
+  words.clear();
+  if(encoding == MatIndexEncoding::eRuns)
+  {
+    words.resize(runWords);
+    words[0] = nbRuns;
+    for(uint32_t t = 0, run = 0; t < nbTriangles; t++)
+    {
+      if(t == 0 || m_matIndx[t] != m_matIndx[t - 1])
+      {
+        words[1 + run]          = t;
+        words[1 + nbRuns + run] = static_cast<uint32_t>(m_matIndx[t]);
+        run++;
+      }
+    }
+  }
+  else
+  {
+    words.resize(std::max<size_t>(fixedWords, 1), 0);  // Never empty, the buffer is always created
+    const uint32_t perWord = 32 / bits;
+    for(uint32_t t = 0; t < nbTriangles; t++)
+      words[t / perWord] |= static_cast<uint32_t>(m_matIndx[t]) << ((t % perWord) * bits);
+  }
+
+  uint32_t mismatches = 0;
+  for(uint32_t t = 0; t < nbTriangles; t++)
+  {
+    if(decodeMaterialIndex(words, encoding, t) != static_cast<uint32_t>(m_matIndx[t]))
+      mismatches++;
+  }
+  const char* names[] = {"8-bit", "16-bit", "32-bit", "runs"};
+  LOGI("Material indices: %u triangles, %u runs, %s: %zu -> %zu bytes, %u mismatches\n", nbTriangles, nbRuns,
+       names[static_cast<int>(encoding)], m_matIndx.size() * sizeof(int32_t), words.size() * sizeof(uint32_t),
+       mismatches);
+  assert(mismatches == 0);
+  return encoding;
+}
+
+uint32_t ObjLoader::decodeMaterialIndex(const std::vector<uint32_t>& words,
+                                        MatIndexEncoding             encoding,
+                                        uint32_t                     triangle)
+{
+  switch(encoding)
+  {
+    case MatIndexEncoding::e8Bit:
+      return (words[triangle >> 2] >> ((triangle & 3) * 8)) & 0xFF;
+    case MatIndexEncoding::e16Bit:
+      return (words[triangle >> 1] >> ((triangle & 1) * 16)) & 0xFFFF;
+    case MatIndexEncoding::eRuns: {
+      // Last run starting at or before the triangle
+      uint32_t count = words[0];
+      uint32_t lo    = 0;
+      uint32_t hi    = count;
+      while(hi - lo > 1)
+      {
+        uint32_t mid = (lo + hi) / 2;
+        if(words[1 + mid] <= triangle)
+          lo = mid;
+        else
+          hi = mid;
+      }
+      return words[1 + count + lo];
+    }
+    default:
+      return words[triangle];
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Single threaded parsing with tinyobj, expanding to one vertex per face corner
+//
+bool ObjLoader::loadTinyObj(const std::string& filename)
+{
+  tinyobj::ObjReader reader;
+  reader.ParseFromFile(filename);
+  if(!reader.Valid())
+  {
+    LOGE("Cannot load %s: %s", filename.c_str(), reader.Error().c_str());
+    assert(reader.Valid());
+  }
+
+  addMaterials(reader.GetMaterials());
 
   const tinyobj::attrib_t& attrib = reader.GetAttrib();
 
@@ -96,27 +447,81 @@ void ObjLoader::loadModel(const std::string& filename)
     }
   }
 
-  // Fixing material indices
-  for(auto& mi : m_matIndx)
+  return !attrib.normals.empty();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Multithreaded parsing, see ObjParser. Returns false when the file needs the tinyobj path.
+//
+bool ObjLoader::loadParallel(const std::string& filename, bool& hasNormals)
+{
+  ObjParser parser;
+  if(!parser.parse(filename))
+    return false;
+
+  addMaterials(parser.m_materials);
+  m_vertices.swap(parser.m_vertices);
+  m_indices.swap(parser.m_indices);
+  m_matIndx.swap(parser.m_matIndx);
+  hasNormals = parser.m_hasNormals;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Bounded memory parsing (ObjParser::parseStreaming), the vertices come out welded on their
+// v/vt/vn indices, so weldVertices() is only needed when flat normals were computed.
+//
+bool ObjLoader::loadStreaming(const std::string& filename, bool& hasNormals, bool& welded)
+{
+  ObjParser parser;
+  if(!parser.parseStreaming(filename, m_streamWindow))
   {
-    if(mi < 0 || mi > m_materials.size())
-      mi = 0;
+    LOGW("Streaming parse failed for %s, falling back\n", filename.c_str());
+    return false;
   }
 
+  addMaterials(parser.m_materials);
+  m_vertices.swap(parser.m_vertices);
+  m_indices.swap(parser.m_indices);
+  m_matIndx.swap(parser.m_matIndx);
+  hasNormals = parser.m_hasNormals;
+  welded     = parser.m_welded;
 
-  // Compute normal when no normal were provided.
-  if(attrib.normals.empty())
+  double meshMB = static_cast<double>(m_vertices.size() * sizeof(VertexObj) + m_indices.size() * sizeof(uint32_t)
+                                      + m_matIndx.size() * sizeof(int32_t))
+                  / (1024.0 * 1024.0);
+  LOGI("Streaming: window %.1f MB, parser peak %.1f MB, mesh %.1f MB\n", double(m_streamWindow) / (1024.0 * 1024.0),
+       double(parser.m_peakBytes) / (1024.0 * 1024.0), meshMB);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Collecting the material in the scene
+//
+void ObjLoader::addMaterials(const std::vector<tinyobj::material_t>& materials)
+{
+  for(const auto& material : materials)
   {
-    for(size_t i = 0; i < m_indices.size(); i += 3)
+    MaterialObj m;
+    m.ambient       = glm::vec3(material.ambient[0], material.ambient[1], material.ambient[2]);
+    m.diffuse       = glm::vec3(material.diffuse[0], material.diffuse[1], material.diffuse[2]);
+    m.specular      = glm::vec3(material.specular[0], material.specular[1], material.specular[2]);
+    m.emission      = glm::vec3(material.emission[0], material.emission[1], material.emission[2]);
+    m.transmittance = glm::vec3(material.transmittance[0], material.transmittance[1], material.transmittance[2]);
+    m.dissolve      = material.dissolve;
+    m.ior           = material.ior;
+    m.shininess     = material.shininess;
+    m.illum         = material.illum;
+    if(!material.diffuse_texname.empty())
     {
-      VertexObj& v0 = m_vertices[m_indices[i + 0]];
-      VertexObj& v1 = m_vertices[m_indices[i + 1]];
-      VertexObj& v2 = m_vertices[m_indices[i + 2]];
-
-      glm::vec3 n = glm::normalize(glm::cross((v1.pos - v0.pos), (v2.pos - v0.pos)));
-      v0.nrm      = n;
-      v1.nrm      = n;
-      v2.nrm      = n;
+      m_textures.push_back(material.diffuse_texname);
+      m.textureID = static_cast<int>(m_textures.size()) - 1;
     }
+
+    m_materials.emplace_back(m);
   }
+
+  // If there were none, add a default
+  if(m_materials.empty())
+    m_materials.emplace_back(MaterialObj());
 }
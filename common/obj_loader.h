@@ -42,7 +42,8 @@ struct MaterialObj
   int textureID = -1;
 };
 // OBJ representation of a vertex
-// NOTE: BLAS builder depends on pos being the first member
+// NOTE: samples building the BLAS from this interleaved layout depend on pos being the first member,
+//       ObjLoader::m_positions has the positions without that coupling
 struct VertexObj
 {
   glm::vec3 pos;
@@ -51,6 +52,34 @@ struct VertexObj
   glm::vec2 texCoord;
 };
 
+// Normals computed when the OBJ has none, see NormalGenerator
+enum class NormalMode : uint32_t
+{
+  eFlat,         // Normal of the triangle
+  eSmoothArea,   // Average of the triangles around the position, weighted by their area
+  eSmoothAngle,  // Same, weighted by the angle of the triangles at the position
+};
+
+// Compact vertex attributes for the device, the position is kept in a separate full-precision stream
+// NOTE: must match VertexCompact in host_device.h
+struct VertexCompactObj
+{
+  uint32_t nrm;       // Octahedral encoded normal, 2 x snorm16
+  uint32_t texCoord;  // 2 x half float
+  uint32_t color;     // RGBA8 unorm
+};
+
+
+// Encoding of the per-triangle material indices on the device, see ObjLoader::encodeMaterialIndices
+// NOTE: must match the MATINDEX_* values in host_device.h
+enum class MatIndexEncoding : int32_t
+{
+  e8Bit  = 0,  // 4 triangles per 32-bit word
+  e16Bit = 1,  // 2 triangles per word
+  e32Bit = 2,  // 1 triangle per word
+  eRuns  = 3,  // Number of runs, first triangle of each run, material of each run
+};
+
 
 struct shapeObj
 {
@@ -64,9 +93,40 @@ class ObjLoader
 public:
   void loadModel(const std::string& filename);
 
+  // Merge identical vertices (position, normal, color, texCoord) and rebuild the index buffer
+  void weldVertices();
+
+  // Reorder triangles for the post-transform cache and vertices for fetch locality (MeshOptimizer)
+  void optimizeMesh();
+
+  // Compact attributes of m_vertices (positions are in m_positions), and reports the encoding error
+  void encodeCompactVertices(std::vector<VertexCompactObj>& attributes) const;
+
+  // m_matIndx packed in 32-bit words with the smallest encoding, and checked by decoding every triangle
+  MatIndexEncoding encodeMaterialIndices(std::vector<uint32_t>& words) const;
+  // Same lookup as the shaders (matindex.glsl)
+  static uint32_t decodeMaterialIndex(const std::vector<uint32_t>& words, MatIndexEncoding encoding, uint32_t triangle);
+
+  bool       m_weld{true};                     // Weld identical vertices after loading
+  bool       m_parallelParse{true};            // Multithreaded parsing (ObjParser), else or on failure tinyobj
+  size_t     m_streamWindow{0};                // Streaming parse with windows of this size in bytes, 0: off
+  bool       m_optimize{true};                 // Reorder for vertex cache and fetch locality (MeshOptimizer)
+  NormalMode m_normalMode{NormalMode::eFlat};  // Normals generated for files without normals
+  float      m_creaseAngle{60.f};              // Degrees, smooth normals keep sharper edges
+  bool       m_useCache{true};                 // Read/write the binary cache (ObjCache) next to the OBJ
+
   std::vector<VertexObj>   m_vertices;
+  std::vector<glm::vec3>   m_positions;  // Tightly packed positions of m_vertices
   std::vector<uint32_t>    m_indices;
   std::vector<MaterialObj> m_materials;
   std::vector<std::string> m_textures;
   std::vector<int32_t>     m_matIndx;
+
+private:
+  uint32_t cacheOptions() const;
+  void     extractPositions();
+  bool     loadTinyObj(const std::string& filename);
+  bool     loadParallel(const std::string& filename, bool& hasNormals);
+  bool     loadStreaming(const std::string& filename, bool& hasNormals, bool& welded);
+  void     addMaterials(const std::vector<tinyobj::material_t>& materials);
 };
@@ -0,0 +1,838 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "obj_parser.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <unordered_map>
+
+
+namespace {
+
+inline bool isSpace(char c)
+{
+  return c == ' ' || c == '\t';
+}
+
+inline bool isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+inline bool startsWith(const char* p, const char* end, const char* keyword, size_t len)
+{
+  return (end - p) > static_cast<ptrdiff_t>(len) && memcmp(p, keyword, len) == 0 && isSpace(p[len]);
+}
+
+inline const char* skipSpaces(const char* p, const char* end)
+{
+  while(p < end && isSpace(*p))
+    ++p;
+  return p;
+}
+
+inline const char* tokenEnd(const char* p, const char* end)
+{
+  while(p < end && !isSpace(*p) && *p != '\r')
+    ++p;
+  return p;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Same algorithm as tryParseDouble() in tinyobj: the mantissa is accumulated the same way, so the
+// parsed values round to the same floats.
+//
+bool tryParseDouble(const char* s, const char* s_end, double* result)
+{
+  if(s >= s_end)
+    return false;
+
+  double      mantissa             = 0.0;
+  int         exponent             = 0;
+  char        sign                 = '+';
+  char        exp_sign             = '+';
+  const char* curr                 = s;
+  int         read                 = 0;
+  bool        end_not_reached      = false;
+  bool        leading_decimal_dots = false;
+
+  if(*curr == '+' || *curr == '-')
+  {
+    sign = *curr;
+    curr++;
+    if((curr != s_end) && (*curr == '.'))
+      leading_decimal_dots = true;
+  }
+  else if(*curr == '.')
+  {
+    leading_decimal_dots = true;
+  }
+  else if(!isDigit(*curr))
+  {
+    return false;
+  }
+
+  // Integer part
+  end_not_reached = (curr != s_end);
+  if(!leading_decimal_dots)
+  {
+    while(end_not_reached && isDigit(*curr))
+    {
+      mantissa *= 10;
+      mantissa += static_cast<int>(*curr - 0x30);
+      curr++;
+      read++;
+      end_not_reached = (curr != s_end);
+    }
+    if(read == 0)
+      return false;
+  }
+
+  if(end_not_reached)
+  {
+    // Decimal part
+    if(*curr == '.')
+    {
+      static const double powLut[] = {1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001};
+      const int           lutSize  = sizeof(powLut) / sizeof(powLut[0]);
+      curr++;
+      read            = 1;
+      end_not_reached = (curr != s_end);
+      while(end_not_reached && isDigit(*curr))
+      {
+        mantissa += static_cast<int>(*curr - 0x30) * (read < lutSize ? powLut[read] : std::pow(10.0, -read));
+        read++;
+        curr++;
+        end_not_reached = (curr != s_end);
+      }
+    }
+
+    // Exponent part
+    if(end_not_reached && (*curr == 'e' || *curr == 'E'))
+    {
+      curr++;
+      end_not_reached = (curr != s_end);
+      if(end_not_reached && (*curr == '+' || *curr == '-'))
+      {
+        exp_sign = *curr;
+        curr++;
+      }
+      else if(!end_not_reached || !isDigit(*curr))
+      {
+        return false;  // Empty E is not allowed
+      }
+
+      read            = 0;
+      end_not_reached = (curr != s_end);
+      while(end_not_reached && isDigit(*curr))
+      {
+        if(exponent > (2147483647 / 10))
+          return false;  // Integer overflow
+        exponent *= 10;
+        exponent += static_cast<int>(*curr - 0x30);
+        curr++;
+        read++;
+        end_not_reached = (curr != s_end);
+      }
+      exponent *= (exp_sign == '+' ? 1 : -1);
+      if(read == 0)
+        return false;
+    }
+  }
+
+  *result = (sign == '+' ? 1 : -1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+  return true;
+}
+
+// Reads the next number of the line, `defaultValue` when missing (tinyobj parseReal)
+inline float parseReal(const char*& p, const char* end, double defaultValue = 0.0)
+{
+  p                = skipSpaces(p, end);
+  const char* tEnd = tokenEnd(p, end);
+  double      val  = defaultValue;
+  tryParseDouble(p, tEnd, &val);
+  p = tEnd;
+  return static_cast<float>(val);
+}
+
+inline bool parseReal(const char*& p, const char* end, float* out)
+{
+  p                = skipSpaces(p, end);
+  const char* tEnd = tokenEnd(p, end);
+  double      val  = 0.0;
+  bool        ret  = tryParseDouble(p, tEnd, &val);
+  if(ret)
+    *out = static_cast<float>(val);
+  p = tEnd;
+  return ret;
+}
+
+// atoi() bounded to the line
+inline int parseInt(const char* p, const char* end)
+{
+  p         = skipSpaces(p, end);
+  bool  neg = false;
+  if(p < end && (*p == '+' || *p == '-'))
+    neg = (*p++ == '-');
+  int value = 0;
+  while(p < end && isDigit(*p))
+    value = value * 10 + (*p++ - '0');
+  return neg ? -value : value;
+}
+
+// Same rules as tinyobj fixIndex(): 1-based, negative values are relative to the current count
+inline bool fixIndex(int idx, int n, int32_t* ret, bool allowZero)
+{
+  if(idx > 0)
+  {
+    *ret = idx - 1;
+    return true;
+  }
+  if(idx == 0)
+  {
+    *ret = -1;
+    return allowZero;
+  }
+  *ret = n + idx;
+  return *ret >= 0;
+}
+
+inline const char* skipIndex(const char* p, const char* end)
+{
+  while(p < end && *p != '/' && !isSpace(*p) && *p != '\r')
+    ++p;
+  return p;
+}
+
+// Parses `v`, `v/vt`, `v//vn` or `v/vt/vn`
+bool parseTriple(const char*& p, const char* end, int nbV, int nbVn, int nbVt, int32_t* vi)
+{
+  vi[0] = vi[1] = vi[2] = -1;
+  if(!fixIndex(parseInt(p, end), nbV, &vi[0], false))
+    return false;
+  p = skipIndex(p, end);
+  if(p >= end || *p != '/')
+    return true;
+  p++;
+
+  // i//k
+  if(p < end && *p == '/')
+  {
+    p++;
+    if(!fixIndex(parseInt(p, end), nbVn, &vi[2], true))
+      return false;
+    p = skipIndex(p, end);
+    return true;
+  }
+
+  // i/j/k or i/j
+  if(!fixIndex(parseInt(p, end), nbVt, &vi[1], true))
+    return false;
+  p = skipIndex(p, end);
+  if(p >= end || *p != '/')
+    return true;
+
+  // i/j/k
+  p++;
+  if(!fixIndex(parseInt(p, end), nbVn, &vi[2], true))
+    return false;
+  p = skipIndex(p, end);
+  return true;
+}
+
+// Calls fn(lineBegin, lineEnd) for each line, without the end of line characters
+template <typename F>
+void forEachLine(const char* begin, const char* end, F&& fn)
+{
+  const char* p = begin;
+  while(p < end)
+  {
+    const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    if(eol == nullptr)
+      eol = end;
+    const char* lineEnd = eol;
+    if(lineEnd > p && lineEnd[-1] == '\r')
+      lineEnd--;
+    fn(skipSpaces(p, lineEnd), lineEnd);
+    p = eol + 1;
+  }
+}
+
+// Returns the end of the first line ending at or after `p`
+const char* nextLineStart(const char* p, const char* end)
+{
+  if(p >= end)
+    return end;
+  const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+  return eol ? eol + 1 : end;
+}
+
+// Directory of the OBJ, where tinyobj::ObjReader looks for the MTL files
+std::string mtlSearchPath(const std::string& filename)
+{
+  std::string searchPath;
+  size_t      pos = filename.find_last_of("/\\");
+  if(pos != std::string::npos)
+  {
+    searchPath = filename.substr(0, pos);
+#ifdef _WIN32
+    searchPath += '\\';
+#else
+    searchPath += '/';
+#endif
+  }
+  return searchPath;
+}
+
+// Loads the libraries of `mtllib` lines, appending to `materials`
+void loadMaterialLibraries(const std::vector<std::string>& mtllib,
+                           tinyobj::MaterialFileReader&     reader,
+                           std::vector<tinyobj::material_t>& materials,
+                           std::map<std::string, int>&       materialMap)
+{
+  for(const auto& line : mtllib)
+  {
+    const char* p = line.c_str();
+    const char* e = p + line.size();
+    while((p = skipSpaces(p, e)) < e)
+    {
+      const char* tEnd = tokenEnd(p, e);
+      std::string warn, err;
+      if(reader(std::string(p, tEnd), &materials, &materialMap, &warn, &err))
+        break;  // First library found is used
+      p = tEnd;
+    }
+  }
+}
+
+// Triangles of a face as corner numbers, returns their count. Quads are split along the shortest
+// diagonal, as tinyobj does. The position indices must be valid.
+int splitFace(const int32_t* corners, uint8_t faceSize, const std::vector<float>& positions, int tri[2][3])
+{
+  tri[0][0] = 0, tri[0][1] = 1, tri[0][2] = 2;
+  if(faceSize != 4)
+    return 1;
+
+  const float* v0    = &positions[3 * corners[0]];
+  const float* v1    = &positions[3 * corners[3]];
+  const float* v2    = &positions[3 * corners[6]];
+  const float* v3    = &positions[3 * corners[9]];
+  float        e02x  = v2[0] - v0[0];
+  float        e02y  = v2[1] - v0[1];
+  float        e02z  = v2[2] - v0[2];
+  float        e13x  = v3[0] - v1[0];
+  float        e13y  = v3[1] - v1[1];
+  float        e13z  = v3[2] - v1[2];
+  float        sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+  float        sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+  if(sqr02 < sqr13)
+  {
+    tri[0][0] = 0, tri[0][1] = 1, tri[0][2] = 2;
+    tri[1][0] = 0, tri[1][1] = 2, tri[1][2] = 3;
+  }
+  else
+  {
+    tri[0][0] = 0, tri[0][1] = 1, tri[0][2] = 3;
+    tri[1][0] = 1, tri[1][1] = 2, tri[1][2] = 3;
+  }
+  return 2;
+}
+
+// Vertex of a face corner (v, vt, vn indices), as ObjLoader builds it from the tinyobj result
+VertexObj makeVertex(const int32_t*            vi,
+                     const std::vector<float>& positions,
+                     const std::vector<float>& colors,
+                     const std::vector<float>& texcoords,
+                     const std::vector<float>& normals)
+{
+  VertexObj    vertex = {};
+  const float* vp     = &positions[3 * vi[0]];
+  vertex.pos          = {vp[0], vp[1], vp[2]};
+  if(!normals.empty() && vi[2] >= 0)
+  {
+    const float* np = &normals[3 * vi[2]];
+    vertex.nrm      = {np[0], np[1], np[2]};
+  }
+  if(!texcoords.empty() && vi[1] >= 0)
+  {
+    const float* tp = &texcoords[2 * vi[1]];
+    vertex.texCoord = {tp[0], 1.0f - tp[1]};
+  }
+  if(!colors.empty())
+  {
+    const float* vc = &colors[3 * vi[0]];
+    vertex.color    = {vc[0], vc[1], vc[2]};
+  }
+  return vertex;
+}
+
+// Splits [text, text + size) in chunks ending at a line boundary
+std::vector<const char*> splitLines(const char* text, size_t size, size_t nbThreads)
+{
+  const char*              textEnd      = text + size;
+  const size_t             minChunkSize = 1 << 20;
+  const size_t             chunkSize    = std::max(minChunkSize, size / (nbThreads * 4 + 1));
+  std::vector<const char*> bounds{text};
+  while(bounds.back() < textEnd)
+    bounds.push_back(nextLineStart(std::min(bounds.back() + chunkSize, textEnd) - 1, textEnd));
+  return bounds;
+}
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Reads the file and parses it. The MTL files are searched in the directory of the OBJ, like
+// tinyobj::ObjReader does.
+//
+bool ObjParser::parse(const std::string& filename, ThreadPool& pool)
+{
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  if(!file)
+    return false;
+  std::vector<char> text(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  if(!file.read(text.data(), text.size()))
+    return false;
+
+  return parseText(text.data(), text.size(), mtlSearchPath(filename), pool);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Counting the attributes is cheap compared to parsing them; doing it first gives each chunk the
+// global offsets so indices are resolved while parsing.
+//
+void ObjParser::countChunk(const char* begin, const char* end, Chunk& chunk)
+{
+  forEachLine(begin, end, [&](const char* p, const char* e) {
+    if(e - p < 2 || p[0] != 'v')
+      return;
+    if(isSpace(p[1]))
+      chunk.nbPositions++;
+    else if(e - p > 2 && isSpace(p[2]))
+    {
+      if(p[1] == 't')
+        chunk.nbTexcoords++;
+      else if(p[1] == 'n')
+        chunk.nbNormals++;
+    }
+  });
+}
+
+void ObjParser::parseChunk(const char* begin, const char* end, uint32_t baseV, uint32_t baseVt, uint32_t baseVn, Chunk& chunk)
+{
+  chunk.positions.reserve(chunk.nbPositions * 3);
+  chunk.colors.reserve(chunk.nbPositions * 3);
+  chunk.texcoords.reserve(chunk.nbTexcoords * 2);
+  chunk.normals.reserve(chunk.nbNormals * 3);
+
+  int nbV  = static_cast<int>(baseV);
+  int nbVt = static_cast<int>(baseVt);
+  int nbVn = static_cast<int>(baseVn);
+
+  int32_t currentMtl = -1;
+
+  forEachLine(begin, end, [&](const char* p, const char* e) {
+    if(!chunk.valid || p >= e || *p == '#')
+      return;
+
+    if(startsWith(p, e, "v", 1))
+    {
+      p += 2;
+      float x = parseReal(p, e);
+      float y = parseReal(p, e);
+      float z = parseReal(p, e);
+      float r = 1.f, g = 1.f, b = 1.f;
+      if(!(parseReal(p, e, &r) && parseReal(p, e, &g) && parseReal(p, e, &b)))
+        r = g = b = 1.f;
+      chunk.positions.insert(chunk.positions.end(), {x, y, z});
+      chunk.colors.insert(chunk.colors.end(), {r, g, b});
+      nbV++;
+    }
+    else if(startsWith(p, e, "vn", 2))
+    {
+      p += 3;
+      float x = parseReal(p, e);
+      float y = parseReal(p, e);
+      float z = parseReal(p, e);
+      chunk.normals.insert(chunk.normals.end(), {x, y, z});
+      nbVn++;
+    }
+    else if(startsWith(p, e, "vt", 2))
+    {
+      p += 3;
+      float x = parseReal(p, e);
+      float y = parseReal(p, e);
+      chunk.texcoords.insert(chunk.texcoords.end(), {x, y});
+      nbVt++;
+    }
+    else if(startsWith(p, e, "f", 1))
+    {
+      p += 2;
+      p                 = skipSpaces(p, e);
+      size_t  nbCorners = 0;
+      int32_t vi[3];
+      while(p < e)
+      {
+        if(!parseTriple(p, e, nbV, nbVn, nbVt, vi))
+        {
+          chunk.valid = false;  // tinyobj reports an error for this file
+          return;
+        }
+        chunk.corners.insert(chunk.corners.end(), {vi[0], vi[1], vi[2]});
+        nbCorners++;
+        while(p < e && (isSpace(*p) || *p == '\r'))
+          p++;
+      }
+
+      if(nbCorners < 3)
+      {
+        // Degenerated faces are skipped by tinyobj
+        chunk.corners.resize(chunk.corners.size() - nbCorners * 3);
+      }
+      else if(nbCorners > 4)
+      {
+        chunk.valid = false;  // Polygon triangulation left to tinyobj
+      }
+      else
+      {
+        chunk.faceSizes.push_back(static_cast<uint8_t>(nbCorners));
+        chunk.faceMtl.push_back(currentMtl);
+        chunk.nbTriangles += static_cast<uint32_t>(nbCorners - 2);
+      }
+    }
+    else if(startsWith(p, e, "usemtl", 6))
+    {
+      p += 7;
+      p = skipSpaces(p, e);
+      chunk.usemtl.emplace_back(p, tokenEnd(p, e));
+      currentMtl = static_cast<int32_t>(chunk.usemtl.size()) - 1;
+    }
+    else if(startsWith(p, e, "mtllib", 6))
+    {
+      p += 7;
+      chunk.mtllib.emplace_back(p, e);
+    }
+    // Other statements (o, g, s, l, p, ...) do not change the triangles
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+// Parsing steps:
+// 1. Count attributes per chunk (parallel) and prefix sum them
+// 2. Parse the chunks (parallel)
+// 3. Load the MTL files and resolve material names, carrying the current material across chunks
+// 4. Merge the attributes and expand the faces to vertices (parallel)
+//
+bool ObjParser::parseText(const char* text, size_t size, const std::string& mtlSearchPath, ThreadPool& pool)
+{
+  const std::vector<const char*> bounds   = splitLines(text, size, pool.size());
+  const size_t                   nbChunks = bounds.size() - 1;
+
+  std::vector<Chunk> chunks(nbChunks);
+  pool.parallelBatches(nbChunks, 1, [&](size_t c, size_t) { countChunk(bounds[c], bounds[c + 1], chunks[c]); });
+
+  std::vector<uint32_t> baseV(nbChunks + 1, 0), baseVt(nbChunks + 1, 0), baseVn(nbChunks + 1, 0);
+  for(size_t c = 0; c < nbChunks; c++)
+  {
+    baseV[c + 1]  = baseV[c] + chunks[c].nbPositions;
+    baseVt[c + 1] = baseVt[c] + chunks[c].nbTexcoords;
+    baseVn[c + 1] = baseVn[c] + chunks[c].nbNormals;
+  }
+
+  pool.parallelBatches(nbChunks, 1, [&](size_t c, size_t) {
+    parseChunk(bounds[c], bounds[c + 1], baseV[c], baseVt[c], baseVn[c], chunks[c]);
+  });
+
+  for(const auto& chunk : chunks)
+  {
+    if(!chunk.valid)
+      return false;
+  }
+
+  // Materials, in the order the libraries appear in the file
+  std::map<std::string, int>   materialMap;
+  tinyobj::MaterialFileReader matFileReader(mtlSearchPath);
+  m_materials.clear();
+  for(const auto& chunk : chunks)
+    loadMaterialLibraries(chunk.mtllib, matFileReader, m_materials, materialMap);
+
+  // Resolving the material names, faces before the first `usemtl` of a chunk use the last material of the previous chunk
+  std::vector<std::vector<int32_t>> chunkMtlIds(nbChunks);
+  std::vector<int32_t>              chunkFirstMtl(nbChunks, -1);
+  int32_t                           currentMtl = -1;
+  for(size_t c = 0; c < nbChunks; c++)
+  {
+    chunkFirstMtl[c] = currentMtl;
+    for(const auto& name : chunks[c].usemtl)
+    {
+      auto it = materialMap.find(name);
+      chunkMtlIds[c].push_back(it != materialMap.end() ? it->second : -1);
+    }
+    if(!chunkMtlIds[c].empty())
+      currentMtl = chunkMtlIds[c].back();
+  }
+
+  // Merging attributes
+  std::vector<float> positions(baseV[nbChunks] * 3), colors(baseV[nbChunks] * 3);
+  std::vector<float> texcoords(baseVt[nbChunks] * 2), normals(baseVn[nbChunks] * 3);
+  std::vector<size_t> firstTriangle(nbChunks + 1, 0);
+  for(size_t c = 0; c < nbChunks; c++)
+    firstTriangle[c + 1] = firstTriangle[c] + chunks[c].nbTriangles;
+
+  pool.parallelBatches(nbChunks, 1, [&](size_t c, size_t) {
+    const Chunk& chunk = chunks[c];
+    std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + baseV[c] * 3);
+    std::copy(chunk.colors.begin(), chunk.colors.end(), colors.begin() + baseV[c] * 3);
+    std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + baseVt[c] * 2);
+    std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + baseVn[c] * 3);
+  });
+
+  // Expanding to one vertex per corner, as ObjLoader does with the tinyobj result
+  const size_t nbTriangles = firstTriangle[nbChunks];
+  m_vertices.resize(nbTriangles * 3);
+  m_indices.resize(nbTriangles * 3);
+  m_matIndx.resize(nbTriangles);
+  m_hasNormals = !normals.empty();
+
+  const int32_t     nbV  = static_cast<int32_t>(baseV[nbChunks]);
+  const int32_t     nbVt = static_cast<int32_t>(baseVt[nbChunks]);
+  const int32_t     nbVn = static_cast<int32_t>(baseVn[nbChunks]);
+  std::atomic<bool> outOfRange{false};
+
+  pool.parallelBatches(nbChunks, 1, [&](size_t c, size_t) {
+    const Chunk&   chunk    = chunks[c];
+    const int32_t* corners  = chunk.corners.data();
+    size_t         triangle = firstTriangle[c];
+
+    auto emitCorner = [&](const int32_t* vi, size_t out) {
+      if(vi[0] >= nbV || vi[1] >= nbVt || vi[2] >= nbVn)
+      {
+        outOfRange = true;
+        return;
+      }
+      m_vertices[out] = makeVertex(vi, positions, colors, texcoords, normals);
+      m_indices[out]  = static_cast<uint32_t>(out);
+    };
+
+    for(size_t f = 0; f < chunk.faceSizes.size(); f++)
+    {
+      int32_t mtl = chunk.faceMtl[f] < 0 ? chunkFirstMtl[c] : chunkMtlIds[c][chunk.faceMtl[f]];
+      for(int k = 0; k < chunk.faceSizes[f]; k++)
+      {
+        if(corners[k * 3] >= nbV)
+        {
+          outOfRange = true;
+          return;
+        }
+      }
+      int tri[2][3];
+      int nbTri = splitFace(corners, chunk.faceSizes[f], positions, tri);
+
+      for(int t = 0; t < nbTri; t++, triangle++)
+      {
+        for(int k = 0; k < 3; k++)
+          emitCorner(corners + tri[t][k] * 3, triangle * 3 + k);
+        m_matIndx[triangle] = mtl;
+      }
+      corners += chunk.faceSizes[f] * 3;
+    }
+  });
+
+  return !outOfRange;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Streaming: the file is read in windows of `windowSize` bytes, cut at the last complete line.
+// Each window is parsed like parseText() (chunks on the thread pool), then its faces are emitted
+// directly as indexed triangles: corners are welded on their (v, vt, vn) indices, so no expanded
+// copy of the mesh is ever built. Corners without normal are not welded, as flat normals may be
+// computed for them later.
+// Faces may use any attribute defined before them, so the attributes read so far are kept.
+//
+bool ObjParser::parseStreaming(const std::string& filename, size_t windowSize, ThreadPool& pool)
+{
+  std::ifstream file(filename, std::ios::binary);
+  if(!file)
+    return false;
+
+  struct CornerHash
+  {
+    size_t operator()(const std::array<int32_t, 3>& c) const
+    {
+      uint64_t h = uint64_t(uint32_t(c[0])) * 0x9E3779B97F4A7C15ull;
+      h ^= (uint64_t(uint32_t(c[1])) + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2));
+      h ^= (uint64_t(uint32_t(c[2])) + 0x85157AF5ull + (h << 6) + (h >> 2));
+      return static_cast<size_t>(h);
+    }
+  };
+  std::unordered_map<std::array<int32_t, 3>, uint32_t, CornerHash> cornerMap;
+
+  std::vector<float>          positions, colors, texcoords, normals;
+  std::map<std::string, int>  materialMap;
+  tinyobj::MaterialFileReader matFileReader(mtlSearchPath(filename));
+  int32_t                     currentMtl = -1;
+
+  m_materials.clear();
+  m_vertices.clear();
+  m_indices.clear();
+  m_matIndx.clear();
+  m_welded    = true;
+  m_peakBytes = 0;
+
+  auto capacityBytes = [](const auto& v) { return v.capacity() * sizeof(v[0]); };
+
+  // Parses complete lines, returns false on faces the parser does not handle
+  auto parseWindow = [&](const char* text, size_t size, size_t windowBytes) {
+    const std::vector<const char*> bounds   = splitLines(text, size, pool.size());
+    const size_t                   nbChunks = bounds.size() - 1;
+
+    std::vector<Chunk> chunks(nbChunks);
+    pool.parallelBatches(nbChunks, 1, [&](size_t c, size_t) { countChunk(bounds[c], bounds[c + 1], chunks[c]); });
+
+    std::vector<uint32_t> baseV(nbChunks + 1), baseVt(nbChunks + 1), baseVn(nbChunks + 1);
+    baseV[0]  = static_cast<uint32_t>(positions.size() / 3);
+    baseVt[0] = static_cast<uint32_t>(texcoords.size() / 2);
+    baseVn[0] = static_cast<uint32_t>(normals.size() / 3);
+    for(size_t c = 0; c < nbChunks; c++)
+    {
+      baseV[c + 1]  = baseV[c] + chunks[c].nbPositions;
+      baseVt[c + 1] = baseVt[c] + chunks[c].nbTexcoords;
+      baseVn[c + 1] = baseVn[c] + chunks[c].nbNormals;
+    }
+
+    pool.parallelBatches(nbChunks, 1, [&](size_t c, size_t) {
+      parseChunk(bounds[c], bounds[c + 1], baseV[c], baseVt[c], baseVn[c], chunks[c]);
+    });
+
+    // Attributes of the whole window first, a face can use any of them
+    for(const auto& chunk : chunks)
+    {
+      if(!chunk.valid)
+        return false;
+      positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+      colors.insert(colors.end(), chunk.colors.begin(), chunk.colors.end());
+      texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+      normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+    }
+
+    const int32_t nbV  = static_cast<int32_t>(positions.size() / 3);
+    const int32_t nbVt = static_cast<int32_t>(texcoords.size() / 2);
+    const int32_t nbVn = static_cast<int32_t>(normals.size() / 3);
+
+    size_t chunkBytes = 0;
+    for(const auto& chunk : chunks)
+    {
+      loadMaterialLibraries(chunk.mtllib, matFileReader, m_materials, materialMap);
+      std::vector<int32_t> mtlIds;
+      for(const auto& name : chunk.usemtl)
+      {
+        auto it = materialMap.find(name);
+        mtlIds.push_back(it != materialMap.end() ? it->second : -1);
+      }
+
+      const int32_t* corners = chunk.corners.data();
+      for(size_t f = 0; f < chunk.faceSizes.size(); f++)
+      {
+        for(int k = 0; k < chunk.faceSizes[f]; k++)
+        {
+          const int32_t* vi = corners + k * 3;
+          if(vi[0] >= nbV || vi[1] >= nbVt || vi[2] >= nbVn)
+            return false;
+        }
+        if(chunk.faceMtl[f] >= 0)
+          currentMtl = mtlIds[chunk.faceMtl[f]];
+
+        int tri[2][3];
+        int nbTri = splitFace(corners, chunk.faceSizes[f], positions, tri);
+        for(int t = 0; t < nbTri; t++)
+        {
+          for(int k = 0; k < 3; k++)
+          {
+            const int32_t* vi    = corners + tri[t][k] * 3;
+            uint32_t       index = static_cast<uint32_t>(m_vertices.size());
+            if(vi[2] >= 0)
+              index = cornerMap.emplace(std::array<int32_t, 3>{vi[0], vi[1], vi[2]}, index).first->second;
+            else
+              m_welded = false;
+            if(index == m_vertices.size())
+              m_vertices.push_back(makeVertex(vi, positions, colors, texcoords, normals));
+            m_indices.push_back(index);
+          }
+          m_matIndx.push_back(currentMtl);
+        }
+        corners += chunk.faceSizes[f] * 3;
+      }
+      if(!mtlIds.empty())
+        currentMtl = mtlIds.back();
+
+      chunkBytes += capacityBytes(chunk.positions) + capacityBytes(chunk.colors) + capacityBytes(chunk.texcoords)
+                    + capacityBytes(chunk.normals) + capacityBytes(chunk.corners) + capacityBytes(chunk.faceSizes)
+                    + capacityBytes(chunk.faceMtl);
+    }
+
+    // Memory held at this point: window, parsed chunks, attributes, output and the weld map
+    size_t bytes = windowBytes + chunkBytes + capacityBytes(positions) + capacityBytes(colors) + capacityBytes(texcoords)
+                   + capacityBytes(normals) + capacityBytes(m_vertices) + capacityBytes(m_indices) + capacityBytes(m_matIndx)
+                   + cornerMap.size() * (sizeof(std::array<int32_t, 3>) + sizeof(uint32_t) + 2 * sizeof(void*))
+                   + cornerMap.bucket_count() * sizeof(void*);
+    m_peakBytes = std::max(m_peakBytes, bytes);
+    return true;
+  };
+
+  std::vector<char> window(std::max<size_t>(windowSize, 4096));
+  size_t            carry = 0;  // Start of an incomplete line, moved to the beginning of the window
+  for(;;)
+  {
+    file.read(window.data() + carry, static_cast<std::streamsize>(window.size() - carry));
+    const size_t filled = carry + static_cast<size_t>(file.gcount());
+    const bool   atEnd  = filled < window.size();
+
+    size_t textSize = filled;
+    if(!atEnd)
+    {
+      while(textSize > 0 && window[textSize - 1] != '\n')
+        textSize--;
+      if(textSize == 0)
+      {
+        // A line longer than the window
+        carry = filled;
+        window.resize(window.size() * 2);
+        continue;
+      }
+    }
+
+    if(!parseWindow(window.data(), textSize, window.capacity()))
+      return false;
+
+    carry = filled - textSize;
+    memmove(window.data(), window.data() + textSize, carry);
+    if(atEnd)
+      break;
+  }
+
+  m_hasNormals = !normals.empty();
+  return true;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "obj_loader.h"
+#include "thread_pool.h"
+
+//--------------------------------------------------------------------------------------------------
+// Multithreaded OBJ parser
+// - The text is split in chunks at line boundaries and each chunk is parsed on the thread pool
+// - Per-chunk results are merged, then expanded in parallel to one VertexObj per face corner
+// - Numbers are parsed and faces triangulated as tinyobj does, so the output is identical to the
+//   tinyobj path of ObjLoader
+// - Polygons with more than 4 vertices or malformed faces are not handled: parse() returns false
+//   and the caller falls back to tinyobj
+// - parseStreaming() bounds the memory: the file is read by windows and triangles are emitted
+//   already welded, without the expanded copy
+//
+class ObjParser
+{
+public:
+  bool parse(const std::string& filename, ThreadPool& pool = ThreadPool::global());
+  bool parseText(const char* text, size_t size, const std::string& mtlSearchPath, ThreadPool& pool = ThreadPool::global());
+  // Reads the file in windows of `windowSize` bytes and emits indexed triangles directly, see the .cpp
+  bool parseStreaming(const std::string& filename, size_t windowSize, ThreadPool& pool = ThreadPool::global());
+
+  std::vector<tinyobj::material_t> m_materials;
+  std::vector<VertexObj>           m_vertices;  // One per face corner (parseStreaming: welded)
+  std::vector<uint32_t>            m_indices;   // 0..N-1 (parseStreaming: indices of the welded vertices)
+  std::vector<int32_t>             m_matIndx;   // Material per triangle, -1 when none
+  bool                             m_hasNormals{false};
+  bool                             m_welded{false};  // parseStreaming: all corners welded on their indices
+  size_t                           m_peakBytes{0};   // parseStreaming: peak of the memory held by the parser
+
+  // Same chunk parsing, returned by parseChunk() and merged by parseText()
+  struct Chunk
+  {
+    std::vector<float>       positions;  // x,y,z
+    std::vector<float>       colors;     // r,g,b, 1 when not in the file (tinyobj default)
+    std::vector<float>       normals;
+    std::vector<float>       texcoords;
+    std::vector<int32_t>     corners;    // Triplets of v, vt, vn absolute indices, -1 when absent
+    std::vector<uint8_t>     faceSizes;  // 3 or 4
+    std::vector<int32_t>     faceMtl;    // Index in `usemtl`, -1 for faces before the first usemtl of the chunk
+    std::vector<std::string> usemtl;
+    std::vector<std::string> mtllib;
+    uint32_t                 nbPositions{0};  // Number of 'v', 'vt', 'vn' in the chunk
+    uint32_t                 nbTexcoords{0};
+    uint32_t                 nbNormals{0};
+    uint32_t                 nbTriangles{0};
+    bool                     valid{true};
+  };
+
+  // Counts the vertex attributes of a text range, needed to resolve relative (negative) indices
+  static void countChunk(const char* begin, const char* end, Chunk& chunk);
+  // Parses a text range; the counts are the number of attributes defined before `begin`
+  static void parseChunk(const char* begin, const char* end, uint32_t baseV, uint32_t baseVt, uint32_t baseVn, Chunk& chunk);
+};
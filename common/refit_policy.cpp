@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "refit_policy.h"
+#include "nvh/nvprint.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+
+namespace {
+constexpr uint32_t kBranching = 4;  // Children per node of the estimated hierarchy
+
+float area(const RefitPolicy::Aabb& box)
+{
+  const glm::vec3 d = glm::max(box.bmax - box.bmin, glm::vec3(0.f));
+  return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+RefitPolicy::Aabb merge(const RefitPolicy::Aabb& a, const RefitPolicy::Aabb& b)
+{
+  return {glm::min(a.bmin, b.bmin), glm::max(a.bmax, b.bmax)};
+}
+
+// 10 bits per axis interleaved
+uint32_t expandBits(uint32_t v)
+{
+  v = (v * 0x00010001u) & 0xFF0000FFu;
+  v = (v * 0x00000101u) & 0x0F00F00Fu;
+  v = (v * 0x00000011u) & 0xC30C30C3u;
+  v = (v * 0x00000005u) & 0x49249249u;
+  return v;
+}
+
+std::vector<uint32_t> mortonOrder(const std::vector<RefitPolicy::Aabb>& boxes)
+{
+  RefitPolicy::Aabb centers{glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)};
+  for(const RefitPolicy::Aabb& box : boxes)
+  {
+    const glm::vec3 c = (box.bmin + box.bmax) * 0.5f;
+    centers           = {glm::min(centers.bmin, c), glm::max(centers.bmax, c)};
+  }
+  const glm::vec3 extent = glm::max(centers.bmax - centers.bmin, glm::vec3(1e-20f));
+
+  std::vector<std::pair<uint32_t, uint32_t>> keys(boxes.size());  // Code, primitive
+  for(size_t i = 0; i < boxes.size(); i++)
+  {
+    const glm::vec3 c = ((boxes[i].bmin + boxes[i].bmax) * 0.5f - centers.bmin) / extent;
+    const glm::vec3 q = glm::min(glm::max(c * 1023.f, glm::vec3(0.f)), glm::vec3(1023.f));
+    keys[i]           = {expandBits(uint32_t(q.x)) << 2 | expandBits(uint32_t(q.y)) << 1 | expandBits(uint32_t(q.z)),
+               static_cast<uint32_t>(i)};
+  }
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<uint32_t> order(boxes.size());
+  for(size_t i = 0; i < keys.size(); i++)
+    order[i] = keys[i].second;
+  return order;
+}
+
+// Summed area of the inner nodes of a hierarchy grouping `kBranching` consecutive nodes per level,
+// the leaves being the boxes in `order`
+double hierarchyArea(const std::vector<uint32_t>& order, const std::vector<RefitPolicy::Aabb>& boxes)
+{
+  std::vector<RefitPolicy::Aabb> level(order.size());
+  for(size_t i = 0; i < order.size(); i++)
+    level[i] = boxes[order[i]];
+
+  double sum = 0;
+  while(level.size() > 1)
+  {
+    const size_t nbNodes = (level.size() + kBranching - 1) / kBranching;
+    for(size_t n = 0; n < nbNodes; n++)
+    {
+      RefitPolicy::Aabb node = level[n * kBranching];
+      for(size_t c = n * kBranching + 1; c < std::min(level.size(), (n + 1) * kBranching); c++)
+        node = merge(node, level[c]);
+      sum += area(node);
+      level[n] = node;
+    }
+    level.resize(nbNodes);
+  }
+  return sum;
+}
+}  // namespace
+
+
+uint32_t RefitPolicy::add(const std::string& name)
+{
+  m_structures.emplace_back();
+  m_structures.back().stats.name = name;
+  return static_cast<uint32_t>(m_structures.size() - 1);
+}
+
+void RefitPolicy::built(uint32_t id, const std::vector<Aabb>& boxes)
+{
+  Structure& s             = m_structures[id];
+  s.boxes                  = boxes;
+  s.order                  = mortonOrder(boxes);
+  s.stats.primitiveCount   = static_cast<uint32_t>(boxes.size());
+  s.stats.refitsSinceBuild = 0;
+  s.stats.growth           = 1.f;
+}
+
+float RefitPolicy::update(uint32_t id, const std::vector<Aabb>& boxes)
+{
+  Structure& s = m_structures[id];
+  s.boxes      = boxes;
+
+  // A change of primitive count cannot be refitted
+  if(boxes.size() != s.order.size())
+  {
+    s.stats.growth = FLT_MAX;
+    return s.stats.growth;
+  }
+
+  const double refit   = hierarchyArea(s.order, boxes);
+  const double rebuild = hierarchyArea(mortonOrder(boxes), boxes);
+  s.stats.growth       = rebuild > 0 ? static_cast<float>(refit / rebuild) : 1.f;
+  s.stats.peakGrowth   = std::max(s.stats.peakGrowth, s.stats.growth);
+  s.stats.growthSum += s.stats.growth;
+  s.stats.updates++;
+  return s.stats.growth;
+}
+
+std::vector<uint32_t> RefitPolicy::select() const
+{
+  std::vector<uint32_t> rebuild;
+  for(uint32_t id = 0; id < count(); id++)
+  {
+    const Stats& stats = m_structures[id].stats;
+    if(m_mode == eAlwaysRebuild
+       || (m_mode == eAdaptive
+           && (stats.growth > m_maxGrowth || (m_maxRefits > 0 && stats.refitsSinceBuild >= m_maxRefits))))
+      rebuild.push_back(id);
+  }
+
+  // The worst first, the others wait for the next frames
+  std::sort(rebuild.begin(), rebuild.end(),
+            [&](uint32_t a, uint32_t b) { return m_structures[a].stats.growth > m_structures[b].stats.growth; });
+  if(m_mode == eAdaptive && m_rebuildsPerFrame > 0 && rebuild.size() > m_rebuildsPerFrame)
+    rebuild.resize(m_rebuildsPerFrame);
+  return rebuild;
+}
+
+void RefitPolicy::refitted(uint32_t id, double ms)
+{
+  Stats& stats = m_structures[id].stats;
+  stats.refitsSinceBuild++;
+  stats.refits++;
+  stats.refitMs += ms;
+}
+
+void RefitPolicy::rebuilt(uint32_t id, double ms)
+{
+  Structure& s             = m_structures[id];
+  s.order                  = mortonOrder(s.boxes);
+  s.stats.refitsSinceBuild = 0;
+  s.stats.rebuilds++;
+  s.stats.rebuildMs += ms;
+}
+
+void RefitPolicy::resetStats()
+{
+  for(Structure& s : m_structures)
+  {
+    Stats& stats     = s.stats;
+    stats.refits     = 0;
+    stats.rebuilds   = 0;
+    stats.refitMs    = 0;
+    stats.rebuildMs  = 0;
+    stats.growthSum  = 0;
+    stats.updates    = 0;
+    stats.peakGrowth = stats.growth;
+  }
+}
+
+void RefitPolicy::logStats() const
+{
+  static const char* modes[] = {"adaptive", "always refit", "always rebuild"};
+  LOGI("Refit policy (%s, max growth %.2f, max refits %u, %u rebuilds per frame)\n", modes[m_mode], m_maxGrowth,
+       m_maxRefits, m_rebuildsPerFrame);
+  LOGI("  %-12s %10s %8s %8s %8s %8s %10s %10s\n", "structure", "primitives", "refits", "rebuilds", "growth",
+       "peak", "refit ms", "rebuild ms");  // Average growth, average times
+  for(const Structure& s : m_structures)
+  {
+    const Stats& st = s.stats;
+    LOGI("  %-12s %10u %8u %8u %8.3f %8.3f %10.3f %10.3f\n", st.name.c_str(), st.primitiveCount, st.refits,
+         st.rebuilds, st.updates > 0 ? st.growthSum / st.updates : 1.0, st.peakGrowth,
+         st.refits > 0 ? st.refitMs / st.refits : 0.0, st.rebuilds > 0 ? st.rebuildMs / st.rebuilds : 0.0);
+  }
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Refit-versus-rebuild decision for acceleration structures updated every frame
+// - A structure is described by the boxes of its primitives: triangles of a BLAS, instances of a
+//   TLAS. At each build the primitives are ordered along a Morton curve of their centers, which
+//   stands for the topology that the following refits keep.
+// - update() estimates the quality of a refit with the current boxes: the summed area of a 4-ary
+//   hierarchy over the build order, divided by the same over the current Morton order, i.e. what a
+//   rebuild would give. The growth is 1 right after a build and rises as the primitives drift.
+// - select() returns the structures to rebuild this frame: over m_maxGrowth, or refitted
+//   m_maxRefits times in a row, the worst first and at most m_rebuildsPerFrame of them, so that
+//   rebuilds are spread over frames. The others are refitted.
+// - The caller reports each refit and rebuild with its time; the stats are kept per structure
+//
+class RefitPolicy
+{
+public:
+  enum Mode
+  {
+    eAdaptive,      // select() as above
+    eAlwaysRefit,   // Never rebuild, the former behavior of the sample
+    eAlwaysRebuild  // Rebuild all at each frame
+  };
+
+  struct Aabb
+  {
+    glm::vec3 bmin;
+    glm::vec3 bmax;
+  };
+
+  struct Stats
+  {
+    std::string name;
+    uint32_t    primitiveCount{0};
+    uint32_t    refitsSinceBuild{0};
+    uint32_t    refits{0};
+    uint32_t    rebuilds{0};     // Not counting the first build
+    float       growth{1.f};     // Of the last update()
+    float       peakGrowth{1.f};
+    double      refitMs{0};      // Sums of the times reported by the caller
+    double      rebuildMs{0};
+    double      growthSum{0};    // Of all update(), for the average quality
+    uint32_t    updates{0};
+  };
+
+  uint32_t add(const std::string& name);
+  // The structure was built from these boxes
+  void built(uint32_t id, const std::vector<Aabb>& boxes);
+  // The primitives moved to these boxes, returns the growth of a refit
+  float update(uint32_t id, const std::vector<Aabb>& boxes);
+  // After update() of all structures, those to rebuild this frame
+  std::vector<uint32_t> select() const;
+  // What the caller did after select(); a rebuild takes the boxes of the last update()
+  void refitted(uint32_t id, double ms);
+  void rebuilt(uint32_t id, double ms);
+
+  uint32_t     count() const { return static_cast<uint32_t>(m_structures.size()); }
+  const Stats& stats(uint32_t id) const { return m_structures[id].stats; }
+  void         resetStats();
+  void         logStats() const;
+
+  Mode     m_mode{eAdaptive};
+  float    m_maxGrowth{1.5f};
+  uint32_t m_maxRefits{0};         // 0: no limit
+  uint32_t m_rebuildsPerFrame{1};  // 0: no limit
+
+private:
+  struct Structure
+  {
+    std::vector<uint32_t> order;  // Primitives in Morton order at the last build
+    std::vector<Aabb>     boxes;  // Of the last update()
+    Stats                 stats;
+  };
+
+  std::vector<Structure> m_structures;
+};
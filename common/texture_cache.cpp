@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "texture_cache.h"
+#include "nvh/nvprint.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+const char     kMagic[8]  = {'T', 'E', 'X', 'M', 'I', 'P', 'S', '\0'};
+const uint64_t kAlignment = 64;
+
+uint64_t alignUp(uint64_t v)
+{
+  return (v + kAlignment - 1) & ~(kAlignment - 1);
+}
+}  // namespace
+
+
+bool TextureCache::sourceKey(const std::string& sourceFilename, uint64_t& size, int64_t& time)
+{
+  std::error_code ec;
+  size = std::filesystem::file_size(sourceFilename, ec);
+  if(ec)
+    return false;
+  time = static_cast<int64_t>(std::filesystem::last_write_time(sourceFilename, ec).time_since_epoch().count());
+  return !ec;
+}
+
+bool TextureCache::open(const std::string& sourceFilename, Format format, uint32_t imageIndex)
+{
+  close();
+
+  uint64_t sourceSize;
+  int64_t  sourceTime;
+  if(!sourceKey(sourceFilename, sourceSize, sourceTime))
+    return false;
+
+  if(!m_file.open(cacheFilename(sourceFilename, imageIndex)) || m_file.size() < sizeof(Header))
+  {
+    close();
+    return false;
+  }
+
+  memcpy(&m_header, m_file.data(), sizeof(Header));
+  if(memcmp(m_header.magic, kMagic, sizeof(kMagic)) != 0 || m_header.version != kVersion || m_header.format != format
+     || m_header.sourceSize != sourceSize || m_header.sourceTime != sourceTime || m_header.imageIndex != imageIndex
+     || m_header.levelCount == 0
+     || sizeof(Header) + sizeof(Level) * uint64_t(m_header.levelCount) > m_file.size())
+  {
+    close();
+    return false;
+  }
+
+  m_levels.resize(m_header.levelCount);
+  memcpy(m_levels.data(), m_file.data() + sizeof(Header), sizeof(Level) * m_levels.size());
+  for(const Level& level : m_levels)
+  {
+    if(level.offset + level.size > m_file.size())
+    {
+      close();
+      return false;
+    }
+  }
+  return true;
+}
+
+void TextureCache::close()
+{
+  m_file.close();
+  m_header = {};
+  m_levels.clear();
+}
+
+bool TextureCache::write(const std::string& sourceFilename,
+                         Format             format,
+                         const TextureMips& texture,
+                         uint32_t           imageIndex)
+{
+  if(texture.blockBytes != (isCompressed(format) ? BcEncoder::blockBytes(bcFormat(format)) : 0))
+    return false;
+
+  Header header{};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version    = kVersion;
+  header.format     = format;
+  header.width      = texture.width;
+  header.height     = texture.height;
+  header.levelCount = texture.levelCount();
+  header.imageIndex = imageIndex;
+  if(!sourceKey(sourceFilename, header.sourceSize, header.sourceTime))
+    return false;
+
+  std::vector<Level> levels(header.levelCount);
+  uint64_t           offset = alignUp(sizeof(Header) + sizeof(Level) * levels.size());
+  for(uint32_t i = 0; i < header.levelCount; i++)
+  {
+    levels[i] = {offset, texture.levelSize(i)};
+    offset    = alignUp(offset + levels[i].size);
+  }
+
+  // Written to a temporary file first, so a concurrent reader never sees a partial container
+  std::string cacheName = cacheFilename(sourceFilename, imageIndex);
+  std::string tempName  = cacheName + ".tmp";
+  {
+    std::ofstream out(tempName, std::ios::binary | std::ios::trunc);
+    if(!out)
+      return false;
+
+    const char zeros[kAlignment] = {};
+    auto       pad               = [&]() {
+      uint64_t pos = static_cast<uint64_t>(out.tellp());
+      out.write(zeros, alignUp(pos) - pos);
+    };
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    out.write(reinterpret_cast<const char*>(levels.data()), sizeof(Level) * levels.size());
+    for(uint32_t i = 0; i < header.levelCount; i++)
+    {
+      pad();
+      out.write(reinterpret_cast<const char*>(texture.data.data() + texture.levelOffsets[i]), levels[i].size);
+    }
+    if(!out)
+      return false;
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tempName, cacheName, ec);
+  if(ec)
+  {
+    std::filesystem::remove(tempName, ec);
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Missing images are not baked: a magenta container would hide the file once it is added
+//
+uint32_t TextureCache::bake(const std::vector<std::string>& imageFilenames,
+                           Format                          format,
+                           BcEncoder::Quality              quality,
+                           bool                            force,
+                           ThreadPool&                     pool)
+{
+  std::vector<std::string> todo;
+  for(const auto& filename : imageFilenames)
+  {
+    TextureCache cache;
+    if(force || !cache.open(filename, format))
+      todo.push_back(filename);
+  }
+
+  std::vector<TextureMips> textures = TextureLoader::loadAll(todo, format != eRGBA8Unorm, pool);
+
+  uint32_t written = 0;
+  for(size_t i = 0; i < todo.size(); i++)
+  {
+    if(!textures[i].loaded)
+      continue;
+    if(isCompressed(format))
+    {
+      BcEncoder::compress(textures[i], bcFormat(format), quality, pool);
+      LOGI("  %s: %ux%u, %.2f ms, PSNR %.2f dB\n", todo[i].c_str(), textures[i].width, textures[i].height,
+           textures[i].compressMs, textures[i].psnr);
+    }
+    if(write(todo[i], format, textures[i]))
+      written++;
+  }
+  return written;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "bc_encoder.h"
+#include "mapped_file.h"
+#include "texture_loader.h"
+
+//--------------------------------------------------------------------------------------------------
+// Pre-baked texture with all its mip levels, stored next to the image as <file>.mips
+// An image embedded in another file (e.g. a .glb) is keyed by that file and the image index, and
+// stored as <file>.img<index>.mips
+//
+// Layout (little endian, levels aligned to 64 bytes):
+//   Header | Level table | level 0 | level 1 | ...
+// The container is valid when version, format, image index, source size and modification time match.
+// open() maps the file: levels are copied from the mapped pages to the staging buffer, no decode
+// and no mip generation at load time.
+//
+class TextureCache
+{
+public:
+  static constexpr uint32_t kVersion = 2;
+  static constexpr uint32_t kWholeFile = ~0u;  // The source file is the image itself
+
+  enum Format : uint32_t
+  {
+    eRGBA8Unorm,
+    eRGBA8Srgb,
+    eBC1Srgb,
+    eBC3Srgb,
+    eBC7Srgb,
+  };
+
+  static bool              isCompressed(Format format) { return format >= eBC1Srgb; }
+  static BcEncoder::Format bcFormat(Format format)
+  {
+    if(format == eBC1Srgb)
+      return BcEncoder::Format::eBC1;
+    return format == eBC3Srgb ? BcEncoder::Format::eBC3 : BcEncoder::Format::eBC7;
+  }
+
+  static std::string cacheFilename(const std::string& sourceFilename, uint32_t imageIndex = kWholeFile)
+  {
+    if(imageIndex == kWholeFile)
+      return sourceFilename + ".mips";
+    return sourceFilename + ".img" + std::to_string(imageIndex) + ".mips";
+  }
+
+  // Maps the container of the image; false when there is none or it does not match
+  bool open(const std::string& sourceFilename, Format format, uint32_t imageIndex = kWholeFile);
+  void close();
+
+  static bool write(const std::string& sourceFilename,
+                    Format             format,
+                    const TextureMips& texture,
+                    uint32_t           imageIndex = kWholeFile);
+
+  // Offline conversion: decodes, builds the mips, compresses them for BCn formats and writes the
+  // container of each image. Images already having a valid container are skipped unless `force`.
+  // Returns the number written.
+  static uint32_t bake(const std::vector<std::string>& imageFilenames,
+                       Format                          format,
+                       BcEncoder::Quality              quality = BcEncoder::Quality::eNormal,
+                       bool                            force   = false,
+                       ThreadPool&                     pool    = ThreadPool::global());
+
+  uint32_t       width() const { return m_header.width; }
+  uint32_t       height() const { return m_header.height; }
+  uint32_t       levelCount() const { return m_header.levelCount; }
+  uint32_t       levelWidth(uint32_t level) const { return std::max(m_header.width >> level, 1u); }
+  uint32_t       levelHeight(uint32_t level) const { return std::max(m_header.height >> level, 1u); }
+  const uint8_t* levelData(uint32_t level) const { return m_file.data() + m_levels[level].offset; }
+  size_t         levelSize(uint32_t level) const { return static_cast<size_t>(m_levels[level].size); }
+  size_t         fileSize() const { return m_file.size(); }
+
+private:
+  struct Header
+  {
+    char     magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t sourceSize;
+    int64_t  sourceTime;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint32_t imageIndex;
+  };
+
+  struct Level
+  {
+    uint64_t offset;  // From the start of the file
+    uint64_t size;
+  };
+
+  static bool sourceKey(const std::string& sourceFilename, uint64_t& size, int64_t& time);
+
+  MappedFile         m_file;
+  Header             m_header{};
+  std::vector<Level> m_levels;
+};
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "texture_loader.h"
+#include "stb_image.h"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+
+namespace {
+
+// sRGB <-> linear conversions as tables: 256 entries to linear, 16384 to go back
+struct SrgbTables
+{
+  static constexpr uint32_t kToSrgbSize = 16384;
+
+  std::array<float, 256> toLinear;
+  std::vector<uint8_t>   toSrgb;
+
+  SrgbTables()
+      : toSrgb(kToSrgbSize + 1)
+  {
+    for(int i = 0; i < 256; i++)
+    {
+      float c     = i / 255.f;
+      toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for(uint32_t i = 0; i <= kToSrgbSize; i++)
+    {
+      float l   = float(i) / kToSrgbSize;
+      float c   = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+      toSrgb[i] = static_cast<uint8_t>(std::min(std::max(c, 0.f), 1.f) * 255.f + 0.5f);
+    }
+  }
+
+  uint8_t encode(float linear) const { return toSrgb[static_cast<uint32_t>(linear * kToSrgbSize + 0.5f)]; }
+};
+
+const SrgbTables& srgbTables()
+{
+  static SrgbTables tables;
+  return tables;
+}
+
+double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+}  // namespace
+
+
+TextureMips TextureLoader::load(const std::string& filename, bool srgb, ThreadPool& pool)
+{
+  auto start = std::chrono::high_resolution_clock::now();
+
+  int      width = 0, height = 0, channels = 0;
+  stbi_uc* pixels   = stbi_load(filename.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+  double   decodeMs = elapsedMs(start);
+
+  TextureMips texture;
+  if(pixels != nullptr)
+  {
+    texture        = fromPixels(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), srgb, pool);
+    texture.loaded = true;
+    stbi_image_free(pixels);
+  }
+  else
+  {
+    const uint8_t magenta[4] = {255u, 0u, 255u, 255u};
+    texture                  = fromPixels(magenta, 1, 1, srgb, pool);
+    texture.loaded           = false;
+  }
+  texture.decodeMs = decodeMs;
+  return texture;
+}
+
+TextureMips TextureLoader::fromPixels(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, ThreadPool& pool)
+{
+  TextureMips texture;
+  texture.width  = width;
+  texture.height = height;
+  texture.loaded = true;
+
+  // Full chain down to 1x1 (as nvvk::mipLevels), levels laid out back to back
+  uint32_t nbLevels = 1;
+  while((std::max(width, height) >> nbLevels) > 0)
+    nbLevels++;
+  size_t total = 0;
+  for(uint32_t level = 0; level < nbLevels; level++)
+  {
+    texture.levelOffsets.push_back(total);
+    total += texture.levelSize(level);
+  }
+  texture.data.resize(total);
+  memcpy(texture.data.data(), rgba, texture.levelSize(0));
+
+  auto start = std::chrono::high_resolution_clock::now();
+  generateMips(texture, srgb, pool);
+  texture.mipsMs = elapsedMs(start);
+  return texture;
+}
+
+std::vector<TextureMips> TextureLoader::loadAll(const std::vector<std::string>& filenames, bool srgb, ThreadPool& pool)
+{
+  std::vector<TextureMips> textures(filenames.size());
+  pool.parallelBatches(filenames.size(), 1, [&](size_t i, size_t) { textures[i] = load(filenames[i], srgb, pool); });
+  return textures;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Each level is computed from the previous one, rows in parallel
+//
+void TextureLoader::generateMips(TextureMips& texture, bool srgb, ThreadPool& pool)
+{
+  const SrgbTables& tables = srgbTables();
+
+  for(uint32_t level = 1; level < texture.levelCount(); level++)
+  {
+    const uint8_t* src       = texture.data.data() + texture.levelOffsets[level - 1];
+    uint8_t*       dst       = texture.data.data() + texture.levelOffsets[level];
+    const uint32_t srcWidth  = texture.levelWidth(level - 1);
+    const uint32_t srcHeight = texture.levelHeight(level - 1);
+    const uint32_t width     = texture.levelWidth(level);
+    const uint32_t height    = texture.levelHeight(level);
+
+    pool.parallelBatches(height, 64, [&](size_t begin, size_t end) {
+      for(size_t y = begin; y < end; y++)
+      {
+        const uint8_t* row0 = src + size_t(std::min<size_t>(y * 2, srcHeight - 1)) * srcWidth * 4;
+        const uint8_t* row1 = src + size_t(std::min<size_t>(y * 2 + 1, srcHeight - 1)) * srcWidth * 4;
+        uint8_t*       out  = dst + y * width * 4;
+        for(uint32_t x = 0; x < width; x++)
+        {
+          const uint32_t x0 = std::min(x * 2, srcWidth - 1) * 4;
+          const uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+          for(uint32_t c = 0; c < 4; c++)
+          {
+            if(srgb && c < 3)
+            {
+              float sum = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]] + tables.toLinear[row1[x0 + c]]
+                          + tables.toLinear[row1[x1 + c]];
+              out[x * 4 + c] = tables.encode(sum * 0.25f);
+            }
+            else
+            {
+              uint32_t sum   = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+              out[x * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+            }
+          }
+        }
+      }
+    });
+  }
+}
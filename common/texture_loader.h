@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// CPU side of a texture: the full mip chain, level 0 first, as RGBA8 pixels or as 4x4 blocks once
+// compressed by BcEncoder
+//
+struct TextureMips
+{
+  uint32_t             width{0};
+  uint32_t             height{0};
+  std::vector<uint8_t> data;
+  std::vector<size_t>  levelOffsets;  // Offset of each level in `data`
+  uint32_t             blockBytes{0};  // 0: RGBA8 pixels, else bytes per 4x4 block
+  bool                 loaded{false};  // False when the file could not be decoded: 1x1 magenta
+  double               decodeMs{0};
+  double               mipsMs{0};
+  double               compressMs{0};
+  double               psnr{0};  // Of level 0 after compression, in dB
+
+  uint32_t levelCount() const { return static_cast<uint32_t>(levelOffsets.size()); }
+  uint32_t levelWidth(uint32_t level) const { return std::max(width >> level, 1u); }
+  uint32_t levelHeight(uint32_t level) const { return std::max(height >> level, 1u); }
+  size_t   levelSize(uint32_t level) const
+  {
+    if(blockBytes == 0)
+      return size_t(levelWidth(level)) * levelHeight(level) * 4;
+    return size_t((levelWidth(level) + 3) / 4) * ((levelHeight(level) + 3) / 4) * blockBytes;
+  }
+};
+
+//--------------------------------------------------------------------------------------------------
+// Texture decoding (stb_image) and mip generation on the thread pool
+// - Each file is decoded in its own task
+// - Mips are a 2x2 box filter, averaged in linear space for sRGB textures as a blit of an sRGB
+//   image does; odd sizes clamp the last row/column
+//
+class TextureLoader
+{
+public:
+  static std::vector<TextureMips> loadAll(const std::vector<std::string>& filenames,
+                                          bool                            srgb = true,
+                                          ThreadPool&                     pool = ThreadPool::global());
+
+  static TextureMips load(const std::string& filename, bool srgb = true, ThreadPool& pool = ThreadPool::global());
+
+  // Same from pixels already in memory (RGBA8, width * height * 4 bytes)
+  static TextureMips fromPixels(const uint8_t* rgba,
+                                uint32_t       width,
+                                uint32_t       height,
+                                bool           srgb = true,
+                                ThreadPool&    pool = ThreadPool::global());
+
+  // Fills the levels after level 0, down to 1x1
+  static void generateMips(TextureMips& texture, bool srgb, ThreadPool& pool = ThreadPool::global());
+};
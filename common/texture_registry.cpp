@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "texture_registry.h"
+#include "mapped_file.h"
+
+#include <cstring>
+#include <filesystem>
+
+
+bool TextureRegistry::contentHash(const std::string& filename, uint64_t& hash, uint64_t& size)
+{
+  MappedFile file;
+  if(!file.open(filename))
+    return false;
+
+  hash                = 14695981039346656037ull;
+  const uint8_t* data = file.data();
+  for(size_t i = 0; i < file.size(); i++)
+    hash = (hash ^ data[i]) * 1099511628211ull;
+  size = file.size();
+  return true;
+}
+
+bool TextureRegistry::sameContent(const std::string& a, const std::string& b)
+{
+  MappedFile fileA, fileB;
+  if(!fileA.open(a) || !fileB.open(b) || fileA.size() != fileB.size())
+    return false;
+  return fileA.size() == 0 || memcmp(fileA.data(), fileB.data(), fileA.size()) == 0;
+}
+
+std::vector<uint32_t> TextureRegistry::add(const std::vector<std::string>& filenames,
+                                           uint32_t                        firstNewIndex,
+                                           std::vector<std::string>&       newFiles)
+{
+  std::vector<uint32_t> indices;
+  indices.reserve(filenames.size());
+  for(const auto& filename : filenames)
+  {
+    m_references++;
+
+    std::error_code ec;
+    std::string     path = std::filesystem::weakly_canonical(filename, ec).string();
+    if(ec)
+      path = filename;
+
+    auto byPath = m_byPath.find(path);
+    if(byPath != m_byPath.end())
+    {
+      m_entries[byPath->second].duplicates++;
+      indices.push_back(byPath->second);
+      continue;
+    }
+
+    uint64_t hash = 0, size = 0;
+    bool     readable = contentHash(path, hash, size);
+    if(readable)
+    {
+      // The hash only selects the candidates: a collision must not bind another image
+      auto     range = m_byContent.equal_range({hash, size});
+      uint32_t found = ~0u;
+      for(auto it = range.first; it != range.second && found == ~0u; ++it)
+      {
+        if(sameContent(m_entries[it->second].path, path))
+          found = it->second;
+      }
+      if(found != ~0u)
+      {
+        m_byPath[path] = found;
+        m_entries[found].duplicates++;
+        indices.push_back(found);
+        continue;
+      }
+    }
+
+    uint32_t index = firstNewIndex + static_cast<uint32_t>(newFiles.size());
+    newFiles.push_back(filename);
+    m_byPath[path]        = index;
+    m_entries[index]      = {};
+    m_entries[index].path = path;
+    if(readable)
+      m_byContent.insert({{hash, size}, index});
+    indices.push_back(index);
+  }
+  return indices;
+}
+
+uint64_t TextureRegistry::savedBytes() const
+{
+  uint64_t saved = 0;
+  for(const auto& entry : m_entries)
+    saved += entry.second.bytes * entry.second.duplicates;
+  return saved;
+}
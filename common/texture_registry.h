@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Registry of the textures uploaded for all models, so an image is only uploaded once
+// - Files are identified by their canonical path, then by their content (hash and size, confirmed
+//   by a byte comparison): the same image under two names or in two folders is shared
+// - Missing files are only shared by path
+//
+class TextureRegistry
+{
+public:
+  // Global index of each file. Files not registered yet get indices from `firstNewIndex` in order,
+  // and are appended to `newFiles`: the caller must create them at these indices.
+  std::vector<uint32_t> add(const std::vector<std::string>& filenames,
+                            uint32_t                        firstNewIndex,
+                            std::vector<std::string>&       newFiles);
+
+  // Memory of the texture at `index`, for the report of the memory saved
+  void setBytes(uint32_t index, uint64_t bytes) { m_entries[index].bytes = bytes; }
+
+  uint32_t uniqueCount() const { return static_cast<uint32_t>(m_entries.size()); }
+  uint32_t referenceCount() const { return m_references; }
+  uint64_t savedBytes() const;
+
+  // FNV-1a of the file content, false when the file cannot be read
+  static bool contentHash(const std::string& filename, uint64_t& hash, uint64_t& size);
+
+  // Byte comparison of two files, false when either cannot be read
+  static bool sameContent(const std::string& a, const std::string& b);
+
+private:
+  struct Entry
+  {
+    std::string path;  // Canonical path of the file first registered, compared on a hash match
+    uint64_t    bytes{0};
+    uint32_t    duplicates{0};  // Number of times this texture was requested again
+  };
+
+  std::unordered_map<std::string, uint32_t>              m_byPath;
+  std::multimap<std::pair<uint64_t, uint64_t>, uint32_t> m_byContent;  // (hash, size), several on a collision
+  std::unordered_map<uint32_t, Entry>                    m_entries;
+  uint32_t                                               m_references{0};
+};
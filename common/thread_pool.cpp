@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+
+ThreadPool::ThreadPool(uint32_t nbThreads)
+{
+  nbThreads = std::max(nbThreads, 1u);
+  m_workers.reserve(nbThreads);
+  for(uint32_t i = 0; i < nbThreads; i++)
+  {
+    m_workers.emplace_back([this] {
+      for(;;)
+      {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          m_condition.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+          if(m_stop && m_tasks.empty())
+            return;
+          task = std::move(m_tasks.front());
+          m_tasks.pop();
+        }
+        task();
+      }
+    });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_condition.notify_all();
+  for(auto& worker : m_workers)
+    worker.join();
+}
+
+ThreadPool& ThreadPool::global()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Batches are picked with an atomic counter by the workers and by the calling thread.
+// Workers arriving after all batches were taken return immediately, and the caller only waits
+// for batches already being processed.
+//
+void ThreadPool::parallelBatches(size_t count, size_t batchSize, const std::function<void(size_t, size_t)>& fn)
+{
+  if(count == 0)
+    return;
+  batchSize              = std::max<size_t>(batchSize, 1);
+  const size_t nbBatches = (count + batchSize - 1) / batchSize;
+  if(nbBatches == 1)
+  {
+    fn(0, count);
+    return;
+  }
+
+  struct State
+  {
+    std::atomic<size_t>     next{0};
+    std::atomic<size_t>     done{0};
+    std::mutex              mutex;
+    std::condition_variable finished;
+  };
+  auto state = std::make_shared<State>();
+
+  auto work = [state, count, batchSize, nbBatches, &fn]() {
+    for(size_t b = state->next++; b < nbBatches; b = state->next++)
+    {
+      size_t begin = b * batchSize;
+      fn(begin, std::min(begin + batchSize, count));
+      if(++state->done == nbBatches)
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->finished.notify_all();
+      }
+    }
+  };
+
+  const size_t nbHelpers = std::min<size_t>(nbBatches - 1, size());
+  for(size_t i = 0; i < nbHelpers; i++)
+    submit(work);
+  work();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished.wait(lock, [&] { return state->done == nbBatches; });
+}
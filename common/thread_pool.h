@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Minimal pool of worker threads used by the CPU side of the samples (asset loading, ...)
+// - submit() queues a task and returns its future
+// - parallelBatches() splits [0, count) in batches; the calling thread works on the batches too,
+//   so it can be called from inside a task without dead-locking the pool
+//
+class ThreadPool
+{
+public:
+  explicit ThreadPool(uint32_t nbThreads = std::thread::hardware_concurrency());
+  ~ThreadPool();
+
+  // Shared pool, created on first use
+  static ThreadPool& global();
+
+  uint32_t size() const { return static_cast<uint32_t>(m_workers.size()); }
+
+  template <typename F>
+  auto submit(F&& func) -> std::future<decltype(func())>
+  {
+    using R   = decltype(func());
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+    auto res  = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_tasks.emplace([task]() { (*task)(); });
+    }
+    m_condition.notify_one();
+    return res;
+  }
+
+  // Calls fn(begin, end) for each batch of `batchSize` items, returns when all batches are done
+  void parallelBatches(size_t count, size_t batchSize, const std::function<void(size_t, size_t)>& fn);
+
+private:
+  std::vector<std::thread>          m_workers;
+  std::queue<std::function<void()>> m_tasks;
+  std::mutex                        m_mutex;
+  std::condition_variable           m_condition;
+  bool                              m_stop{false};
+};
@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "upload_manager.h"
+#include "nvvk/images_vk.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+void UploadManager::init(nvvk::ResourceAllocator* alloc,
+                         VkDevice                 device,
+                         uint32_t                 queueFamily,
+                         VkDeviceSize             ringSize,
+                         VkDeviceSize             batchBytes)
+{
+  m_alloc      = alloc;
+  m_device     = device;
+  m_ringSize   = ringSize;
+  m_batchBytes = batchBytes;
+  vkGetDeviceQueue(m_device, queueFamily, 0, &m_queue);
+
+  VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  poolInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = queueFamily;
+  vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_pool);
+
+  VkSemaphoreTypeCreateInfo typeInfo{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue  = 0;
+  VkSemaphoreCreateInfo semaphoreInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+  semaphoreInfo.pNext = &typeInfo;
+  vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_timeline);
+
+  m_ring     = m_alloc->createBuffer(m_ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  m_ringData = static_cast<uint8_t*>(m_alloc->map(m_ring));
+}
+
+void UploadManager::deinit()
+{
+  if(m_device == VK_NULL_HANDLE)
+    return;
+
+  waitIdle();
+  m_alloc->unmap(m_ring);
+  m_alloc->destroy(m_ring);
+  vkDestroyCommandPool(m_device, m_pool, nullptr);  // Frees all command buffers
+  vkDestroySemaphore(m_device, m_timeline, nullptr);
+
+  m_freeCmdBufs.clear();
+  m_ringData = nullptr;
+  m_head = m_tail = 0;
+  m_value         = 0;
+  m_pool          = VK_NULL_HANDLE;
+  m_timeline      = VK_NULL_HANDLE;
+  m_device        = VK_NULL_HANDLE;
+}
+
+nvvk::Buffer UploadManager::createBuffer(VkDeviceSize size, const void* data, VkBufferUsageFlags usage)
+{
+  nvvk::Buffer result =
+      m_alloc->createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if(size != 0 && data != nullptr)
+    copyToBuffer(result.buffer, 0, size, data);
+  return result;
+}
+
+void UploadManager::copyToBuffer(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size, const void* data)
+{
+  VkBuffer     src;
+  VkDeviceSize srcOffset;
+  memcpy(stage(size, src, srcOffset), data, size);
+
+  VkBufferCopy region{srcOffset, dstOffset, size};
+  vkCmdCopyBuffer(commandBuffer(), src, dst, 1, &region);
+  addBytes(size);
+}
+
+void UploadManager::release(const nvvk::Buffer& buffer)
+{
+  commandBuffer();
+  m_current.released.push_back(buffer);
+}
+
+nvvk::Image UploadManager::createImage(const VkImageCreateInfo& info, VkDeviceSize size, const void* data)
+{
+  VkImageCreateInfo createInfo = info;
+  createInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  nvvk::Image result = m_alloc->createImage(createInfo);
+
+  VkBuffer     src;
+  VkDeviceSize srcOffset;
+  memcpy(stage(size, src, srcOffset), data, size);
+
+  VkCommandBuffer         cmdBuf = commandBuffer();
+  VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, info.mipLevels, 0, info.arrayLayers};
+  nvvk::cmdBarrierImageLayout(cmdBuf, result.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
+
+  VkBufferImageCopy region{};
+  region.bufferOffset     = srcOffset;
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, info.arrayLayers};
+  region.imageExtent      = info.extent;
+  vkCmdCopyBufferToImage(cmdBuf, src, result.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  addBytes(size);
+  return result;
+}
+
+VkCommandBuffer UploadManager::commandBuffer()
+{
+  if(m_current.cmdBuf == VK_NULL_HANDLE)
+  {
+    retire();
+    if(m_freeCmdBufs.empty())
+    {
+      VkCommandBufferAllocateInfo allocInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+      allocInfo.commandPool        = m_pool;
+      allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      allocInfo.commandBufferCount = 1;
+      vkAllocateCommandBuffers(m_device, &allocInfo, &m_current.cmdBuf);
+    }
+    else
+    {
+      m_current.cmdBuf = m_freeCmdBufs.back();
+      m_freeCmdBufs.pop_back();
+    }
+
+    VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(m_current.cmdBuf, &beginInfo);
+  }
+  return m_current.cmdBuf;
+}
+
+uint64_t UploadManager::flush()
+{
+  if(m_current.cmdBuf == VK_NULL_HANDLE)
+    return m_value;
+
+  // Transfers visible to everything submitted after
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+  vkCmdPipelineBarrier(m_current.cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+                       &barrier, 0, nullptr, 0, nullptr);
+  vkEndCommandBuffer(m_current.cmdBuf);
+
+  m_current.value = ++m_value;
+  VkTimelineSemaphoreSubmitInfo timelineInfo{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+  timelineInfo.signalSemaphoreValueCount = 1;
+  timelineInfo.pSignalSemaphoreValues    = &m_current.value;
+  VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.pNext                = &timelineInfo;
+  submitInfo.commandBufferCount   = 1;
+  submitInfo.pCommandBuffers      = &m_current.cmdBuf;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores    = &m_timeline;
+  vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE);
+  m_submitCount++;
+
+  m_inFlight.push_back(std::move(m_current));
+  m_current      = {};
+  m_currentBytes = 0;
+  return m_value;
+}
+
+void UploadManager::wait(uint64_t value)
+{
+  VkSemaphoreWaitInfo waitInfo{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores    = &m_timeline;
+  waitInfo.pValues        = &value;
+  vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX);
+}
+
+void UploadManager::waitIdle()
+{
+  flush();
+  wait(m_value);
+  retire();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Releases the ring space, command buffers and temporary buffers of the completed batches
+//
+void UploadManager::retire()
+{
+  uint64_t completed = 0;
+  vkGetSemaphoreCounterValue(m_device, m_timeline, &completed);
+  while(!m_inFlight.empty() && m_inFlight.front().value <= completed)
+  {
+    Batch& batch = m_inFlight.front();
+    m_tail       = std::max(m_tail, batch.ringEnd);
+    m_freeCmdBufs.push_back(batch.cmdBuf);
+    for(auto& buffer : batch.temporaries)
+    {
+      m_alloc->unmap(buffer);
+      m_alloc->destroy(buffer);
+    }
+    for(auto& buffer : batch.released)
+      m_alloc->destroy(buffer);
+    m_inFlight.pop_front();
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Ranges are allocated contiguously: a range not fitting before the end of the ring starts at the
+// beginning. When the ring is full, the oldest batch is waited for (the current one is submitted
+// first if it holds all the space).
+//
+void* UploadManager::stage(VkDeviceSize size, VkBuffer& buffer, VkDeviceSize& offset)
+{
+  commandBuffer();
+  if(size > m_ringSize)
+  {
+    const VkMemoryPropertyFlags hostFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    nvvk::Buffer                temporary = m_alloc->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, hostFlags);
+    m_current.temporaries.push_back(temporary);
+    buffer = temporary.buffer;
+    offset = 0;
+    return m_alloc->map(temporary);
+  }
+
+  const VkDeviceSize alignment = 16;  // Multiple of the texel and block sizes, for image copies
+  VkDeviceSize       start     = (m_head + alignment - 1) & ~(alignment - 1);
+  if(start % m_ringSize + size > m_ringSize)
+    start = (start / m_ringSize + 1) * m_ringSize;
+
+  for(;;)
+  {
+    retire();
+    if(start + size - m_tail <= m_ringSize)
+      break;
+    if(m_inFlight.empty())
+    {
+      if(m_current.ringEnd <= m_tail)
+      {
+        m_tail = start;  // Nothing in use
+        break;
+      }
+      flush();
+    }
+    wait(m_inFlight.front().value);
+  }
+
+  m_head            = start + size;
+  m_current.ringEnd = m_head;
+  buffer            = m_ring.buffer;
+  offset            = start % m_ringSize;
+  return m_ringData + offset;
+}
+
+void UploadManager::addBytes(VkDeviceSize size)
+{
+  m_currentBytes += size;
+  m_uploadedBytes += size;
+  if(m_currentBytes >= m_batchBytes)
+    flush();
+}
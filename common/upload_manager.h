@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include <deque>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Batched uploads through a persistent staging ring buffer
+// - Copies are recorded in the command buffer of the current batch, which is submitted when it
+//   holds `batchBytes`, when the ring is full or on flush(). Submitting does not wait: the CPU
+//   continues (e.g. parsing the next model) while the GPU copies.
+// - Each submission signals a timeline semaphore value; ring space of a batch is reused once the
+//   semaphore reached it. Only a full ring makes the CPU wait.
+// - A memory barrier ends each batch, so later submissions on the same queue see the data.
+// - Uploads larger than the ring use a temporary staging buffer, released with their batch.
+// The command buffer of the current batch can change after any upload: get it with
+// commandBuffer() right before recording.
+//
+class UploadManager
+{
+public:
+  void init(nvvk::ResourceAllocator* alloc,
+            VkDevice                 device,
+            uint32_t                 queueFamily,
+            VkDeviceSize             ringSize   = 64 * 1024 * 1024,
+            VkDeviceSize             batchBytes = 16 * 1024 * 1024);
+  void deinit();
+
+  // Device local buffer filled with `data`, as ResourceAllocator::createBuffer(cmdBuf, ...)
+  nvvk::Buffer createBuffer(VkDeviceSize size, const void* data, VkBufferUsageFlags usage);
+  template <typename T>
+  nvvk::Buffer createBuffer(const std::vector<T>& data, VkBufferUsageFlags usage)
+  {
+    return createBuffer(sizeof(T) * data.size(), data.data(), usage);
+  }
+
+  // Copies `data` to an existing buffer created with VK_BUFFER_USAGE_TRANSFER_DST_BIT
+  void copyToBuffer(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size, const void* data);
+  // Destroys `buffer` once the commands recorded so far have completed
+  void release(const nvvk::Buffer& buffer);
+
+  // Image with level 0 filled with `data`, left in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+  nvvk::Image createImage(const VkImageCreateInfo& info, VkDeviceSize size, const void* data);
+
+  VkCommandBuffer commandBuffer();
+  uint64_t        flush();  // Submits the current batch, returns the value it signals
+  void            wait(uint64_t value);
+  void            waitIdle();
+
+  uint32_t submitCount() const { return m_submitCount; }
+  uint64_t uploadedBytes() const { return m_uploadedBytes; }
+
+private:
+  struct Batch
+  {
+    VkCommandBuffer           cmdBuf{VK_NULL_HANDLE};
+    uint64_t                  value{0};     // Timeline value signaled at completion
+    VkDeviceSize              ringEnd{0};   // Ring position released at completion
+    std::vector<nvvk::Buffer> temporaries;  // Staging of uploads larger than the ring
+    std::vector<nvvk::Buffer> released;     // Buffers destroyed at completion, see release()
+  };
+
+  // Staging memory for `size` bytes: a ring range or a temporary buffer of the current batch
+  void* stage(VkDeviceSize size, VkBuffer& buffer, VkDeviceSize& offset);
+  void  retire();
+  void  addBytes(VkDeviceSize size);
+
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  VkDevice                 m_device{VK_NULL_HANDLE};
+  VkQueue                  m_queue{VK_NULL_HANDLE};
+  VkCommandPool            m_pool{VK_NULL_HANDLE};
+  VkSemaphore              m_timeline{VK_NULL_HANDLE};
+
+  nvvk::Buffer m_ring;
+  uint8_t*     m_ringData{nullptr};
+  VkDeviceSize m_ringSize{0};
+  VkDeviceSize m_head{0};  // Positions grow forever, the ring offset is position % m_ringSize
+  VkDeviceSize m_tail{0};  // Start of the oldest range still in use by the GPU
+
+  Batch                        m_current;
+  VkDeviceSize                 m_currentBytes{0};
+  VkDeviceSize                 m_batchBytes{0};
+  std::deque<Batch>            m_inFlight;
+  std::vector<VkCommandBuffer> m_freeCmdBufs;
+  uint64_t                     m_value{0};  // Last signaled value
+  uint32_t                     m_submitCount{0};
+  uint64_t                     m_uploadedBytes{0};
+};
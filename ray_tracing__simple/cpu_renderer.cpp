@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "cpu_renderer.h"
+#include "nvh/nvprint.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+
+namespace {
+constexpr uint32_t kTileSize = 16;
+
+// sRGB to linear of the 8-bit values, as the sampling of a VK_FORMAT_R8G8B8A8_SRGB texture
+const std::array<float, 256>& srgbToLinear()
+{
+  static const std::array<float, 256> table = [] {
+    std::array<float, 256> t{};
+    for(int i = 0; i < 256; i++)
+    {
+      float c = i / 255.f;
+      t[i]    = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    return t;
+  }();
+  return table;
+}
+
+// wavefront.glsl
+glm::vec3 computeDiffuse(const MaterialObj& mat, const glm::vec3& lightDir, const glm::vec3& normal)
+{
+  float     dotNL = std::max(glm::dot(normal, lightDir), 0.f);
+  glm::vec3 c     = mat.diffuse * dotNL;
+  if(mat.illum >= 1)
+    c += mat.ambient;
+  return c;
+}
+
+glm::vec3 computeSpecular(const MaterialObj& mat,
+                          const glm::vec3&   viewDir,
+                          const glm::vec3&   lightDir,
+                          const glm::vec3&   normal)
+{
+  if(mat.illum < 2)
+    return glm::vec3(0);
+
+  const float kPi                 = 3.14159265f;
+  const float kShininess          = std::max(mat.shininess, 4.f);
+  const float kEnergyConservation = (2.f + kShininess) / (2.f * kPi);
+  glm::vec3   V                   = glm::normalize(-viewDir);
+  glm::vec3   R                   = glm::reflect(-lightDir, normal);
+  float       specular            = kEnergyConservation * std::pow(std::max(glm::dot(V, R), 0.f), kShininess);
+  return mat.specular * specular;
+}
+}  // namespace
+
+
+void CpuRenderer::addModel(const ObjLoader&                loader,
+                           const std::vector<TextureMips>& textures,
+                           const glm::mat4&                transform)
+{
+  Model model;
+  model.vertices  = loader.m_vertices;
+  model.indices   = loader.m_indices;
+  model.materials = loader.m_materials;
+  model.matIndx   = loader.m_matIndx;
+  model.txtOffset = static_cast<uint32_t>(m_textures.size());
+  // Converting from Srgb to linear
+  for(auto& m : model.materials)
+  {
+    m.ambient  = glm::pow(m.ambient, glm::vec3(2.2f));
+    m.diffuse  = glm::pow(m.diffuse, glm::vec3(2.2f));
+    m.specular = glm::pow(m.specular, glm::vec3(2.2f));
+  }
+
+  for(const TextureMips& mips : textures)
+  {
+    Texture texture;
+    texture.width  = mips.width;
+    texture.height = mips.height;
+    texture.rgba.assign(mips.data.begin(), mips.data.begin() + mips.levelSize(0));
+    m_textures.push_back(std::move(texture));
+  }
+
+  Instance instance;
+  instance.objIndex     = static_cast<uint32_t>(m_models.size());
+  instance.transform    = transform;
+  instance.normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+  m_instances.push_back(instance);
+  m_models.push_back(std::move(model));
+}
+
+void CpuRenderer::build(ThreadPool& pool)
+{
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  m_positions.clear();
+  m_indices.clear();
+  for(Instance& instance : m_instances)
+  {
+    const Model&   model      = m_models[instance.objIndex];
+    const uint32_t baseVertex = static_cast<uint32_t>(m_positions.size());
+    instance.firstTriangle    = static_cast<uint32_t>(m_indices.size() / 3);
+    for(const VertexObj& v : model.vertices)
+    {
+      glm::vec4 p = instance.transform * glm::vec4(v.pos, 1.f);
+      m_positions.emplace_back(p.x, p.y, p.z);
+    }
+    for(uint32_t i : model.indices)
+      m_indices.push_back(baseVertex + i);
+  }
+
+  m_bvh.build(m_positions, m_indices, pool);
+  m_traversal.build(m_bvh, m_positions, m_indices);
+
+  auto endTime    = std::chrono::high_resolution_clock::now();
+  m_stats.buildMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Bilinear filtering with repeat addressing, in linear space
+//
+glm::vec3 CpuRenderer::sample(const Texture& texture, glm::vec2 uv) const
+{
+  const auto& toLinear = srgbToLinear();
+  const float x        = uv.x * texture.width - 0.5f;
+  const float y        = uv.y * texture.height - 0.5f;
+  const float fx       = std::floor(x);
+  const float fy       = std::floor(y);
+  const float wx       = x - fx;
+  const float wy       = y - fy;
+
+  auto wrap = [](float c, uint32_t size) {
+    int64_t i = static_cast<int64_t>(c) % static_cast<int64_t>(size);
+    return static_cast<uint32_t>(i < 0 ? i + size : i);
+  };
+  const uint32_t x0 = wrap(fx, texture.width);
+  const uint32_t x1 = wrap(fx + 1.f, texture.width);
+  const uint32_t y0 = wrap(fy, texture.height);
+  const uint32_t y1 = wrap(fy + 1.f, texture.height);
+
+  auto texel = [&](uint32_t tx, uint32_t ty) {
+    const uint8_t* p = &texture.rgba[(size_t(ty) * texture.width + tx) * 4];
+    return glm::vec3(toLinear[p[0]], toLinear[p[1]], toLinear[p[2]]);
+  };
+  glm::vec3 top    = texel(x0, y0) * (1.f - wx) + texel(x1, y0) * wx;
+  glm::vec3 bottom = texel(x0, y1) * (1.f - wx) + texel(x1, y1) * wx;
+  return top * (1.f - wy) + bottom * wy;
+}
+
+//--------------------------------------------------------------------------------------------------
+// raytrace.rchit, or raytrace.rmiss without hit
+//
+glm::vec3 CpuRenderer::shade(const CpuTraversal::Ray& ray, const PushConstantRay& pcRay, uint64_t& shadowRays) const
+{
+  CpuTraversal::Hit hit;
+  if(!m_traversal.closestHit(ray, hit))
+    return glm::vec3(pcRay.clearColor.x, pcRay.clearColor.y, pcRay.clearColor.z) * 0.8f;
+
+  // Instance of the triangle and triangle in its model, as gl_InstanceCustomIndexEXT and gl_PrimitiveID
+  auto it = std::upper_bound(m_instances.begin(), m_instances.end(), hit.triangle,
+                             [](uint32_t t, const Instance& instance) { return t < instance.firstTriangle; });
+  const Instance& instance    = *(it - 1);
+  const Model&    model       = m_models[instance.objIndex];
+  const uint32_t  primitiveId = hit.triangle - instance.firstTriangle;
+
+  const VertexObj& v0 = model.vertices[model.indices[primitiveId * 3 + 0]];
+  const VertexObj& v1 = model.vertices[model.indices[primitiveId * 3 + 1]];
+  const VertexObj& v2 = model.vertices[model.indices[primitiveId * 3 + 2]];
+  const float      b0 = 1.f - hit.u - hit.v;
+
+  const glm::vec3 worldPos = ray.origin + ray.direction * hit.t;
+  const glm::vec3 nrm      = v0.nrm * b0 + v1.nrm * hit.u + v2.nrm * hit.v;
+  const glm::vec3 worldNrm = glm::normalize(instance.normalMatrix * nrm);
+
+  // Vector toward the light
+  glm::vec3 L;
+  float     lightIntensity = pcRay.lightIntensity;
+  float     lightDistance  = 100000.f;
+  if(pcRay.lightType == 0)
+  {
+    glm::vec3 lDir = pcRay.lightPosition - worldPos;
+    lightDistance  = glm::length(lDir);
+    lightIntensity = pcRay.lightIntensity / (lightDistance * lightDistance);
+    L              = glm::normalize(lDir);
+  }
+  else
+  {
+    L = glm::normalize(pcRay.lightPosition);
+  }
+
+  const int32_t      matIdx = model.matIndx.empty() ? 0 : std::max(model.matIndx[primitiveId], 0);
+  const MaterialObj& mat    = model.materials[matIdx];
+
+  glm::vec3 diffuse = computeDiffuse(mat, L, worldNrm);
+  if(mat.textureID >= 0)
+  {
+    const glm::vec2 texCoord = v0.texCoord * b0 + v1.texCoord * hit.u + v2.texCoord * hit.v;
+    diffuse                  = diffuse * sample(m_textures[mat.textureID + model.txtOffset], texCoord);
+  }
+
+  glm::vec3 specular(0.f);
+  float     attenuation = 1.f;
+  if(glm::dot(worldNrm, L) > 0.f)
+  {
+    CpuTraversal::Ray shadowRay;
+    shadowRay.origin    = worldPos;
+    shadowRay.tMin      = 0.001f;
+    shadowRay.direction = L;
+    shadowRay.tMax      = lightDistance;
+    shadowRays++;
+    if(m_traversal.anyHit(shadowRay))
+      attenuation = 0.3f;
+    else
+      specular = computeSpecular(mat, ray.direction, L, worldNrm);
+  }
+
+  return (diffuse + specular) * (lightIntensity * attenuation);
+}
+
+//--------------------------------------------------------------------------------------------------
+// raytrace.rgen, one task per tile of 16x16 pixels
+//
+void CpuRenderer::render(const GlobalUniforms&  uniforms,
+                         const PushConstantRay& pcRay,
+                         uint32_t               width,
+                         uint32_t               height,
+                         ThreadPool&            pool)
+{
+  m_width  = width;
+  m_height = height;
+  m_image.assign(size_t(width) * height, glm::vec4(0.f));
+
+  const uint32_t tilesX = (width + kTileSize - 1) / kTileSize;
+  const uint32_t tilesY = (height + kTileSize - 1) / kTileSize;
+
+  std::atomic<uint64_t> shadowRays{0};
+  auto                  startTime = std::chrono::high_resolution_clock::now();
+  pool.parallelBatches(size_t(tilesX) * tilesY, 1, [&](size_t begin, size_t end) {
+    uint64_t tileShadowRays = 0;
+    for(size_t tile = begin; tile < end; tile++)
+    {
+      const uint32_t x0 = static_cast<uint32_t>(tile % tilesX) * kTileSize;
+      const uint32_t y0 = static_cast<uint32_t>(tile / tilesX) * kTileSize;
+      for(uint32_t y = y0; y < std::min(y0 + kTileSize, height); y++)
+      {
+        for(uint32_t x = x0; x < std::min(x0 + kTileSize, width); x++)
+        {
+          const float     dx     = (x + 0.5f) / width * 2.f - 1.f;
+          const float     dy     = (y + 0.5f) / height * 2.f - 1.f;
+          const glm::vec4 origin = uniforms.viewInverse * glm::vec4(0, 0, 0, 1);
+          const glm::vec4 target = uniforms.projInverse * glm::vec4(dx, dy, 1, 1);
+          const glm::vec3 view   = glm::normalize(glm::vec3(target.x, target.y, target.z));
+          const glm::vec4 dir    = uniforms.viewInverse * glm::vec4(view, 0);
+
+          CpuTraversal::Ray ray;
+          ray.origin    = glm::vec3(origin.x, origin.y, origin.z);
+          ray.tMin      = 0.001f;
+          ray.direction = glm::vec3(dir.x, dir.y, dir.z);
+          ray.tMax      = 10000.f;
+
+          m_image[size_t(y) * width + x] = glm::vec4(shade(ray, pcRay, tileShadowRays), 1.f);
+        }
+      }
+    }
+    shadowRays += tileShadowRays;
+  });
+  auto endTime = std::chrono::high_resolution_clock::now();
+
+  m_stats.renderMs    = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+  m_stats.primaryRays = uint64_t(width) * height;
+  m_stats.shadowRays  = shadowRays;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Binary PPM, with the gamma of post.frag
+//
+bool CpuRenderer::writePpm(const std::string& filename) const
+{
+  FILE* file = fopen(filename.c_str(), "wb");
+  if(file == nullptr)
+  {
+    LOGE("Cannot write %s\n", filename.c_str());
+    return false;
+  }
+  fprintf(file, "P6\n%u %u\n255\n", m_width, m_height);
+  std::vector<uint8_t> row(size_t(m_width) * 3);
+  for(uint32_t y = 0; y < m_height; y++)
+  {
+    for(uint32_t x = 0; x < m_width; x++)
+    {
+      const glm::vec4& c = m_image[size_t(y) * m_width + x];
+      for(int k = 0; k < 3; k++)
+      {
+        float v                = std::pow(std::min(std::max(c[k], 0.f), 1.f), 1.f / 2.2f);
+        row[size_t(x) * 3 + k] = static_cast<uint8_t>(v * 255.f + 0.5f);
+      }
+    }
+    fwrite(row.data(), 1, row.size(), file);
+  }
+  fclose(file);
+  return true;
+}
+
+void CpuRenderer::logStats() const
+{
+  const uint64_t rays = m_stats.primaryRays + m_stats.shadowRays;
+  LOGI("CPU ray tracer: %zu triangles, BVH %.2f ms (%zu 4-wide nodes)\n", m_indices.size() / 3, m_stats.buildMs,
+       m_traversal.nodeCount());
+  LOGI("  %ux%u in %.2f ms: %llu primary + %llu shadow rays, %.2f Mrays/s\n", m_width, m_height, m_stats.renderMs,
+       static_cast<unsigned long long>(m_stats.primaryRays), static_cast<unsigned long long>(m_stats.shadowRays),
+       rays / std::max(m_stats.renderMs * 1000.0, 1e-9));
+}
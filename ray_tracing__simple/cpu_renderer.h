@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "cpu_bvh.h"
+#include "cpu_traversal.h"
+#include "obj_loader.h"
+#include "shaders/host_device.h"
+#include "texture_loader.h"
+
+#include <string>
+
+//--------------------------------------------------------------------------------------------------
+// Headless reference of the ray tracer: raytrace.rgen, .rchit and .rmiss evaluated on the CPU
+// - Instances are flattened to world-space triangles in one CpuBvh, queried with CpuTraversal
+// - Same shading as the closest hit shader: point or infinite light, shadow ray, textures sampled
+//   bilinearly at level 0 as the hit shader does
+// - The image is rendered by tiles on the thread pool and saved after the gamma of post.frag,
+//   to be compared with a capture of the GPU rendering
+//
+class CpuRenderer
+{
+public:
+  // Same as HelloVulkan::loadModel: `textures` are the files of loader.m_textures, sRGB
+  void addModel(const ObjLoader&                loader,
+                const std::vector<TextureMips>& textures,
+                const glm::mat4&                transform = glm::mat4(1));
+  void build(ThreadPool& pool = ThreadPool::global());
+
+  void render(const GlobalUniforms&  uniforms,
+              const PushConstantRay& pcRay,
+              uint32_t               width,
+              uint32_t               height,
+              ThreadPool&            pool = ThreadPool::global());
+  bool writePpm(const std::string& filename) const;
+
+  struct Stats
+  {
+    double   buildMs{0};
+    double   renderMs{0};
+    uint64_t primaryRays{0};
+    uint64_t shadowRays{0};
+  };
+  const Stats& stats() const { return m_stats; }
+  void         logStats() const;
+
+  std::vector<glm::vec4> m_image;  // Linear, as the offscreen image of the ray tracer
+  uint32_t               m_width{0};
+  uint32_t               m_height{0};
+
+private:
+  struct Model
+  {
+    std::vector<VertexObj>   vertices;
+    std::vector<uint32_t>    indices;
+    std::vector<MaterialObj> materials;
+    std::vector<int32_t>     matIndx;
+    uint32_t                 txtOffset{0};
+  };
+  struct Instance
+  {
+    uint32_t  objIndex{0};
+    uint32_t  firstTriangle{0};  // In the flattened triangles
+    glm::mat4 transform{1};
+    glm::mat3 normalMatrix{1};  // Transposed inverse, as `nrm * gl_WorldToObjectEXT`
+  };
+  struct Texture
+  {
+    uint32_t             width{0};
+    uint32_t             height{0};
+    std::vector<uint8_t> rgba;
+  };
+
+  glm::vec3 shade(const CpuTraversal::Ray& ray, const PushConstantRay& pcRay, uint64_t& shadowRays) const;
+  glm::vec3 sample(const Texture& texture, glm::vec2 uv) const;
+
+  std::vector<Model>     m_models;
+  std::vector<Instance>  m_instances;
+  std::vector<Texture>   m_textures;
+  std::vector<glm::vec3> m_positions;  // World space, all instances
+  std::vector<uint32_t>  m_indices;
+  CpuBvh                 m_bvh;
+  CpuTraversal           m_traversal;
+  Stats                  m_stats;
+};
@@ -18,12 +18,14 @@
  */
 
 
+#include <chrono>
 #include <sstream>
 
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "obj_loader.h"
 #include "stb_image.h"
+#include "texture_cache.h"
 
 #include "hello_vulkan.h"
 #include "nvh/alignment.hpp"
@@ -169,13 +171,24 @@ void HelloVulkan::createGraphicsPipeline()
   gpb.depthStencilState.depthTestEnable = true;
   gpb.addShader(nvh::loadFile("spv/vert_shader.vert.spv", true, paths, true), VK_SHADER_STAGE_VERTEX_BIT);
   gpb.addShader(nvh::loadFile("spv/frag_shader.frag.spv", true, paths, true), VK_SHADER_STAGE_FRAGMENT_BIT);
-  gpb.addBindingDescription({0, sizeof(VertexObj)});
+  // Positions and the other attributes are two streams
+#if USE_COMPACT_VERTEX
+  gpb.addBindingDescriptions({{0, sizeof(glm::vec3)}, {1, sizeof(VertexCompactObj)}});
   gpb.addAttributeDescriptions({
-      {0, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(VertexObj, pos))},
-      {1, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(VertexObj, nrm))},
-      {2, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(VertexObj, color))},
-      {3, 0, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(VertexObj, texCoord))},
+      {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0},
+      {1, 1, VK_FORMAT_R16G16_SNORM, static_cast<uint32_t>(offsetof(VertexCompactObj, nrm))},
+      {2, 1, VK_FORMAT_R8G8B8A8_UNORM, static_cast<uint32_t>(offsetof(VertexCompactObj, color))},
+      {3, 1, VK_FORMAT_R16G16_SFLOAT, static_cast<uint32_t>(offsetof(VertexCompactObj, texCoord))},
   });
+#else
+  gpb.addBindingDescriptions({{0, sizeof(glm::vec3)}, {1, sizeof(VertexObj)}});
+  gpb.addAttributeDescriptions({
+      {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0},
+      {1, 1, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(VertexObj, nrm))},
+      {2, 1, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(VertexObj, color))},
+      {3, 1, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(VertexObj, texCoord))},
+  });
+#endif
 
   m_graphicsPipeline = gpb.createPipeline();
   m_debug.setObjectName(m_graphicsPipeline, "Graphics");
@@ -198,6 +211,20 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
     m.specular = glm::pow(m.specular, glm::vec3(2.2f));
   }
 
+  // Textures already loaded by another model (same file or same content) are shared: the material
+  // texture ids become indices in the global array, so the model texture offset is 0
+  std::vector<std::string> textureFiles;
+  for(const auto& texture : loader.m_textures)
+    textureFiles.push_back(nvh::findFile("media/textures/" + texture, defaultSearchPaths, true));
+  std::vector<std::string> newTextures;
+  std::vector<uint32_t>    textureIndices =
+      m_textureRegistry.add(textureFiles, static_cast<uint32_t>(m_textures.size()), newTextures);
+  for(auto& m : loader.m_materials)
+  {
+    if(m.textureID >= 0)
+      m.textureID = static_cast<int>(textureIndices[m.textureID]);
+  }
+
   ObjModel model;
   model.nbIndices  = static_cast<uint32_t>(loader.m_indices.size());
   model.nbVertices = static_cast<uint32_t>(loader.m_vertices.size());
@@ -208,18 +235,30 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
   VkBufferUsageFlags flag            = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
   VkBufferUsageFlags rayTracingFlags =  // used also for building acceleration structures
       flag | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  model.positionBuffer = m_alloc.createBuffer(cmdBuf, loader.m_positions, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | rayTracingFlags);
+#if USE_COMPACT_VERTEX
+  std::vector<VertexCompactObj> attributes;
+  loader.encodeCompactVertices(attributes);
+  model.vertexBuffer = m_alloc.createBuffer(cmdBuf, attributes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | rayTracingFlags);
+#else
   model.vertexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | rayTracingFlags);
+#endif
   model.indexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | rayTracingFlags);
   model.matColorBuffer = m_alloc.createBuffer(cmdBuf, loader.m_materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
-  model.matIndexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_matIndx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
-  // Creates all textures found and find the offset for this model
-  auto txtOffset = static_cast<uint32_t>(m_textures.size());
-  createTextureImages(cmdBuf, loader.m_textures);
+  std::vector<uint32_t> matIndexWords;
+  MatIndexEncoding      matIndexEncoding = loader.encodeMaterialIndices(matIndexWords);
+  model.matIndexBuffer = m_alloc.createBuffer(cmdBuf, matIndexWords, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
+  // Creates the textures not loaded yet
+  if(!newTextures.empty() || m_textures.empty())
+    createTextureImages(cmdBuf, newTextures);
   cmdBufGet.submitAndWait(cmdBuf);
   m_alloc.finalizeAndReleaseStaging();
+  LOGI("Textures: %u unique for %u references, %.2f MB saved\n", m_textureRegistry.uniqueCount(),
+       m_textureRegistry.referenceCount(), m_textureRegistry.savedBytes() / (1024.0 * 1024.0));
 
   std::string objNb = std::to_string(m_objModel.size());
   m_debug.setObjectName(model.vertexBuffer.buffer, (std::string("vertex_" + objNb)));
+  m_debug.setObjectName(model.positionBuffer.buffer, (std::string("position_" + objNb)));
   m_debug.setObjectName(model.indexBuffer.buffer, (std::string("index_" + objNb)));
   m_debug.setObjectName(model.matColorBuffer.buffer, (std::string("mat_" + objNb)));
   m_debug.setObjectName(model.matIndexBuffer.buffer, (std::string("matIdx_" + objNb)));
@@ -232,11 +271,12 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
 
   // Creating information for device access
   ObjDesc desc;
-  desc.txtOffset            = txtOffset;
-  desc.vertexAddress        = nvvk::getBufferDeviceAddress(m_device, model.vertexBuffer.buffer);
-  desc.indexAddress         = nvvk::getBufferDeviceAddress(m_device, model.indexBuffer.buffer);
-  desc.materialAddress      = nvvk::getBufferDeviceAddress(m_device, model.matColorBuffer.buffer);
-  desc.materialIndexAddress = nvvk::getBufferDeviceAddress(m_device, model.matIndexBuffer.buffer);
+  desc.txtOffset             = 0;
+  desc.materialIndexEncoding = static_cast<int>(matIndexEncoding);
+  desc.vertexAddress         = nvvk::getBufferDeviceAddress(m_device, model.vertexBuffer.buffer);
+  desc.indexAddress          = nvvk::getBufferDeviceAddress(m_device, model.indexBuffer.buffer);
+  desc.materialAddress       = nvvk::getBufferDeviceAddress(m_device, model.matColorBuffer.buffer);
+  desc.materialIndexAddress  = nvvk::getBufferDeviceAddress(m_device, model.matIndexBuffer.buffer);
 
   // Keeping the obj host model and device description
   m_objModel.emplace_back(model);
@@ -306,42 +346,100 @@ void HelloVulkan::createTextureImages(const VkCommandBuffer& cmdBuf, const std::
   }
   else
   {
-    // Uploading all images
-    for(const auto& texture : textures)
+    // Block-compressed when the device supports it
+    TextureCache::Format cacheFormat = m_textureFormat;
+    VkFormat             imageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    switch(cacheFormat)
     {
-      std::stringstream o;
-      int               texWidth, texHeight, texChannels;
-      o << "media/textures/" << texture;
-      std::string txtFile = nvh::findFile(o.str(), defaultSearchPaths, true);
-
-      stbi_uc* stbi_pixels = stbi_load(txtFile.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-
-      std::array<stbi_uc, 4> color{255u, 0u, 255u, 255u};
+      case TextureCache::eBC1Srgb:
+        imageFormat = VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+        break;
+      case TextureCache::eBC3Srgb:
+        imageFormat = VK_FORMAT_BC3_SRGB_BLOCK;
+        break;
+      case TextureCache::eBC7Srgb:
+        imageFormat = VK_FORMAT_BC7_SRGB_BLOCK;
+        break;
+      default:
+        break;
+    }
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, imageFormat, &formatProperties);
+    if((formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0)
+    {
+      cacheFormat = TextureCache::eRGBA8Srgb;
+      imageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    }
 
-      stbi_uc* pixels = stbi_pixels;
-      // Handle failure
-      if(!stbi_pixels)
-      {
-        texWidth = texHeight = 1;
-        texChannels          = 4;
-        pixels               = reinterpret_cast<stbi_uc*>(color.data());
-      }
+    // Mapping the pre-baked mip containers (see TextureCache)
+    auto                      start = std::chrono::high_resolution_clock::now();
+    std::vector<TextureCache> caches(textures.size());
+    std::vector<std::string>  missing;
+    size_t                    mappedBytes = 0;
+    for(size_t i = 0; i < textures.size(); i++)
+    {
+      if(caches[i].open(textures[i], cacheFormat))
+        mappedBytes += caches[i].fileSize();
+      else
+        missing.push_back(textures[i]);
+    }
 
-      VkDeviceSize bufferSize      = static_cast<uint64_t>(texWidth) * texHeight * sizeof(uint8_t) * 4;
-      auto         imgSize         = VkExtent2D{(uint32_t)texWidth, (uint32_t)texHeight};
-      auto         imageCreateInfo = nvvk::makeImage2DCreateInfo(imgSize, format, VK_IMAGE_USAGE_SAMPLED_BIT, true);
+    // The others are decoded with their mips in parallel on the CPU, compressed, and baked for the next run
+    std::vector<TextureMips> decoded = TextureLoader::loadAll(missing);
+    uint32_t                 baked   = 0;
+    for(size_t i = 0; i < missing.size(); i++)
+    {
+      if(TextureCache::isCompressed(cacheFormat))
+        BcEncoder::compress(decoded[i], TextureCache::bcFormat(cacheFormat), m_textureQuality);
+      if(decoded[i].loaded && TextureCache::write(missing[i], cacheFormat, decoded[i]))
+        baked++;
+    }
 
+    // Uploading all levels through the staging buffer, submitted with the rest of the model
+    size_t nextDecoded = 0;
+    for(size_t i = 0; i < caches.size(); i++)
+    {
+      const TextureCache& cache = caches[i];
+      const TextureMips*  mips  = cache.levelCount() == 0 ? &decoded[nextDecoded++] : nullptr;
+      if(mips)
+        LOGI("  %s: %ux%u, decode %.2f ms, mips %.2f ms, compress %.2f ms (PSNR %.2f dB)%s\n", textures[i].c_str(),
+             mips->width, mips->height, mips->decodeMs, mips->mipsMs, mips->compressMs, mips->psnr,
+             mips->loaded ? "" : " (not found)");
+
+      const uint32_t nbLevels = mips ? mips->levelCount() : cache.levelCount();
+      const uint32_t width    = mips ? mips->width : cache.width();
+      const uint32_t height   = mips ? mips->height : cache.height();
+
+      auto imgSize              = VkExtent2D{width, height};
+      auto imageCreateInfo      = nvvk::makeImage2DCreateInfo(imgSize, imageFormat, VK_IMAGE_USAGE_SAMPLED_BIT, true);
+      imageCreateInfo.mipLevels = nbLevels;
+
+      nvvk::Image             image = m_alloc.createImage(imageCreateInfo);
+      VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, nbLevels, 0, 1};
+      uint64_t                bytes = 0;
+      nvvk::cmdBarrierImageLayout(cmdBuf, image.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
+      for(uint32_t level = 0; level < nbLevels; level++)
       {
-        nvvk::Image image = m_alloc.createImage(cmdBuf, bufferSize, pixels, imageCreateInfo);
-        nvvk::cmdGenerateMipmaps(cmdBuf, image.image, format, imgSize, imageCreateInfo.mipLevels);
-        VkImageViewCreateInfo ivInfo  = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
-        nvvk::Texture         texture = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
-
-        m_textures.push_back(texture);
+        VkImageSubresourceLayers subresource{VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        VkExtent3D               extent{std::max(width >> level, 1u), std::max(height >> level, 1u), 1};
+        const uint8_t*           data = mips ? mips->data.data() + mips->levelOffsets[level] : cache.levelData(level);
+        size_t                   size = mips ? mips->levelSize(level) : cache.levelSize(level);
+        m_alloc.getStaging()->cmdToImage(cmdBuf, image.image, {0, 0, 0}, extent, subresource, size, data);
+        bytes += size;
       }
+      nvvk::cmdBarrierImageLayout(cmdBuf, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range);
 
-      stbi_image_free(stbi_pixels);
+      VkImageViewCreateInfo ivInfo  = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
+      nvvk::Texture         texture = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
+      m_textureRegistry.setBytes(static_cast<uint32_t>(m_textures.size()), bytes);
+      m_textures.push_back(texture);
     }
+    auto   end    = std::chrono::high_resolution_clock::now();
+    double loadMs = std::chrono::duration<double, std::milli>(end - start).count();
+    LOGI("Textures: %zu mapped (%.2f MB), %zu decoded (%u baked) in %.2f ms\n", caches.size() - missing.size(),
+         mappedBytes / (1024.0 * 1024.0), missing.size(), baked, loadMs);
   }
 }
 
@@ -361,6 +459,7 @@ void HelloVulkan::destroyResources()
   for(auto& m : m_objModel)
   {
     m_alloc.destroy(m.vertexBuffer);
+    m_alloc.destroy(m.positionBuffer);
     m_alloc.destroy(m.indexBuffer);
     m_alloc.destroy(m.matColorBuffer);
     m_alloc.destroy(m.matIndexBuffer);
@@ -384,6 +483,7 @@ void HelloVulkan::destroyResources()
 
   // #VKRay
   m_rtBuilder.destroy();
+  m_blasBuilder.destroy();
   vkDestroyPipeline(m_device, m_rtPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_rtPipelineLayout, nullptr);
   vkDestroyDescriptorPool(m_device, m_rtDescPool, nullptr);
@@ -418,7 +518,9 @@ void HelloVulkan::rasterize(const VkCommandBuffer& cmdBuf)
 
     vkCmdPushConstants(cmdBuf, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
                        sizeof(PushConstantRaster), &m_pcRaster);
-    vkCmdBindVertexBuffers(cmdBuf, 0, 1, &model.vertexBuffer.buffer, &offset);
+    VkBuffer     vertexBuffers[] = {model.positionBuffer.buffer, model.vertexBuffer.buffer};
+    VkDeviceSize offsets[]       = {offset, offset};
+    vkCmdBindVertexBuffers(cmdBuf, 0, 2, vertexBuffers, offsets);
     vkCmdBindIndexBuffer(cmdBuf, model.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
     vkCmdDrawIndexed(cmdBuf, model.nbIndices, 1, 0, 0, 0);
   }
@@ -592,6 +694,7 @@ void HelloVulkan::initRayTracing()
   vkGetPhysicalDeviceProperties2(m_physicalDevice, &prop2);
 
   m_rtBuilder.setup(m_device, &m_alloc, m_graphicsQueueIndex);
+  m_blasBuilder.setup(m_device, &m_alloc, m_graphicsQueueIndex, m_physicalDevice);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -600,16 +703,16 @@ void HelloVulkan::initRayTracing()
 auto HelloVulkan::objectToVkGeometryKHR(const ObjModel& model)
 {
   // BLAS builder requires raw device addresses.
-  VkDeviceAddress vertexAddress = nvvk::getBufferDeviceAddress(m_device, model.vertexBuffer.buffer);
+  VkDeviceAddress vertexAddress = nvvk::getBufferDeviceAddress(m_device, model.positionBuffer.buffer);
   VkDeviceAddress indexAddress  = nvvk::getBufferDeviceAddress(m_device, model.indexBuffer.buffer);
 
   uint32_t maxPrimitiveCount = model.nbIndices / 3;
 
-  // Describe buffer as array of VertexObj.
+  // Describe buffer as array of tightly packed positions.
   VkAccelerationStructureGeometryTrianglesDataKHR triangles{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR};
   triangles.vertexFormat             = VK_FORMAT_R32G32B32_SFLOAT;  // vec3 vertex position data.
   triangles.vertexData.deviceAddress = vertexAddress;
-  triangles.vertexStride             = sizeof(VertexObj);
+  triangles.vertexStride             = sizeof(glm::vec3);
   // Describe index data (32-bit unsigned int)
   triangles.indexType               = VK_INDEX_TYPE_UINT32;
   triangles.indexData.deviceAddress = indexAddress;
@@ -653,7 +756,9 @@ void HelloVulkan::createBottomLevelAS()
     // We could add more geometry in each BLAS, but we add only one for now
     allBlas.emplace_back(blas);
   }
-  m_rtBuilder.buildBlas(allBlas, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+  m_blasBuilder.buildBlas(allBlas, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR
+                                       | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR);
+  m_blasBuilder.logReport();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -668,7 +773,7 @@ void HelloVulkan::createTopLevelAS()
     VkAccelerationStructureInstanceKHR rayInst{};
     rayInst.transform                      = nvvk::toTransformMatrixKHR(inst.transform);  // Position of the instance
     rayInst.instanceCustomIndex            = inst.objIndex;                               // gl_InstanceCustomIndexEXT
-    rayInst.accelerationStructureReference = m_rtBuilder.getBlasDeviceAddress(inst.objIndex);
+    rayInst.accelerationStructureReference = m_blasBuilder.getBlasDeviceAddress(inst.objIndex);
     rayInst.flags                          = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
     rayInst.mask                           = 0xFF;       //  Only be hit if rayMask & instance.mask != 0
     rayInst.instanceShaderBindingTableRecordOffset = 0;  // We will use the same hit group for all objects
@@ -24,7 +24,10 @@
 #include "nvvk/descriptorsets_vk.hpp"
 #include "nvvk/memallocator_dma_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
+#include "blas_builder.h"
 #include "shaders/host_device.h"
+#include "texture_cache.h"
+#include "texture_registry.h"
 
 // #VKRay
 #include "nvvk/raytraceKHR_vk.hpp"
@@ -57,10 +60,11 @@ public:
   {
     uint32_t     nbIndices{0};
     uint32_t     nbVertices{0};
-    nvvk::Buffer vertexBuffer;    // Device buffer of all 'Vertex'
+    nvvk::Buffer vertexBuffer;    // Device buffer of all 'Vertex' (or 'VertexCompact')
+    nvvk::Buffer positionBuffer;  // Device buffer of the tightly packed positions (BLAS and raster stream 0)
     nvvk::Buffer indexBuffer;     // Device buffer of the indices forming triangles
     nvvk::Buffer matColorBuffer;  // Device buffer of array of 'Wavefront material'
-    nvvk::Buffer matIndexBuffer;  // Device buffer of array of 'Wavefront material'
+    nvvk::Buffer matIndexBuffer;  // Device buffer of the packed material index of each triangle (MATINDEX_*)
   };
 
   struct ObjInstance
@@ -96,7 +100,12 @@ public:
   nvvk::Buffer m_bGlobals;  // Device-Host of the camera matrices
   nvvk::Buffer m_bObjDesc;  // Device buffer of the OBJ descriptions
 
-  std::vector<nvvk::Texture> m_textures;  // vector of all textures of the scene
+  std::vector<nvvk::Texture> m_textures;         // vector of all textures of the scene
+  TextureRegistry            m_textureRegistry;  // Index in m_textures of each loaded image
+
+  // Texture format when baking and uploading; RGBA8 is used when the device cannot sample it
+  TextureCache::Format m_textureFormat{TextureCache::eBC7Srgb};
+  BcEncoder::Quality   m_textureQuality{BcEncoder::Quality::eNormal};
 
 
   nvvk::ResourceAllocatorDma m_alloc;  // Allocator for buffer, images, acceleration structures
@@ -137,6 +146,7 @@ public:
 
   VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_rtProperties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR};
   nvvk::RaytracingBuilderKHR                        m_rtBuilder;
+  BlasBuilder                                       m_blasBuilder;  // BLAS, compacted; m_rtBuilder has the TLAS
   nvvk::DescriptorSetBindings                       m_rtDescSetLayoutBind;
   VkDescriptorPool                                  m_rtDescPool;
   VkDescriptorSetLayout                             m_rtDescSetLayout;
@@ -38,6 +38,10 @@
 #include "backends/imgui_impl_vulkan.h"
 #include "nvvk/commands_vk.hpp"
 #include "nvvk/context_vk.hpp"
+#include "cpu_bvh.h"
+#include "cpu_renderer.h"
+#include "obj_loader.h"
+#include "texture_cache.h"
 #include <imgui/imgui_helper.h>
 
 
@@ -82,8 +86,6 @@ static int const SAMPLE_HEIGHT = 720;
 //
 int main(int argc, char** argv)
 {
-  UNUSED(argc);
-
   // Setup GLFW window
   glfwSetErrorCallback(onErrorCallback);
   if(!glfwInit())
@@ -115,6 +117,81 @@ int main(int argc, char** argv)
       std::string(PROJECT_NAME),
   };
 
+  // Offline conversion of the scene textures to mip containers (TextureCache), then exit
+  if(argc > 1 && std::string(argv[1]) == "--bake-textures")
+  {
+    uint32_t baked = 0;
+    for(const char* scene : {"media/scenes/Medieval_building.obj", "media/scenes/plane.obj"})
+    {
+      ObjLoader loader;
+      loader.loadModel(nvh::findFile(scene, defaultSearchPaths, true));
+      std::vector<std::string> filenames;
+      for(const auto& texture : loader.m_textures)
+        filenames.push_back(nvh::findFile("media/textures/" + texture, defaultSearchPaths, true));
+      baked += TextureCache::bake(filenames, TextureCache::eBC7Srgb, BcEncoder::Quality::eHigh, true);
+    }
+    LOGI("Baked %u texture containers\n", baked);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+  }
+
+  // CPU BVH (CpuBvh) of each bundled scene, reporting the build throughput and quality, then exit
+  if(argc > 1 && std::string(argv[1]) == "--cpu-bvh")
+  {
+    for(const char* scene : {"media/scenes/Medieval_building.obj", "media/scenes/plane.obj", "media/scenes/wuson.obj",
+                             "media/scenes/sphere.obj", "media/scenes/cube.obj", "media/scenes/cube_multi.obj"})
+    {
+      ObjLoader loader;
+      loader.loadModel(nvh::findFile(scene, defaultSearchPaths, true));
+      CpuBvh bvh;
+      bvh.build(loader.m_positions, loader.m_indices);
+      bvh.logStats(scene);
+    }
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+  }
+
+  // Scene of the sample ray traced on the CPU (CpuRenderer) with the default camera and light,
+  // saved to a PPM to compare with the GPU rendering, then exit
+  if(argc > 1 && std::string(argv[1]) == "--cpu-render")
+  {
+    CpuRenderer renderer;
+    for(const char* scene : {"media/scenes/Medieval_building.obj", "media/scenes/plane.obj"})
+    {
+      ObjLoader loader;
+      loader.loadModel(nvh::findFile(scene, defaultSearchPaths, true));
+      std::vector<std::string> filenames;
+      for(const auto& texture : loader.m_textures)
+        filenames.push_back(nvh::findFile("media/textures/" + texture, defaultSearchPaths, true));
+      renderer.addModel(loader, TextureLoader::loadAll(filenames));
+    }
+    renderer.build();
+
+    // As HelloVulkan::updateUniformBuffer and the defaults of HelloVulkan::m_pcRaster
+    const float    aspectRatio = SAMPLE_WIDTH / static_cast<float>(SAMPLE_HEIGHT);
+    GlobalUniforms uniforms{};
+    const auto&    view = CameraManip.getMatrix();
+    glm::mat4      proj = glm::perspectiveRH_ZO(glm::radians(CameraManip.getFov()), aspectRatio, 0.1f, 1000.0f);
+    proj[1][1] *= -1;
+    uniforms.viewInverse = glm::inverse(view);
+    uniforms.projInverse = glm::inverse(proj);
+
+    PushConstantRay pcRay{};
+    pcRay.clearColor     = glm::vec4(1, 1, 1, 1);
+    pcRay.lightPosition  = glm::vec3(10.f, 15.f, 8.f);
+    pcRay.lightIntensity = 100.f;
+    pcRay.lightType      = 0;
+
+    renderer.render(uniforms, pcRay, SAMPLE_WIDTH, SAMPLE_HEIGHT);
+    renderer.logStats();
+    renderer.writePpm(argc > 2 ? argv[2] : "cpu_render.ppm");
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+  }
+
   // Vulkan required extensions
   assert(glfwVulkanSupported() == 1);
   uint32_t count{0};
@@ -27,6 +27,7 @@
 #extension GL_EXT_buffer_reference2 : require
 
 #include "wavefront.glsl"
+#include "matindex.glsl"
 
 
 layout(push_constant) uniform _PushConstantRaster
@@ -46,7 +47,6 @@ layout(location = 0) out vec4 o_color;
 layout(buffer_reference, scalar) buffer Vertices {Vertex v[]; }; // Positions of an object
 layout(buffer_reference, scalar) buffer Indices {uint i[]; }; // Triangle indices
 layout(buffer_reference, scalar) buffer Materials {WaveFrontMaterial m[]; }; // Array of all materials on an object
-layout(buffer_reference, scalar) buffer MatIndices {int i[]; }; // Material ID for each triangle
 
 layout(binding = eObjDescs, scalar) buffer ObjDesc_ { ObjDesc i[]; } objDesc;
 layout(binding = eTextures) uniform sampler2D[] textureSamplers;
@@ -57,10 +57,9 @@ void main()
 {
   // Material of the object
   ObjDesc    objResource = objDesc.i[pcRaster.objIndex];
-  MatIndices matIndices  = MatIndices(objResource.materialIndexAddress);
   Materials  materials   = Materials(objResource.materialAddress);
 
-  int               matIndex = matIndices.i[gl_PrimitiveID];
+  int               matIndex = materialIndex(objResource, gl_PrimitiveID);
   WaveFrontMaterial mat      = materials.m[matIndex];
 
   vec3 N = normalize(i_worldNrm);
@@ -31,6 +31,18 @@ using mat4 = glm::mat4;
 using uint = unsigned int;
 #endif
 
+// Set to 1 to store vertices as a position stream and compact attributes (VertexCompact) on the device
+#ifndef USE_COMPACT_VERTEX
+#define USE_COMPACT_VERTEX 0
+#endif
+
+// Encoding of ObjDesc::materialIndexAddress, see ObjLoader::encodeMaterialIndices and matindex.glsl
+// NOTE: must match MatIndexEncoding in obj_loader.h
+#define MATINDEX_8BIT 0
+#define MATINDEX_16BIT 1
+#define MATINDEX_32BIT 2
+#define MATINDEX_RUNS 3
+
 // clang-format off
 #ifdef __cplusplus // Descriptor binding helper for C++ and GLSL
  #define START_BINDING(a) enum a {
@@ -56,11 +68,12 @@ END_BINDING();
 // Information of a obj model when referenced in a shader
 struct ObjDesc
 {
-  int      txtOffset;             // Texture index offset in the array of textures
-  uint64_t vertexAddress;         // Address of the Vertex buffer
-  uint64_t indexAddress;          // Address of the index buffer
-  uint64_t materialAddress;       // Address of the material buffer
-  uint64_t materialIndexAddress;  // Address of the triangle material index buffer
+  int      txtOffset;              // Texture index offset in the array of textures
+  int      materialIndexEncoding;  // MATINDEX_* encoding of the material index buffer
+  uint64_t vertexAddress;          // Address of the Vertex buffer
+  uint64_t indexAddress;           // Address of the index buffer
+  uint64_t materialAddress;        // Address of the material buffer
+  uint64_t materialIndexAddress;   // Address of the triangle material index buffer
 };
 
 // Uniform buffer set at each frame
@@ -99,6 +112,13 @@ struct Vertex  // See ObjLoader, copy of VertexObj, could be compressed for devi
   vec2 texCoord;
 };
 
+struct VertexCompact  // See ObjLoader::encodeCompactVertices, decoded by wavefront.glsl
+{
+  uint nrm;       // Octahedral encoded normal, 2 x snorm16
+  uint texCoord;  // 2 x half float
+  uint color;     // RGBA8 unorm
+};
+
 struct WaveFrontMaterial  // See ObjLoader, copy of MaterialObj, could be compressed for device
 {
   vec3  ambient;
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2019-2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Material index of a triangle, packed by ObjLoader::encodeMaterialIndices (MATINDEX_*)
+// Requires GL_EXT_buffer_reference2, GL_EXT_scalar_block_layout and 64-bit integers
+
+#include "host_device.h"
+
+layout(buffer_reference, scalar) readonly buffer MatIndexWords {uint w[]; };
+
+int materialIndex(ObjDesc objResource, int primitiveId)
+{
+  MatIndexWords words    = MatIndexWords(objResource.materialIndexAddress);
+  uint          triangle = uint(primitiveId);
+  switch(objResource.materialIndexEncoding)
+  {
+    case MATINDEX_8BIT:
+      return int(bitfieldExtract(words.w[triangle >> 2], int(triangle & 3) * 8, 8));
+    case MATINDEX_16BIT:
+      return int(bitfieldExtract(words.w[triangle >> 1], int(triangle & 1) * 16, 16));
+    case MATINDEX_RUNS: {
+      // w[0]: number of runs, then the first triangle of each run, then the material of each run.
+      // Last run starting at or before the triangle.
+      uint count = words.w[0];
+      uint lo    = 0;
+      uint hi    = count;
+      while(hi - lo > 1)
+      {
+        uint mid = (lo + hi) / 2;
+        if(words.w[1 + mid] <= triangle)
+          lo = mid;
+        else
+          hi = mid;
+      }
+      return int(words.w[1 + count + lo]);
+    }
+  }
+  return int(words.w[triangle]);
+}
@@ -37,8 +37,13 @@ layout(push_constant) uniform _PushConstantRaster
 };
 
 layout(location = 0) in vec3 i_position;
+#if USE_COMPACT_VERTEX
+layout(location = 1) in vec2 i_normal;  // Octahedral, fetched as R16G16_SNORM
+layout(location = 2) in vec4 i_color;
+#else
 layout(location = 1) in vec3 i_normal;
 layout(location = 2) in vec3 i_color;
+#endif
 layout(location = 3) in vec2 i_texCoord;
 
 
@@ -60,7 +65,11 @@ void main()
   o_worldPos = vec3(pcRaster.modelMatrix * vec4(i_position, 1.0));
   o_viewDir  = vec3(o_worldPos - origin);
   o_texCoord = i_texCoord;
+#if USE_COMPACT_VERTEX
+  o_worldNrm = mat3(pcRaster.modelMatrix) * octDecode(i_normal);
+#else
   o_worldNrm = mat3(pcRaster.modelMatrix) * i_normal;
+#endif
 
   gl_Position = uni.viewProj * vec4(o_worldPos, 1.0);
 }
@@ -46,3 +46,27 @@ vec3 computeSpecular(WaveFrontMaterial mat, vec3 viewDir, vec3 lightDir, vec3 no
 
   return vec3(mat.specular * specular);
 }
+
+// Decoding of VertexCompact, see ObjLoader::encodeCompactVertices
+vec3 octDecode(vec2 e)
+{
+  vec3 n = vec3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+  if(n.z < 0.0)
+    n.xy = (1.0 - abs(n.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+  return normalize(n);
+}
+
+vec3 decodeNormal(uint nrm)
+{
+  return octDecode(unpackSnorm2x16(nrm));
+}
+
+vec2 decodeTexCoord(uint texCoord)
+{
+  return unpackHalf2x16(texCoord);
+}
+
+vec3 decodeColor(uint color)
+{
+  return unpackUnorm4x8(color).rgb;
+}
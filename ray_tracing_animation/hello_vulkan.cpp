@@ -18,6 +18,9 @@
  */
 
 
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
 #include <sstream>
 
 
@@ -39,6 +42,13 @@
 
 extern std::vector<std::string> defaultSearchPaths;
 
+// The animated sphere: model, instance and BLAS index
+static const uint32_t kSphereModel = 2;
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
 
 //--------------------------------------------------------------------------------------------------
 // Keep the handle on the device
@@ -202,6 +212,16 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
   ObjModel model;
   model.nbIndices  = static_cast<uint32_t>(loader.m_indices.size());
   model.nbVertices = static_cast<uint32_t>(loader.m_vertices.size());
+  model.indices    = loader.m_indices;
+  model.positions.reserve(loader.m_vertices.size());
+  model.bmin = glm::vec3(FLT_MAX);
+  model.bmax = glm::vec3(-FLT_MAX);
+  for(const auto& v : loader.m_vertices)
+  {
+    model.positions.push_back(v.pos);
+    model.bmin = glm::min(model.bmin, v.pos);
+    model.bmax = glm::max(model.bmax, v.pos);
+  }
 
   // Create the buffers on Device and copy vertices, indices and materials
   nvvk::CommandPool  cmdBufGet(m_device, m_graphicsQueueIndex);
@@ -661,8 +681,13 @@ void HelloVulkan::createBottomLevelAS()
     // We could add more geometry in each BLAS, but we add only one for now
     m_blas.push_back(blas);
   }
-  m_rtBuilder.buildBlas(m_blas, VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR
-                                    | VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR);
+  m_blasFlags =
+      VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR;
+  m_rtBuilder.buildBlas(m_blas, m_blasFlags);
+
+  // Only the sphere BLAS is deformed, the others are never updated
+  m_spherePolicy = m_refitPolicy.add("sphere BLAS");
+  m_refitPolicy.built(m_spherePolicy, triangleBoxes(m_objModel[kSphereModel]));
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -684,6 +709,9 @@ void HelloVulkan::createTopLevelAS()
 
   m_rtFlags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
   m_rtBuilder.buildTlas(m_tlas, m_rtFlags);
+
+  m_tlasPolicy = m_refitPolicy.add("TLAS");
+  m_refitPolicy.built(m_tlasPolicy, instanceBoxes());
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -894,8 +922,8 @@ void HelloVulkan::animationInstances(float time)
     tinst.transform                           = nvvk::toTransformMatrixKHR(transform);
   }
 
-  // Updating the top level acceleration structure
-  m_rtBuilder.buildTlas(m_tlas, m_rtFlags, true);
+  // The top level acceleration structure is updated in updateAccelerationStructures()
+  m_refitPolicy.update(m_tlasPolicy, instanceBoxes());
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -903,8 +931,7 @@ void HelloVulkan::animationInstances(float time)
 //
 void HelloVulkan::animationObject(float time)
 {
-  const uint32_t sphereId = 2;
-  ObjModel&      model    = m_objModel[sphereId];
+  ObjModel& model = m_objModel[kSphereModel];
 
   updateCompDescriptors(model.vertexBuffer);
 
@@ -917,8 +944,98 @@ void HelloVulkan::animationObject(float time)
   vkCmdDispatch(cmdBuf, model.nbVertices, 1, 1);
 
   genCmdBuf.submitAndWait(cmdBuf);
-  m_rtBuilder.updateBlas(sphereId, m_blas[sphereId],
-                         VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR);
+
+  // Same displacement as anim.comp on the host copy, for the bounds of the refit policy. The BLAS is
+  // updated in updateAccelerationStructures()
+  const float PI = 3.14159265f;
+  for(auto& pos : model.positions)
+  {
+    const float signY  = (pos.y >= 0 ? 1.f : -1.f);
+    const float radius = sqrtf(pos.x * pos.x + pos.z * pos.z);
+    pos.y              = signY * fabsf(sinf(time * 4.f + radius * PI)) * 0.5f;
+  }
+  m_refitPolicy.update(m_spherePolicy, triangleBoxes(model));
+}
+
+//--------------------------------------------------------------------------------------------------
+// Called after the animations: each structure is either refitted, keeping the topology of its last
+// build, or rebuilt in place when the policy finds that its quality degraded too much
+//
+void HelloVulkan::updateAccelerationStructures()
+{
+  const std::vector<uint32_t> rebuilds = m_refitPolicy.select();
+  auto toRebuild = [&](uint32_t id) { return std::find(rebuilds.begin(), rebuilds.end(), id) != rebuilds.end(); };
+
+  // The BLAS first, the TLAS build reads it
+  auto start = std::chrono::high_resolution_clock::now();
+  if(toRebuild(m_spherePolicy))
+  {
+    m_rtBuilder.rebuildBlas(kSphereModel, m_blas[kSphereModel], m_blasFlags);
+    m_refitPolicy.rebuilt(m_spherePolicy, elapsedMs(start));
+  }
+  else
+  {
+    m_rtBuilder.updateBlas(kSphereModel, m_blas[kSphereModel], m_blasFlags);
+    m_refitPolicy.refitted(m_spherePolicy, elapsedMs(start));
+  }
+
+  start = std::chrono::high_resolution_clock::now();
+  if(toRebuild(m_tlasPolicy))
+  {
+    m_rtBuilder.rebuildTlas(m_tlas, m_rtFlags);
+    m_refitPolicy.rebuilt(m_tlasPolicy, elapsedMs(start));
+  }
+  else
+  {
+    m_rtBuilder.buildTlas(m_tlas, m_rtFlags, true);
+    m_refitPolicy.refitted(m_tlasPolicy, elapsedMs(start));
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// World-space boxes of the instances, from the model bounds and the transforms of m_tlas
+//
+std::vector<RefitPolicy::Aabb> HelloVulkan::instanceBoxes() const
+{
+  std::vector<RefitPolicy::Aabb> boxes(m_tlas.size());
+  for(size_t i = 0; i < m_tlas.size(); i++)
+  {
+    const ObjModel& model  = m_objModel[m_instances[i].objIndex];
+    const auto&     matrix = m_tlas[i].transform.matrix;  // 3x4, row major
+    const glm::vec3 center = (model.bmin + model.bmax) * 0.5f;
+    const glm::vec3 extent = (model.bmax - model.bmin) * 0.5f;
+    for(int r = 0; r < 3; r++)
+    {
+      // Center transformed, extent projected on the absolute matrix
+      float c = matrix[r][3];
+      float e = 0.f;
+      for(int k = 0; k < 3; k++)
+      {
+        c += matrix[r][k] * center[k];
+        e += fabsf(matrix[r][k]) * extent[k];
+      }
+      boxes[i].bmin[r] = c - e;
+      boxes[i].bmax[r] = c + e;
+    }
+  }
+  return boxes;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Object-space boxes of the triangles, from the host copy of the positions
+//
+std::vector<RefitPolicy::Aabb> HelloVulkan::triangleBoxes(const ObjModel& model) const
+{
+  std::vector<RefitPolicy::Aabb> boxes(model.indices.size() / 3);
+  for(size_t t = 0; t < boxes.size(); t++)
+  {
+    const glm::vec3& a = model.positions[model.indices[t * 3 + 0]];
+    const glm::vec3& b = model.positions[model.indices[t * 3 + 1]];
+    const glm::vec3& c = model.positions[model.indices[t * 3 + 2]];
+    boxes[t].bmin      = glm::min(a, glm::min(b, c));
+    boxes[t].bmax      = glm::max(a, glm::max(b, c));
+  }
+  return boxes;
 }
 
 //////////////////////////////////////////////////////////////////////////
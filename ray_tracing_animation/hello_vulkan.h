@@ -29,6 +29,8 @@
 // #VKRay
 #include "nvvk/raytraceKHR_vk.hpp"
 #include "nvvk/sbtwrapper_vk.hpp"
+#include "refit_builder.h"
+#include "refit_policy.h"
 
 //--------------------------------------------------------------------------------------------------
 // Simple rasterizer of OBJ objects
@@ -62,6 +64,12 @@ public:
     nvvk::Buffer indexBuffer;     // Device buffer of the indices forming triangles
     nvvk::Buffer matColorBuffer;  // Device buffer of array of 'Wavefront material'
     nvvk::Buffer matIndexBuffer;  // Device buffer of array of 'Wavefront material'
+
+    // Host copies, for the bounds given to the refit policy
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t>  indices;
+    glm::vec3              bmin{0.f};  // Object-space bounds of the loaded vertices
+    glm::vec3              bmax{0.f};
   };
 
   struct ObjInstance
@@ -136,7 +144,7 @@ public:
 
 
   VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_rtProperties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR};
-  nvvk::RaytracingBuilderKHR                        m_rtBuilder;
+  RefitBuilder                                      m_rtBuilder;
   nvvk::DescriptorSetBindings                       m_rtDescSetLayoutBind;
   VkDescriptorPool                                  m_rtDescPool;
   VkDescriptorSetLayout                             m_rtDescSetLayout;
@@ -155,6 +163,14 @@ public:
   // #VK_animation
   void animationInstances(float time);
   void animationObject(float time);
+  // Refits or rebuilds the sphere BLAS and the TLAS, as chosen by m_refitPolicy
+  void updateAccelerationStructures();
+  std::vector<RefitPolicy::Aabb> instanceBoxes() const;
+  std::vector<RefitPolicy::Aabb> triangleBoxes(const ObjModel& model) const;
+
+  RefitPolicy m_refitPolicy;
+  uint32_t    m_tlasPolicy{0};    // Ids in m_refitPolicy
+  uint32_t    m_spherePolicy{0};
 
   // #VK_compute
   void createCompDescriptors();
@@ -169,4 +185,5 @@ public:
   VkPipelineLayout            m_compPipelineLayout;
 
   VkBuildAccelerationStructureFlagsKHR m_rtFlags;
+  VkBuildAccelerationStructureFlagsKHR m_blasFlags;
 };
@@ -66,6 +66,34 @@ void renderUI(HelloVulkan& helloVk)
     ImGui::SliderFloat3("Position", &helloVk.m_pcRaster.lightPosition.x, -20.f, 20.f);
     ImGui::SliderFloat("Intensity", &helloVk.m_pcRaster.lightIntensity, 0.f, 150.f);
   }
+  if(ImGui::CollapsingHeader("Refit / rebuild"))
+  {
+    RefitPolicy& policy = helloVk.m_refitPolicy;
+    int          mode   = policy.m_mode;
+    int          refits = static_cast<int>(policy.m_maxRefits);
+    int          budget = static_cast<int>(policy.m_rebuildsPerFrame);
+    if(ImGui::Combo("Mode", &mode, "Adaptive\0Always refit\0Always rebuild\0"))
+      policy.m_mode = static_cast<RefitPolicy::Mode>(mode);
+    ImGui::SliderFloat("Max growth", &policy.m_maxGrowth, 1.f, 4.f);
+    if(ImGui::SliderInt("Max refits", &refits, 0, 300))  // 0: no limit
+      policy.m_maxRefits = static_cast<uint32_t>(refits);
+    if(ImGui::SliderInt("Rebuilds / frame", &budget, 0, 2))  // 0: no limit
+      policy.m_rebuildsPerFrame = static_cast<uint32_t>(budget);
+
+    for(uint32_t id = 0; id < policy.count(); id++)
+    {
+      const RefitPolicy::Stats& st = policy.stats(id);
+      ImGui::Text("%s: growth %.2f (peak %.2f), %u refits, %u rebuilds", st.name.c_str(), st.growth, st.peakGrowth,
+                  st.refits, st.rebuilds);
+      ImGui::Text("  refit %.3f ms, rebuild %.3f ms", st.refits > 0 ? st.refitMs / st.refits : 0.0,
+                  st.rebuilds > 0 ? st.rebuildMs / st.rebuilds : 0.0);
+    }
+    if(ImGui::Button("Reset stats"))
+      policy.resetStats();
+    ImGui::SameLine();
+    if(ImGui::Button("Log stats"))
+      policy.logStats();
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -80,8 +108,6 @@ static int const SAMPLE_HEIGHT = 720;
 //
 int main(int argc, char** argv)
 {
-  UNUSED(argc);
-
   // Setup GLFW window
   glfwSetErrorCallback(onErrorCallback);
   if(!glfwInit())
@@ -193,6 +219,38 @@ int main(int argc, char** argv)
   helloVk.createCompDescriptors();
   helloVk.createCompPipelines();
 
+  // Same animation in each refit policy mode at a fixed time step, logs the stats, then exit
+  if(argc > 1 && std::string(argv[1]) == "--refit-bench")
+  {
+    const uint32_t          frames = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 600u;
+    const RefitPolicy::Mode modes[] = {RefitPolicy::eAlwaysRefit, RefitPolicy::eAdaptive, RefitPolicy::eAlwaysRebuild};
+    for(RefitPolicy::Mode mode : modes)
+    {
+      // Starting from a rebuild at time 0, so that every mode sees the same frames
+      helloVk.m_refitPolicy.m_mode = RefitPolicy::eAlwaysRebuild;
+      helloVk.animationObject(0.f);
+      helloVk.animationInstances(0.f);
+      helloVk.updateAccelerationStructures();
+
+      helloVk.m_refitPolicy.m_mode = mode;
+      helloVk.m_refitPolicy.resetStats();
+      for(uint32_t f = 1; f <= frames; f++)
+      {
+        const float time = static_cast<float>(f) / 60.f;
+        helloVk.animationObject(time);
+        helloVk.animationInstances(time);
+        helloVk.updateAccelerationStructures();
+      }
+      helloVk.m_refitPolicy.logStats();
+    }
+    vkDeviceWaitIdle(helloVk.getDevice());
+    helloVk.destroyResources();
+    helloVk.destroy();
+    vkctx.deinit();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+  }
 
   glm::vec4 clearColor   = glm::vec4(1, 1, 1, 1.00f);
   bool      useRaytracer = true;
@@ -231,6 +289,7 @@ int main(int argc, char** argv)
     std::chrono::duration<float> diff = std::chrono::system_clock::now() - start;
     helloVk.animationObject(diff.count());
     helloVk.animationInstances(diff.count());
+    helloVk.updateAccelerationStructures();
 
     // Start rendering the scene
     helloVk.prepareFrame();
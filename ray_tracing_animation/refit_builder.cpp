@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "refit_builder.h"
+
+#include <cassert>
+
+
+void RefitBuilder::rebuildBlas(uint32_t blasIdx, BlasInput& blas, VkBuildAccelerationStructureFlagsKHR flags)
+{
+  assert(size_t(blasIdx) < m_blas.size());
+
+  VkAccelerationStructureBuildGeometryInfoKHR buildInfo{};
+  buildInfo.sType                    = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+  buildInfo.flags                    = flags;
+  buildInfo.geometryCount            = static_cast<uint32_t>(blas.asGeometry.size());
+  buildInfo.pGeometries              = blas.asGeometry.data();
+  buildInfo.mode                     = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;  // Not UPDATE: no source
+  buildInfo.type                     = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+  buildInfo.dstAccelerationStructure = m_blas[blasIdx].accel;
+
+  std::vector<uint32_t>                                        maxPrimCount(blas.asBuildOffsetInfo.size());
+  std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> ranges(blas.asBuildOffsetInfo.size());
+  for(size_t i = 0; i < blas.asBuildOffsetInfo.size(); i++)
+  {
+    maxPrimCount[i] = blas.asBuildOffsetInfo[i].primitiveCount;
+    ranges[i]       = &blas.asBuildOffsetInfo[i];
+  }
+  nvvk::CommandPool genCmdBuf(m_device, m_queueIndex);
+  buildInPlace(genCmdBuf, genCmdBuf.createCommandBuffer(), buildInfo, ranges.data(), maxPrimCount);
+}
+
+void RefitBuilder::rebuildTlas(const std::vector<VkAccelerationStructureInstanceKHR>& instances,
+                               VkBuildAccelerationStructureFlagsKHR                   flags)
+{
+  nvvk::CommandPool genCmdBuf(m_device, m_queueIndex);
+  VkCommandBuffer   cmdBuf = genCmdBuf.createCommandBuffer();
+
+  // Instances uploaded as in buildTlas()
+  nvvk::Buffer instancesBuffer =
+      m_alloc->createBuffer(cmdBuf, instances,
+                            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+                                | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+  VkBufferDeviceAddressInfo bufferInfo{VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, nullptr, instancesBuffer.buffer};
+  VkMemoryBarrier           barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  VkAccelerationStructureGeometryInstancesDataKHR instancesVk{};
+  instancesVk.sType              = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+  instancesVk.data.deviceAddress = vkGetBufferDeviceAddress(m_device, &bufferInfo);
+  VkAccelerationStructureGeometryKHR topASGeometry{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR};
+  topASGeometry.geometryType       = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+  topASGeometry.geometry.instances = instancesVk;
+
+  VkAccelerationStructureBuildGeometryInfoKHR buildInfo{};
+  buildInfo.sType                    = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+  buildInfo.flags                    = flags;
+  buildInfo.geometryCount            = 1;
+  buildInfo.pGeometries              = &topASGeometry;
+  buildInfo.mode                     = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+  buildInfo.type                     = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+  buildInfo.dstAccelerationStructure = m_tlas.accel;
+
+  const uint32_t                                  countInstance = static_cast<uint32_t>(instances.size());
+  VkAccelerationStructureBuildRangeInfoKHR        range{countInstance, 0, 0, 0};
+  const VkAccelerationStructureBuildRangeInfoKHR* ranges = &range;
+  buildInPlace(genCmdBuf, cmdBuf, buildInfo, &ranges, {countInstance});
+
+  m_alloc->finalizeAndReleaseStaging();
+  m_alloc->destroy(instancesBuffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Adds the build to the command buffer, submits it and waits, then releases the scratch buffer
+//
+void RefitBuilder::buildInPlace(nvvk::CommandPool&                                    cmdPool,
+                                VkCommandBuffer                                       cmdBuf,
+                                VkAccelerationStructureBuildGeometryInfoKHR&          buildInfo,
+                                const VkAccelerationStructureBuildRangeInfoKHR* const* ranges,
+                                const std::vector<uint32_t>&                          maxPrimCount)
+{
+  VkAccelerationStructureBuildSizesInfoKHR sizeInfo{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR};
+  vkGetAccelerationStructureBuildSizesKHR(m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo,
+                                          maxPrimCount.data(), &sizeInfo);
+
+  nvvk::Buffer scratchBuffer = m_alloc->createBuffer(
+      sizeInfo.buildScratchSize, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  VkBufferDeviceAddressInfo bufferInfo{VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, nullptr, scratchBuffer.buffer};
+  buildInfo.scratchData.deviceAddress = vkGetBufferDeviceAddress(m_device, &bufferInfo);
+
+  vkCmdBuildAccelerationStructuresKHR(cmdBuf, 1, &buildInfo, ranges);
+  cmdPool.submitAndWait(cmdBuf);
+  m_alloc->destroy(scratchBuffer);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "nvvk/commands_vk.hpp"
+#include "nvvk/raytraceKHR_vk.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// RaytracingBuilderKHR that can also rebuild a BLAS or the TLAS in place. updateBlas() and
+// buildTlas(..., true) only refit: the topology of the first build is kept. A rebuild with the same
+// inputs and flags fits in the existing acceleration structure, so its handle, its address and the
+// descriptors referencing it stay valid.
+//
+class RefitBuilder : public nvvk::RaytracingBuilderKHR
+{
+public:
+  // Same arguments as updateBlas()
+  void rebuildBlas(uint32_t blasIdx, BlasInput& blas, VkBuildAccelerationStructureFlagsKHR flags);
+  // Same instance count and flags as the first buildTlas()
+  void rebuildTlas(const std::vector<VkAccelerationStructureInstanceKHR>& instances,
+                   VkBuildAccelerationStructureFlagsKHR                   flags);
+
+private:
+  void buildInPlace(nvvk::CommandPool&                                    cmdPool,
+                    VkCommandBuffer                                       cmdBuf,
+                    VkAccelerationStructureBuildGeometryInfoKHR&          buildInfo,
+                    const VkAccelerationStructureBuildRangeInfoKHR* const* ranges,
+                    const std::vector<uint32_t>&                          maxPrimCount);
+};
@@ -0,0 +1,503 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "glb_import.h"
+#include "nvh/nvprint.hpp"
+#include "stb_image.h"
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <unordered_map>
+
+namespace {
+const char* kAttributeNames[3] = {"POSITION", "NORMAL", "TEXCOORD_0"};
+
+size_t elementSize(GlbImport::Attribute attribute)
+{
+  if(attribute == GlbImport::eTexcoords)
+    return 2 * sizeof(float);
+  return attribute == GlbImport::eIndices ? sizeof(uint32_t) : 3 * sizeof(float);
+}
+
+// Node transformation, from the matrix or the translation, rotation and scale
+glm::mat4 localMatrix(const tinygltf::Node& node)
+{
+  glm::mat4 m(1);
+  if(node.matrix.size() == 16)
+  {
+    for(int c = 0; c < 4; c++)
+      for(int r = 0; r < 4; r++)
+        m[c][r] = static_cast<float>(node.matrix[c * 4 + r]);
+    return m;
+  }
+
+  float x = 0, y = 0, z = 0, w = 1;
+  if(node.rotation.size() == 4)
+  {
+    x = static_cast<float>(node.rotation[0]);
+    y = static_cast<float>(node.rotation[1]);
+    z = static_cast<float>(node.rotation[2]);
+    w = static_cast<float>(node.rotation[3]);
+  }
+  m[0] = glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + w * z), 2 * (x * z - w * y), 0);
+  m[1] = glm::vec4(2 * (x * y - w * z), 1 - 2 * (x * x + z * z), 2 * (y * z + w * x), 0);
+  m[2] = glm::vec4(2 * (x * z + w * y), 2 * (y * z - w * x), 1 - 2 * (x * x + y * y), 0);
+  if(node.scale.size() == 3)
+  {
+    for(int c = 0; c < 3; c++)
+      m[c] = m[c] * static_cast<float>(node.scale[c]);
+  }
+  if(node.translation.size() == 3)
+  {
+    m[3] = glm::vec4(static_cast<float>(node.translation[0]), static_cast<float>(node.translation[1]),
+                     static_cast<float>(node.translation[2]), 1);
+  }
+  return m;
+}
+
+float readFloat(const uint8_t* p, int componentType, bool normalized)
+{
+  switch(componentType)
+  {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+      float v;
+      memcpy(&v, p, sizeof(v));
+      return v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      return normalized ? *p / 255.f : *p;
+    case TINYGLTF_COMPONENT_TYPE_BYTE: {
+      float v = static_cast<float>(static_cast<int8_t>(*p));
+      return normalized ? std::max(v / 127.f, -1.f) : v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+      uint16_t v;
+      memcpy(&v, p, sizeof(v));
+      return normalized ? v / 65535.f : v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_SHORT: {
+      int16_t v;
+      memcpy(&v, p, sizeof(v));
+      return normalized ? std::max(v / 32767.f, -1.f) : v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+      uint32_t v;
+      memcpy(&v, p, sizeof(v));
+      return static_cast<float>(v);
+    }
+  }
+  return 0;
+}
+
+uint32_t readIndex(const uint8_t* p, int componentType)
+{
+  if(componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
+    return *p;
+  if(componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
+  {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Area weighted vertex normals, as nvh::GltfScene does for primitives without normals
+void generateNormals(const float*    positions,
+                     uint32_t        vertexCount,
+                     const uint32_t* indices,
+                     uint32_t        indexCount,
+                     glm::vec3*      normals)
+{
+  auto position = [&](uint32_t i) { return glm::vec3(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]); };
+  for(uint32_t i = 0; i < vertexCount; i++)
+    normals[i] = glm::vec3(0);
+  for(uint32_t i = 0; i + 2 < indexCount; i += 3)
+  {
+    uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+    if(a >= vertexCount || b >= vertexCount || c >= vertexCount)
+      continue;
+    glm::vec3 n = glm::cross(position(b) - position(a), position(c) - position(a));
+    normals[a] += n;
+    normals[b] += n;
+    normals[c] += n;
+  }
+  for(uint32_t i = 0; i < vertexCount; i++)
+  {
+    float length = glm::length(normals[i]);
+    normals[i]   = length > 0 ? normals[i] / length : glm::vec3(0, 1, 0);
+  }
+}
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// The accessor must read inside the BIN chunk, with the type expected for its attribute
+//
+bool GlbImport::checkAccessor(const tinygltf::Model& tmodel, int accessorIndex, bool indices) const
+{
+  if(accessorIndex < 0 || accessorIndex >= static_cast<int>(tmodel.accessors.size()))
+    return false;
+  const tinygltf::Accessor& accessor = tmodel.accessors[accessorIndex];
+  if(accessor.sparse.isSparse || accessor.bufferView < 0
+     || accessor.bufferView >= static_cast<int>(tmodel.bufferViews.size()))
+    return false;
+  const tinygltf::BufferView& view = tmodel.bufferViews[accessor.bufferView];
+  if(view.buffer != 0 || m_file.bin() == nullptr)
+    return false;
+
+  if(indices)
+  {
+    if(accessor.type != TINYGLTF_TYPE_SCALAR
+       || (accessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE
+           && accessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT
+           && accessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT))
+      return false;
+  }
+  else if(accessor.type != TINYGLTF_TYPE_VEC2 && accessor.type != TINYGLTF_TYPE_VEC3
+          && accessor.type != TINYGLTF_TYPE_VEC4)
+    return false;
+
+  const size_t elemSize = static_cast<size_t>(tinygltf::GetComponentSizeInBytes(accessor.componentType))
+                          * tinygltf::GetNumComponentsInType(accessor.type);
+  const size_t stride = view.byteStride != 0 ? view.byteStride : elemSize;
+  if(accessor.count == 0)
+    return true;
+  const size_t end = accessor.byteOffset + (accessor.count - 1) * stride + elemSize;
+  return end <= view.byteLength && view.byteOffset + view.byteLength <= m_file.binSize();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Pointer in the mapping when the accessor already has the layout of the attribute
+//
+const void* GlbImport::packedData(const tinygltf::Model& tmodel, int accessorIndex, Attribute attribute) const
+{
+  const tinygltf::Accessor&   accessor = tmodel.accessors[accessorIndex];
+  const tinygltf::BufferView& view     = tmodel.bufferViews[accessor.bufferView];
+  const int expectedType = attribute == eIndices ? TINYGLTF_TYPE_SCALAR :
+                                                   (attribute == eTexcoords ? TINYGLTF_TYPE_VEC2 : TINYGLTF_TYPE_VEC3);
+  const int expectedComponent =
+      attribute == eIndices ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT : TINYGLTF_COMPONENT_TYPE_FLOAT;
+  if(accessor.type != expectedType || accessor.componentType != expectedComponent
+     || (view.byteStride != 0 && view.byteStride != elementSize(attribute)))
+    return nullptr;
+  return m_file.bin() + view.byteOffset + accessor.byteOffset;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Conversion of an accessor to the layout of the attribute; absent indices are 0..n-1 and absent
+// UVs are 0. Normals are generated by the caller.
+//
+GlbImport::Range GlbImport::convert(const tinygltf::Model&   tmodel,
+                                    const PrimSource&        source,
+                                    const nvh::GltfPrimMesh& prim,
+                                    Attribute                attribute,
+                                    std::vector<uint8_t>&    storage) const
+{
+  const int    accessorIndex = attribute == eIndices ? source.indices : source.attributes[attribute];
+  const size_t count         = attribute == eIndices ? prim.indexCount : prim.vertexCount;
+  storage.resize(count * elementSize(attribute));
+
+  if(attribute == eIndices)
+  {
+    uint32_t* indices = reinterpret_cast<uint32_t*>(storage.data());
+    if(accessorIndex < 0)
+    {
+      for(size_t i = 0; i < count; i++)
+        indices[i] = static_cast<uint32_t>(i);
+    }
+    else
+    {
+      const tinygltf::Accessor&   accessor      = tmodel.accessors[accessorIndex];
+      const tinygltf::BufferView& view          = tmodel.bufferViews[accessor.bufferView];
+      const size_t                componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+      const size_t                stride        = view.byteStride != 0 ? view.byteStride : componentSize;
+      const uint8_t*              data          = m_file.bin() + view.byteOffset + accessor.byteOffset;
+      for(size_t i = 0; i < count; i++)
+        indices[i] = readIndex(data + i * stride, accessor.componentType);
+    }
+    return {storage.data(), storage.size()};
+  }
+
+  float* values = reinterpret_cast<float*>(storage.data());
+  if(accessorIndex < 0)
+  {
+    std::fill(values, values + count * elementSize(attribute) / sizeof(float), 0.f);
+    return {storage.data(), storage.size()};
+  }
+
+  const tinygltf::Accessor&   accessor      = tmodel.accessors[accessorIndex];
+  const tinygltf::BufferView& view          = tmodel.bufferViews[accessor.bufferView];
+  const size_t                componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+  const size_t                nbSource      = tinygltf::GetNumComponentsInType(accessor.type);
+  const size_t                nbDest        = elementSize(attribute) / sizeof(float);
+  const size_t                stride        = view.byteStride != 0 ? view.byteStride : componentSize * nbSource;
+  const uint8_t*              data          = m_file.bin() + view.byteOffset + accessor.byteOffset;
+  for(size_t i = 0; i < count; i++)
+  {
+    const uint8_t* element = data + i * stride;
+    for(size_t c = 0; c < nbDest; c++)
+    {
+      values[i * nbDest + c] =
+          c < nbSource ? readFloat(element + c * componentSize, accessor.componentType, accessor.normalized) : 0.f;
+    }
+  }
+  return {storage.data(), storage.size()};
+}
+
+size_t GlbImport::totalSize(Attribute attribute) const
+{
+  size_t size = 0;
+  for(const auto& range : m_ranges[attribute])
+    size += range.size;
+  return size;
+}
+
+bool GlbImport::load(const std::string& filename, tinygltf::Model& tmodel, nvh::GltfScene& scene, ThreadPool& pool)
+{
+  if(!m_file.open(filename))
+    return false;
+
+  // Buffers and images are read from the mapping: only files where they all are in the BIN chunk
+  nlohmann::json doc = nlohmann::json::parse(m_file.json(), m_file.json() + m_file.jsonSize(), nullptr, false);
+  if(doc.is_discarded())
+    return false;
+  std::vector<int>         imageViews;
+  std::vector<std::string> imageNames;
+  if(doc.contains("buffers"))
+  {
+    for(const auto& buffer : doc["buffers"])
+    {
+      if(buffer.contains("uri"))
+        return false;
+    }
+  }
+  if(doc.contains("images"))
+  {
+    for(const auto& image : doc["images"])
+    {
+      if(!image.contains("bufferView"))
+        return false;
+      imageViews.push_back(image["bufferView"].get<int>());
+      imageNames.push_back(image.value("name", ""));
+    }
+  }
+  doc.erase("buffers");
+  doc.erase("images");
+  const std::string json = doc.dump();
+
+  tinygltf::Model    model;
+  tinygltf::TinyGLTF context;
+  std::string        warn, error;
+  const std::string  baseDir = std::filesystem::path(filename).parent_path().string();
+  if(!context.LoadASCIIFromString(&model, &error, &warn, json.c_str(), static_cast<unsigned int>(json.size()), baseDir))
+  {
+    LOGE("%s", error.c_str());
+    return false;
+  }
+  if(!warn.empty())
+    LOGW("%s", warn.c_str());
+
+  // Drawable nodes, depth first. glTF nodes form trees: visiting more nodes than exist is a cycle.
+  std::vector<nvh::GltfNode>                     nodes;
+  std::vector<nvh::GltfPrimMesh>                 prims;
+  std::vector<PrimSource>                        sources;
+  std::unordered_map<int, std::vector<uint32_t>> meshPrims;
+  std::map<std::array<int, 4>, uint32_t>         primCache;
+  uint32_t                                       indexTotal  = 0;
+  uint32_t                                       vertexTotal = 0;
+
+  if(model.scenes.empty())
+    return false;
+  int sceneIndex = model.defaultScene;
+  if(sceneIndex < 0 || sceneIndex >= static_cast<int>(model.scenes.size()))
+    sceneIndex = 0;
+  const tinygltf::Scene&                 tscene = model.scenes[sceneIndex];
+  std::vector<std::pair<int, glm::mat4>> stack;
+  for(auto it = tscene.nodes.rbegin(); it != tscene.nodes.rend(); ++it)
+    stack.emplace_back(*it, glm::mat4(1));
+  size_t visited = 0;
+  while(!stack.empty())
+  {
+    auto [nodeIndex, parentMatrix] = stack.back();
+    stack.pop_back();
+    if(nodeIndex < 0 || nodeIndex >= static_cast<int>(model.nodes.size()) || ++visited > model.nodes.size())
+      return false;
+    const tinygltf::Node& node        = model.nodes[nodeIndex];
+    const glm::mat4       worldMatrix = parentMatrix * localMatrix(node);
+
+    if(node.mesh >= 0 && node.mesh < static_cast<int>(model.meshes.size()))
+    {
+      auto it = meshPrims.find(node.mesh);
+      if(it == meshPrims.end())
+      {
+        std::vector<uint32_t> meshPrimIndices;
+        const tinygltf::Mesh& mesh = model.meshes[node.mesh];
+        for(const auto& primitive : mesh.primitives)
+        {
+          if(primitive.mode != TINYGLTF_MODE_TRIANGLES)
+            continue;
+          PrimSource source;
+          source.indices = primitive.indices;
+          for(int a = 0; a < 3; a++)
+          {
+            auto attribute       = primitive.attributes.find(kAttributeNames[a]);
+            source.attributes[a] = attribute != primitive.attributes.end() ? attribute->second : -1;
+          }
+          if(source.attributes[ePositions] < 0)
+            continue;
+
+          // Primitives of different meshes using the same accessors share their data
+          std::array<int, 4> key{source.indices, source.attributes[0], source.attributes[1], source.attributes[2]};
+          auto               cached = primCache.find(key);
+          if(cached != primCache.end())
+          {
+            meshPrimIndices.push_back(cached->second);
+            continue;
+          }
+
+          if(source.indices >= 0 && !checkAccessor(model, source.indices, true))
+            return false;
+          for(int a = 0; a < 3; a++)
+          {
+            if(source.attributes[a] >= 0 && !checkAccessor(model, source.attributes[a], false))
+              return false;
+          }
+
+          // Normals and UVs are read for vertexCount vertices: a shorter accessor would read past its range
+          const tinygltf::Accessor& positions = model.accessors[source.attributes[ePositions]];
+          for(int a = eNormals; a <= eTexcoords; a++)
+          {
+            if(source.attributes[a] >= 0 && model.accessors[source.attributes[a]].count != positions.count)
+              return false;
+          }
+
+          nvh::GltfPrimMesh         prim;
+          prim.vertexCount   = static_cast<uint32_t>(positions.count);
+          prim.indexCount    = source.indices >= 0 ? static_cast<uint32_t>(model.accessors[source.indices].count) :
+                                                     prim.vertexCount;
+          prim.firstIndex    = indexTotal;
+          prim.vertexOffset  = vertexTotal;
+          prim.materialIndex = std::max(0, primitive.material);
+          prim.name          = mesh.name;
+          if(positions.minValues.size() == 3 && positions.maxValues.size() == 3)
+          {
+            prim.posMin = glm::vec3(positions.minValues[0], positions.minValues[1], positions.minValues[2]);
+            prim.posMax = glm::vec3(positions.maxValues[0], positions.maxValues[1], positions.maxValues[2]);
+          }
+          indexTotal += prim.indexCount;
+          vertexTotal += prim.vertexCount;
+
+          primCache[key] = static_cast<uint32_t>(prims.size());
+          meshPrimIndices.push_back(static_cast<uint32_t>(prims.size()));
+          prims.push_back(prim);
+          sources.push_back(source);
+        }
+        it = meshPrims.emplace(node.mesh, std::move(meshPrimIndices)).first;
+      }
+
+      for(uint32_t primIndex : it->second)
+      {
+        nvh::GltfNode gnode;
+        gnode.worldMatrix = worldMatrix;
+        gnode.primMesh    = static_cast<int>(primIndex);
+        nodes.push_back(gnode);
+      }
+    }
+
+    for(auto child = node.children.rbegin(); child != node.children.rend(); ++child)
+      stack.emplace_back(*child, worldMatrix);
+  }
+
+  // Embedded images
+  for(int view : imageViews)
+  {
+    if(view < 0 || view >= static_cast<int>(model.bufferViews.size()) || model.bufferViews[view].buffer != 0
+       || model.bufferViews[view].byteOffset + model.bufferViews[view].byteLength > m_file.binSize())
+      return false;
+  }
+  model.images.resize(imageViews.size());
+  pool.parallelBatches(imageViews.size(), 1, [&](size_t i, size_t) {
+    const tinygltf::BufferView& view  = model.bufferViews[imageViews[i]];
+    tinygltf::Image&            image = model.images[i];
+    image.name                        = imageNames[i];
+    image.bufferView                  = imageViews[i];
+
+    int      width, height, channels;
+    stbi_uc* pixels = stbi_load_from_memory(m_file.bin() + view.byteOffset, static_cast<int>(view.byteLength), &width,
+                                            &height, &channels, STBI_rgb_alpha);
+    if(pixels == nullptr)
+      return;  // Width and height stay -1: replaced by the default texture
+    image.width      = width;
+    image.height     = height;
+    image.component  = 4;
+    image.bits       = 8;
+    image.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    image.image.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+    stbi_image_free(pixels);
+  });
+
+  // Attribute ranges, converted in parallel across primitives
+  for(auto& ranges : m_ranges)
+    ranges.assign(prims.size(), {});
+  m_converted.assign(prims.size() * eAttributeCount, {});
+  pool.parallelBatches(prims.size(), 1, [&](size_t p, size_t) {
+    const PrimSource&        source = sources[p];
+    const nvh::GltfPrimMesh& prim   = prims[p];
+    for(Attribute attribute : {ePositions, eIndices, eTexcoords, eNormals})
+    {
+      const int             accessor = attribute == eIndices ? source.indices : source.attributes[attribute];
+      const size_t          count    = attribute == eIndices ? prim.indexCount : prim.vertexCount;
+      const void*           data     = accessor >= 0 ? packedData(model, accessor, attribute) : nullptr;
+      std::vector<uint8_t>& storage  = m_converted[p * eAttributeCount + attribute];
+      if(data != nullptr)
+        m_ranges[attribute][p] = {data, count * elementSize(attribute)};
+      else if(attribute == eNormals && accessor < 0)
+      {
+        storage.resize(prim.vertexCount * elementSize(eNormals));
+        generateNormals(static_cast<const float*>(m_ranges[ePositions][p].data), prim.vertexCount,
+                        static_cast<const uint32_t*>(m_ranges[eIndices][p].data), prim.indexCount,
+                        reinterpret_cast<glm::vec3*>(storage.data()));
+        m_ranges[attribute][p] = {storage.data(), storage.size()};
+      }
+      else
+        m_ranges[attribute][p] = convert(model, source, prim, attribute, storage);
+    }
+  });
+
+  m_mappedBytes    = 0;
+  m_convertedBytes = 0;
+  for(const auto& storage : m_converted)
+    m_convertedBytes += storage.size();
+  for(const auto& ranges : m_ranges)
+  {
+    for(const auto& range : ranges)
+      m_mappedBytes += range.size;
+  }
+  m_mappedBytes -= m_convertedBytes;
+
+  tmodel             = std::move(model);
+  scene.m_nodes      = std::move(nodes);
+  scene.m_primMeshes = std::move(prims);
+  return true;
+}
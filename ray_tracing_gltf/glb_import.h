@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "glb_file.h"
+#include "thread_pool.h"
+
+#include "nvh/gltfscene.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// Import of a binary glTF (.glb) without copying the geometry
+// - The file is memory mapped (GlbFile). tinygltf only parses the JSON chunk, from which the
+//   buffers and images are removed: the BIN chunk is never copied into a tinygltf::Buffer.
+// - Embedded images are decoded in parallel from the mapping into tinygltf::Model::images.
+// - Drawable nodes are flattened as nvh::GltfScene::importDrawableNodes does: m_nodes and
+//   m_primMeshes of the scene are filled, primitives using the same accessors are shared.
+// - The attributes are returned as ranges, in the order of the primitive meshes. Tightly packed
+//   float positions, normals, UVs and 32-bit indices point in the mapping; other accessors and
+//   missing indices, normals or UVs are converted, in parallel across primitives.
+// load() returns false, leaving the model and scene untouched, when the file needs the regular
+// tinygltf path: external buffers or images, sparse accessors, invalid ranges.
+//
+class GlbImport
+{
+public:
+  enum Attribute
+  {
+    ePositions,  // vec3
+    eNormals,    // vec3
+    eTexcoords,  // vec2
+    eIndices,    // uint32_t, relative to the primitive mesh vertexOffset
+    eAttributeCount
+  };
+
+  struct Range
+  {
+    const void* data{nullptr};
+    size_t      size{0};  // Bytes
+  };
+
+  bool load(const std::string& filename,
+            tinygltf::Model&   tmodel,
+            nvh::GltfScene&    scene,
+            ThreadPool&        pool = ThreadPool::global());
+
+  // Valid until the GlbImport is destroyed
+  const std::vector<Range>& ranges(Attribute attribute) const { return m_ranges[attribute]; }
+  size_t                    totalSize(Attribute attribute) const;
+  size_t                    mappedBytes() const { return m_mappedBytes; }  // Attribute bytes read in place
+  size_t                    convertedBytes() const { return m_convertedBytes; }
+  size_t                    fileSize() const { return m_file.fileSize(); }
+
+private:
+  struct PrimSource
+  {
+    int indices{-1};
+    int attributes[3]{-1, -1, -1};  // Accessors of POSITION, NORMAL, TEXCOORD_0
+  };
+
+  bool        checkAccessor(const tinygltf::Model& tmodel, int accessor, bool indices) const;
+  Range       convert(const tinygltf::Model&   tmodel,
+                      const PrimSource&        source,
+                      const nvh::GltfPrimMesh& prim,
+                      Attribute                attribute,
+                      std::vector<uint8_t>&    storage) const;
+  const void* packedData(const tinygltf::Model& tmodel, int accessor, Attribute attribute) const;
+
+  GlbFile                           m_file;
+  std::vector<Range>                m_ranges[eAttributeCount];
+  std::vector<std::vector<uint8_t>> m_converted;
+  size_t                            m_mappedBytes{0};
+  size_t                            m_convertedBytes{0};
+};
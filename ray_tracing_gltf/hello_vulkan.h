@@ -31,6 +31,8 @@
 #include "nvh/gltfscene.hpp"
 #include "nvvk/raytraceKHR_vk.hpp"
 #include "nvvk/sbtwrapper_vk.hpp"
+#include "blas_builder.h"
+#include "geometry_dedup.h"
 
 //--------------------------------------------------------------------------------------------------
 // Simple rasterizer of OBJ objects
@@ -48,7 +50,7 @@ public:
   void loadScene(const std::string& filename);
   void updateDescriptorSet();
   void createUniformBuffer();
-  void createTextureImages(const VkCommandBuffer& cmdBuf, tinygltf::Model& gltfModel);
+  void createTextureImages(const VkCommandBuffer& cmdBuf, tinygltf::Model& gltfModel, const std::string& sceneFilename);
   void updateUniformBuffer(const VkCommandBuffer& cmdBuf);
   void onResize(int /*w*/, int /*h*/) override;
   void destroyResources();
@@ -56,6 +58,7 @@ public:
 
 
   nvh::GltfScene m_gltfScene;
+  GeometryDedup  m_primDedup;  // Identical primitive meshes, sharing their data and BLAS
   nvvk::Buffer   m_vertexBuffer;
   nvvk::Buffer   m_normalBuffer;
   nvvk::Buffer   m_uvBuffer;
@@ -123,6 +126,8 @@ public:
 
   VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_rtProperties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR};
   nvvk::RaytracingBuilderKHR                        m_rtBuilder;
+  BlasBuilder                                       m_blasBuilder;  // BLAS, compacted; m_rtBuilder has the TLAS
+  std::vector<uint32_t>                             m_primBlas;  // BLAS of each primitive mesh
   nvvk::DescriptorSetBindings                       m_rtDescSetLayoutBind;
   VkDescriptorPool                                  m_rtDescPool;
   VkDescriptorSetLayout                             m_rtDescSetLayout;
@@ -37,6 +37,7 @@
 #include "nvpsystem.hpp"
 #include "nvvk/commands_vk.hpp"
 #include "nvvk/context_vk.hpp"
+#include "cpu_bvh.h"
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -68,6 +69,42 @@ void renderUI(HelloVulkan& helloVk, bool useRaytracer)
   }
 }
 
+//--------------------------------------------------------------------------------------------------
+// CPU BVH over the world space triangles of all the drawable nodes
+//
+static void buildCpuBvh(const std::string& filename)
+{
+  tinygltf::Model    tmodel;
+  tinygltf::TinyGLTF tcontext;
+  std::string        warn, error;
+  bool               isGlb = filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".glb") == 0;
+  bool               loaded = isGlb ? tcontext.LoadBinaryFromFile(&tmodel, &error, &warn, filename) :
+                                      tcontext.LoadASCIIFromFile(&tmodel, &error, &warn, filename);
+  if(!loaded)
+  {
+    LOGE("%s", error.c_str());
+    return;
+  }
+  nvh::GltfScene scene;
+  scene.importDrawableNodes(tmodel, nvh::GltfAttributes::NoAttribs);
+
+  std::vector<glm::vec3> positions;
+  std::vector<uint32_t>  indices;
+  for(const auto& node : scene.m_nodes)
+  {
+    const nvh::GltfPrimMesh& prim = scene.m_primMeshes[node.primMesh];
+    const uint32_t           base = static_cast<uint32_t>(positions.size());
+    for(uint32_t v = 0; v < prim.vertexCount; v++)
+      positions.emplace_back(node.worldMatrix * glm::vec4(scene.m_positions[prim.vertexOffset + v], 1.f));
+    for(uint32_t i = 0; i < prim.indexCount; i++)
+      indices.push_back(base + scene.m_indices[prim.firstIndex + i]);
+  }
+
+  CpuBvh bvh;
+  bvh.build(positions, indices);
+  bvh.logStats(filename.c_str());
+}
+
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -80,8 +117,6 @@ static int const SAMPLE_HEIGHT = 720;
 //
 int main(int argc, char** argv)
 {
-  UNUSED(argc);
-
   // Setup GLFW window
   glfwSetErrorCallback(onErrorCallback);
   if(!glfwInit())
@@ -112,6 +147,20 @@ int main(int argc, char** argv)
       std::string(PROJECT_NAME),
   };
 
+  // A .gltf or .glb scene can be given on the command line, after the options
+  const bool  cpuBvh    = argc > 1 && std::string(argv[1]) == "--cpu-bvh";
+  std::string sceneFile = argc > (cpuBvh ? 2 : 1) ? argv[argc - 1] :
+                                                    nvh::findFile("media/scenes/cornellBox.gltf", defaultSearchPaths, true);
+
+  // CPU BVH (CpuBvh) of the scene, reporting the build throughput and quality, then exit
+  if(cpuBvh)
+  {
+    buildCpuBvh(sceneFile);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+  }
+
   // Vulkan required extensions
   assert(glfwVulkanSupported() == 1);
   uint32_t count{0};
@@ -162,7 +211,7 @@ int main(int argc, char** argv)
   helloVk.initGUI(0);  // Using sub-pass 0
 
   // Creation of the example
-  helloVk.loadScene(nvh::findFile("media/scenes/cornellBox.gltf", defaultSearchPaths, true));
+  helloVk.loadScene(sceneFile);
 
 
   helloVk.createOffscreenRender();
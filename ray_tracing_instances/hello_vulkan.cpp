@@ -18,6 +18,7 @@
  */
 
 
+#include <filesystem>
 #include <sstream>
 
 
@@ -50,6 +51,8 @@ void HelloVulkan::setup(const VkInstance& instance, const VkDevice& device, cons
 {
   AppBaseVk::setup(instance, device, physicalDevice, queueFamily);
   m_alloc.init(instance, device, physicalDevice);
+  m_upload.init(&m_alloc, device, queueFamily);
+  m_geometry.init(&m_alloc, device, &m_upload);
   m_debug.setup(m_device);
   m_offscreenDepthFormat = nvvk::findDepthFormat(physicalDevice);
 }
@@ -116,6 +119,13 @@ void HelloVulkan::createDescriptorSetLayout()
   // Textures
   m_descSetLayoutBind.addBinding(SceneBindings::eTextures, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nbTxt,
                                  VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+  // Scene-wide geometry and materials
+  m_descSetLayoutBind.addBinding(SceneBindings::eVertices, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+  m_descSetLayoutBind.addBinding(SceneBindings::eIndices, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+  m_descSetLayoutBind.addBinding(SceneBindings::eMaterials, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                                 VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+  m_descSetLayoutBind.addBinding(SceneBindings::eMatIndices, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                                 VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
 
 
   m_descSetLayout = m_descSetLayoutBind.createLayout(m_device);
@@ -137,6 +147,16 @@ void HelloVulkan::updateDescriptorSet()
   VkDescriptorBufferInfo dbiSceneDesc{m_bObjDesc.buffer, 0, VK_WHOLE_SIZE};
   writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, SceneBindings::eObjDescs, &dbiSceneDesc));
 
+  // Geometry pool, complete once all models are loaded
+  VkDescriptorBufferInfo dbiVertices{m_geometry.buffer(GeometryPool::eVertices).buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo dbiIndices{m_geometry.buffer(GeometryPool::eIndices).buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo dbiMaterials{m_geometry.buffer(GeometryPool::eMaterials).buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo dbiMatIndices{m_geometry.buffer(GeometryPool::eMaterialIndices).buffer, 0, VK_WHOLE_SIZE};
+  writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, SceneBindings::eVertices, &dbiVertices));
+  writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, SceneBindings::eIndices, &dbiIndices));
+  writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, SceneBindings::eMaterials, &dbiMaterials));
+  writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, SceneBindings::eMatIndices, &dbiMatIndices));
+
   // All texture samplers
   std::vector<VkDescriptorImageInfo> diit;
   for(auto& texture : m_textures)
@@ -189,6 +209,20 @@ void HelloVulkan::createGraphicsPipeline()
 //
 void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
 {
+  // A file already loaded only adds an instance of the existing model: no parsing, no new
+  // buffers, textures or BLAS.
+  std::error_code ec;
+  std::string     key = std::filesystem::weakly_canonical(filename, ec).string();
+  if(ec)
+    key = filename;
+  auto it = m_modelRegistry.find(key);
+  if(it != m_modelRegistry.end())
+  {
+    m_instances.push_back({transform, it->second});
+    return;
+  }
+  m_modelRegistry[key] = static_cast<uint32_t>(m_objModel.size());
+
   LOGI("Loading File:  %s \n", filename.c_str());
   ObjLoader loader;
   loader.loadModel(filename);
@@ -204,28 +238,18 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
   ObjModel model;
   model.nbIndices  = static_cast<uint32_t>(loader.m_indices.size());
   model.nbVertices = static_cast<uint32_t>(loader.m_vertices.size());
-
-  // Create the buffers on Device and copy vertices, indices and materials
-  nvvk::CommandPool  cmdBufGet(m_device, m_graphicsQueueIndex);
-  VkCommandBuffer    cmdBuf          = cmdBufGet.createCommandBuffer();
-  VkBufferUsageFlags flag            = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-  VkBufferUsageFlags rayTracingFlags =  // used also for building acceleration structures
-      flag | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-  model.vertexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | rayTracingFlags);
-  model.indexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | rayTracingFlags);
-  model.matColorBuffer = m_alloc.createBuffer(cmdBuf, loader.m_materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
-  model.matIndexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_matIndx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
+  model.indices    = loader.m_indices;
+  model.positions  = std::move(loader.m_positions);  // Extracted by the loader, on every load path
+
+  // Append vertices, indices and materials to the scene-wide buffers: no allocation per model
+  // The copies are batched with those of the next models and submitted without waiting, see UploadManager
+  model.vertexOffset           = m_geometry.add(GeometryPool::eVertices, loader.m_vertices);
+  model.indexOffset            = m_geometry.add(GeometryPool::eIndices, loader.m_indices);
+  uint32_t materialOffset      = m_geometry.add(GeometryPool::eMaterials, loader.m_materials);
+  uint32_t materialIndexOffset = m_geometry.add(GeometryPool::eMaterialIndices, loader.m_matIndx);
   // Creates all textures found and find the offset for this model
   auto txtOffset = static_cast<uint32_t>(m_textures.size());
-  createTextureImages(cmdBuf, loader.m_textures);
-  cmdBufGet.submitAndWait(cmdBuf);
-  m_alloc.finalizeAndReleaseStaging();
-
-  std::string objNb = std::to_string(m_objModel.size());
-  m_debug.setObjectName(model.vertexBuffer.buffer, (std::string("vertex_" + objNb)));
-  m_debug.setObjectName(model.indexBuffer.buffer, (std::string("index_" + objNb)));
-  m_debug.setObjectName(model.matColorBuffer.buffer, (std::string("mat_" + objNb)));
-  m_debug.setObjectName(model.matIndexBuffer.buffer, (std::string("matIdx_" + objNb)));
+  createTextureImages(loader.m_textures);
 
   // Keeping transformation matrix of the instance
   ObjInstance instance;
@@ -235,11 +259,11 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
 
   // Creating information for device access
   ObjDesc desc;
-  desc.txtOffset            = txtOffset;
-  desc.vertexAddress        = nvvk::getBufferDeviceAddress(m_device, model.vertexBuffer.buffer);
-  desc.indexAddress         = nvvk::getBufferDeviceAddress(m_device, model.indexBuffer.buffer);
-  desc.materialAddress      = nvvk::getBufferDeviceAddress(m_device, model.matColorBuffer.buffer);
-  desc.materialIndexAddress = nvvk::getBufferDeviceAddress(m_device, model.matIndexBuffer.buffer);
+  desc.txtOffset           = txtOffset;
+  desc.vertexOffset        = model.vertexOffset;
+  desc.indexOffset         = model.indexOffset;
+  desc.materialOffset      = materialOffset;
+  desc.materialIndexOffset = materialIndexOffset;
 
   // Keeping the obj host model and device description
   m_objModel.emplace_back(model);
@@ -266,19 +290,22 @@ void HelloVulkan::createUniformBuffer()
 //
 void HelloVulkan::createObjDescriptionBuffer()
 {
-  nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
-
-  auto cmdBuf = cmdGen.createCommandBuffer();
-  m_bObjDesc  = m_alloc.createBuffer(cmdBuf, m_objDesc, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-  cmdGen.submitAndWait(cmdBuf);
-  m_alloc.finalizeAndReleaseStaging();
+  // Last upload of the scene: the pending batch is submitted and all uploads are waited for once
+  m_bObjDesc = m_upload.createBuffer(m_objDesc, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_upload.waitIdle();
   m_debug.setObjectName(m_bObjDesc.buffer, "ObjDescs");
+  m_debug.setObjectName(m_geometry.buffer(GeometryPool::eVertices).buffer, "Vertices");
+  m_debug.setObjectName(m_geometry.buffer(GeometryPool::eIndices).buffer, "Indices");
+  m_debug.setObjectName(m_geometry.buffer(GeometryPool::eMaterials).buffer, "Materials");
+  m_debug.setObjectName(m_geometry.buffer(GeometryPool::eMaterialIndices).buffer, "MatIndices");
+  LOGI(" Uploads: %zu models, %.1f MB in %u queue submissions, %u geometry allocations\n", m_objModel.size(),
+       m_upload.uploadedBytes() / (1024.0 * 1024.0), m_upload.submitCount(), m_geometry.allocationCount());
 }
 
 //--------------------------------------------------------------------------------------------------
 // Creating all textures and samplers
 //
-void HelloVulkan::createTextureImages(const VkCommandBuffer& cmdBuf, const std::vector<std::string>& textures)
+void HelloVulkan::createTextureImages(const std::vector<std::string>& textures)
 {
   VkSamplerCreateInfo samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
   samplerCreateInfo.minFilter  = VK_FILTER_LINEAR;
@@ -299,12 +326,13 @@ void HelloVulkan::createTextureImages(const VkCommandBuffer& cmdBuf, const std::
     auto                   imageCreateInfo = nvvk::makeImage2DCreateInfo(imgSize, format);
 
     // Creating the dummy texture
-    nvvk::Image           image  = m_alloc.createImage(cmdBuf, bufferSize, color.data(), imageCreateInfo);
+    nvvk::Image           image  = m_upload.createImage(imageCreateInfo, bufferSize, color.data());
     VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
     texture                      = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
 
     // The image format must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-    nvvk::cmdBarrierImageLayout(cmdBuf, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    nvvk::cmdBarrierImageLayout(m_upload.commandBuffer(), texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     m_textures.push_back(texture);
   }
   else
@@ -335,8 +363,9 @@ void HelloVulkan::createTextureImages(const VkCommandBuffer& cmdBuf, const std::
       auto         imageCreateInfo = nvvk::makeImage2DCreateInfo(imgSize, format, VK_IMAGE_USAGE_SAMPLED_BIT, true);
 
       {
-        nvvk::Image image = m_alloc.createImage(cmdBuf, bufferSize, pixels, imageCreateInfo);
-        nvvk::cmdGenerateMipmaps(cmdBuf, image.image, format, imgSize, imageCreateInfo.mipLevels);
+        nvvk::Image image = m_upload.createImage(imageCreateInfo, bufferSize, pixels);
+        nvvk::cmdGenerateMipmaps(m_upload.commandBuffer(), image.image, format, imgSize, imageCreateInfo.mipLevels, 1,
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
         VkImageViewCreateInfo ivInfo  = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
         nvvk::Texture         texture = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
 
@@ -361,13 +390,7 @@ void HelloVulkan::destroyResources()
   m_alloc.destroy(m_bGlobals);
   m_alloc.destroy(m_bObjDesc);
 
-  for(auto& m : m_objModel)
-  {
-    m_alloc.destroy(m.vertexBuffer);
-    m_alloc.destroy(m.indexBuffer);
-    m_alloc.destroy(m.matColorBuffer);
-    m_alloc.destroy(m.matIndexBuffer);
-  }
+  m_geometry.deinit();
 
   for(auto& t : m_textures)
   {
@@ -387,12 +410,15 @@ void HelloVulkan::destroyResources()
 
   // #VKRay
   m_rtBuilder.destroy();
+  m_blasBuilder.destroy();
+  m_tlasInstances.destroy();
   m_sbtWrapper.destroy();
   vkDestroyPipeline(m_device, m_rtPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_rtPipelineLayout, nullptr);
   vkDestroyDescriptorPool(m_device, m_rtDescPool, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_rtDescSetLayout, nullptr);
 
+  m_upload.deinit();
   m_alloc.deinit();
 }
 
@@ -411,7 +437,9 @@ void HelloVulkan::rasterize(const VkCommandBuffer& cmdBuf)
   // Drawing all triangles
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descSet, 0, nullptr);
-
+  // All models are in the same buffers
+  vkCmdBindVertexBuffers(cmdBuf, 0, 1, &m_geometry.buffer(GeometryPool::eVertices).buffer, &offset);
+  vkCmdBindIndexBuffer(cmdBuf, m_geometry.buffer(GeometryPool::eIndices).buffer, 0, VK_INDEX_TYPE_UINT32);
 
   for(const HelloVulkan::ObjInstance& inst : m_instances)
   {
@@ -421,9 +449,7 @@ void HelloVulkan::rasterize(const VkCommandBuffer& cmdBuf)
 
     vkCmdPushConstants(cmdBuf, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
                        sizeof(PushConstantRaster), &m_pcRaster);
-    vkCmdBindVertexBuffers(cmdBuf, 0, 1, &model.vertexBuffer.buffer, &offset);
-    vkCmdBindIndexBuffer(cmdBuf, model.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(cmdBuf, model.nbIndices, 1, 0, 0, 0);
+    vkCmdDrawIndexed(cmdBuf, model.nbIndices, 1, model.indexOffset, static_cast<int32_t>(model.vertexOffset), 0);
   }
   m_debug.endLabel(cmdBuf);
 }
@@ -595,6 +621,9 @@ void HelloVulkan::initRayTracing()
   vkGetPhysicalDeviceProperties2(m_physicalDevice, &prop2);
 
   m_rtBuilder.setup(m_device, &m_alloc, m_graphicsQueueIndex);
+  m_blasBuilder.setup(m_device, &m_alloc, m_graphicsQueueIndex, m_physicalDevice);
+  m_tlasInstances.setup(m_device, &m_alloc, m_graphicsQueueIndex,
+                        nvh::loadFile("spv/instances.comp.spv", true, defaultSearchPaths, true));
   m_sbtWrapper.setup(m_device, m_graphicsQueueIndex, &m_alloc, m_rtProperties);
 }
 
@@ -603,9 +632,9 @@ void HelloVulkan::initRayTracing()
 //
 auto HelloVulkan::objectToVkGeometryKHR(const ObjModel& model)
 {
-  // BLAS builder requires raw device addresses.
-  VkDeviceAddress vertexAddress = nvvk::getBufferDeviceAddress(m_device, model.vertexBuffer.buffer);
-  VkDeviceAddress indexAddress  = nvvk::getBufferDeviceAddress(m_device, model.indexBuffer.buffer);
+  // BLAS builder requires raw device addresses: the model's range in the scene-wide buffers
+  VkDeviceAddress vertexAddress = m_geometry.address(GeometryPool::eVertices) + model.vertexOffset * sizeof(VertexObj);
+  VkDeviceAddress indexAddress  = m_geometry.address(GeometryPool::eIndices) + model.indexOffset * sizeof(uint32_t);
 
   uint32_t maxPrimitiveCount = model.nbIndices / 3;
 
@@ -647,17 +676,53 @@ auto HelloVulkan::objectToVkGeometryKHR(const ObjModel& model)
 //
 void HelloVulkan::createBottomLevelAS()
 {
+  // Models loaded from different files can still have the same geometry: hashing the positions and
+  // indices finds them, and only the first of each gets a BLAS
+  std::vector<std::vector<GeometryDedup::Span>> objData(m_objModel.size());
+  for(size_t m = 0; m < m_objModel.size(); m++)
+  {
+    const ObjModel& obj = m_objModel[m];
+    objData[m]          = {{obj.positions.data(), obj.positions.size() * sizeof(glm::vec3)},
+                           {obj.indices.data(), obj.indices.size() * sizeof(uint32_t)}};
+  }
+  m_objDedup.build(objData);
+
   // BLAS - Storing each primitive in a geometry
   std::vector<nvvk::RaytracingBuilderKHR::BlasInput> allBlas;
-  allBlas.reserve(m_objModel.size());
-  for(const auto& obj : m_objModel)
+  allBlas.reserve(m_objDedup.uniqueCount());
+  m_objBlas.resize(m_objModel.size());
+  for(uint32_t m = 0; m < m_objModel.size(); m++)
   {
-    auto blas = objectToVkGeometryKHR(obj);
+    if(!m_objDedup.isCanonical(m))
+      continue;
+    auto blas = objectToVkGeometryKHR(m_objModel[m]);
 
     // We could add more geometry in each BLAS, but we add only one for now
+    m_objBlas[m] = static_cast<uint32_t>(allBlas.size());
     allBlas.emplace_back(blas);
   }
-  m_rtBuilder.buildBlas(allBlas, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+  m_blasBuilder.buildBlas(allBlas, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR
+                                       | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR);
+  m_blasBuilder.logReport();
+
+  // Duplicates share the BLAS of their canonical model; the memory saved is what they would have taken
+  VkDeviceSize savedSize = 0;
+  for(uint32_t m = 0; m < m_objModel.size(); m++)
+  {
+    if(m_objDedup.isCanonical(m))
+      continue;
+    m_objBlas[m] = m_objBlas[m_objDedup.canonical(m)];
+    savedSize += m_blasBuilder.reports()[m_objBlas[m]].compactedSize;
+  }
+  LOGI("BLAS: %zu built for %zu models, shared BLAS saved %zu builds and %.1f MB\n", allBlas.size(),
+       m_objModel.size(), m_objModel.size() - allBlas.size(), savedSize / (1024.0 * 1024.0));
+
+  // The host copies are not needed anymore
+  for(auto& obj : m_objModel)
+  {
+    obj.positions = {};
+    obj.indices   = {};
+  }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -665,20 +730,31 @@ void HelloVulkan::createBottomLevelAS()
 //
 void HelloVulkan::createTopLevelAS()
 {
-  std::vector<VkAccelerationStructureInstanceKHR> tlas;
-  tlas.reserve(m_instances.size());
-  for(const HelloVulkan::ObjInstance& inst : m_instances)
+  // The BLAS ids of the instances are their models: the table goes through the dedup remapping
+  std::vector<VkDeviceAddress> blasAddresses(m_objModel.size());
+  for(uint32_t m = 0; m < m_objModel.size(); m++)
+    blasAddresses[m] = m_blasBuilder.getBlasDeviceAddress(m_objBlas[m]);
+  m_tlasInstances.setBlasAddresses(blasAddresses);
+
+  if(m_instances.empty())
   {
-    VkAccelerationStructureInstanceKHR rayInst{};
-    rayInst.transform                      = nvvk::toTransformMatrixKHR(inst.transform);  // Position of the instance
-    rayInst.instanceCustomIndex            = inst.objIndex;                               // gl_InstanceCustomIndexEXT
-    rayInst.accelerationStructureReference = m_rtBuilder.getBlasDeviceAddress(inst.objIndex);
-    rayInst.flags                          = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-    rayInst.mask                           = 0xFF;       //  Only be hit if rayMask & instance.mask != 0
-    rayInst.instanceShaderBindingTableRecordOffset = 0;  // We will use the same hit group for all objects
-    tlas.emplace_back(rayInst);
+    LOGW("No instance in the scene: no TLAS built\n");
+    return;
   }
-  m_rtBuilder.buildTlas(tlas, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+
+  // Records written in parallel into the mapped buffer, read there by the build
+  const uint32_t     nbInstances = static_cast<uint32_t>(m_instances.size());
+  const ObjInstance* instances   = m_instances.data();
+  VkDeviceAddress    records =
+      m_tlasInstances.write(&instances->transform, &instances->objIndex, sizeof(ObjInstance), nbInstances);
+
+  nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
+  VkCommandBuffer   cmdBuf = genCmdBuf.createCommandBuffer();
+  nvvk::Buffer      scratch;
+  m_rtBuilder.cmdCreateTlas(cmdBuf, nbInstances, records, scratch,
+                            VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR, false, false);
+  genCmdBuf.submitAndWait(cmdBuf);
+  m_alloc.destroy(scratch);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include <unordered_map>
+
 // #VKRay
 //
 // Choosing the allocator to use
@@ -46,6 +48,11 @@ using Allocator = nvvk::ResourceAllocatorDedicated;
 // #VKRay
 #include "nvvk/raytraceKHR_vk.hpp"
 #include "nvvk/sbtwrapper_vk.hpp"
+#include "blas_builder.h"
+#include "geometry_dedup.h"
+#include "geometry_pool.h"
+#include "tlas_instances.h"
+#include "upload_manager.h"
 
 //--------------------------------------------------------------------------------------------------
 // Simple rasterizer of OBJ objects
@@ -64,7 +71,7 @@ public:
   void updateDescriptorSet();
   void createUniformBuffer();
   void createObjDescriptionBuffer();
-  void createTextureImages(const VkCommandBuffer& cmdBuf, const std::vector<std::string>& textures);
+  void createTextureImages(const std::vector<std::string>& textures);
   void updateUniformBuffer(const VkCommandBuffer& cmdBuf);
   void onResize(int /*w*/, int /*h*/) override;
   void destroyResources();
@@ -73,12 +80,14 @@ public:
   // The OBJ model
   struct ObjModel
   {
-    uint32_t     nbIndices{0};
-    uint32_t     nbVertices{0};
-    nvvk::Buffer vertexBuffer;    // Device buffer of all 'Vertex'
-    nvvk::Buffer indexBuffer;     // Device buffer of the indices forming triangles
-    nvvk::Buffer matColorBuffer;  // Device buffer of array of 'Wavefront material'
-    nvvk::Buffer matIndexBuffer;  // Device buffer of array of 'Wavefront material'
+    uint32_t nbIndices{0};
+    uint32_t nbVertices{0};
+    uint32_t vertexOffset{0};  // First 'Vertex' in GeometryPool::eVertices
+    uint32_t indexOffset{0};   // First index in GeometryPool::eIndices
+
+    // Host copies hashed by createBottomLevelAS(), then released
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t>  indices;
   };
 
   struct ObjInstance
@@ -102,6 +111,8 @@ public:
   std::vector<ObjDesc>     m_objDesc;    // Model description for device access
   std::vector<ObjInstance> m_instances;  // Scene model instances
 
+  std::unordered_map<std::string, uint32_t> m_modelRegistry;  // Loaded file -> index in m_objModel
+
 
   // Graphic pipeline
   VkPipelineLayout            m_pipelineLayout;
@@ -117,7 +128,9 @@ public:
   std::vector<nvvk::Texture> m_textures;  // vector of all textures of the scene
 
   // Allocator for buffer, images, acceleration structures
-  Allocator m_alloc;
+  Allocator     m_alloc;
+  UploadManager m_upload;    // Batched uploads of the models, submitted without waiting
+  GeometryPool  m_geometry;  // Vertices, indices and materials of all models
 
   nvvk::DebugUtil m_debug;  // Utility to name objects
 
@@ -155,6 +168,10 @@ public:
 
   VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_rtProperties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR};
   nvvk::RaytracingBuilderKHR                        m_rtBuilder;
+  BlasBuilder                                       m_blasBuilder;    // BLAS, compacted; m_rtBuilder has the TLAS
+  TlasInstances                                     m_tlasInstances;  // Instance records read by the TLAS build
+  GeometryDedup                                     m_objDedup;       // Models with identical positions and indices
+  std::vector<uint32_t>                             m_objBlas;        // Model -> BLAS in m_blasBuilder
   nvvk::DescriptorSetBindings                       m_rtDescSetLayoutBind;
   VkDescriptorPool                                  m_rtDescPool;
   VkDescriptorSetLayout                             m_rtDescSetLayout;
@@ -108,8 +108,6 @@ static int const SAMPLE_HEIGHT = 720;
 //
 int main(int argc, char** argv)
 {
-  UNUSED(argc);
-
   // Setup GLFW window
   glfwSetErrorCallback(onErrorCallback);
   if(!glfwInit())
@@ -206,7 +204,7 @@ int main(int argc, char** argv)
   helloVk.loadModel(nvh::findFile("media/scenes/plane.obj", defaultSearchPaths, true));
 
   double time_elapse = timer.elapse();
-  LOGI(" --> (%f)", time_elapse);
+  LOGI(" --> (%f) %zu models, %zu instances\n", time_elapse, helloVk.m_objModel.size(), helloVk.m_instances.size());
 
   helloVk.createOffscreenRender();
   helloVk.createDescriptorSetLayout();
@@ -219,6 +217,20 @@ int main(int argc, char** argv)
   helloVk.initRayTracing();
   helloVk.createBottomLevelAS();
   helloVk.createTopLevelAS();
+
+  // Instances/s of the TLAS instance paths, 10k to 10M instances (or the given count), then exit
+  if(argc > 1 && std::string(argv[1]) == "--tlas-bench")
+  {
+    helloVk.m_tlasInstances.benchmark(argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 10000000u);
+    vkDeviceWaitIdle(helloVk.getDevice());
+    helloVk.destroyResources();
+    helloVk.destroy();
+    vkctx.deinit();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+  }
+
   helloVk.createRtDescriptorSet();
   helloVk.createRtPipeline();
 
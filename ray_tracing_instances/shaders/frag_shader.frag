@@ -24,7 +24,6 @@
 #extension GL_EXT_scalar_block_layout : enable
 
 #extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
-#extension GL_EXT_buffer_reference2 : require
 
 #include "wavefront.glsl"
 
@@ -43,25 +42,20 @@ layout(location = 4) in vec2 i_texCoord;
 // Outgoing
 layout(location = 0) out vec4 o_color;
 
-layout(buffer_reference, scalar) buffer Vertices {Vertex v[]; }; // Positions of an object
-layout(buffer_reference, scalar) buffer Indices {uint i[]; }; // Triangle indices
-layout(buffer_reference, scalar) buffer Materials {WaveFrontMaterial m[]; }; // Array of all materials on an object
-layout(buffer_reference, scalar) buffer MatIndices {int i[]; }; // Material ID for each triangle
-
 layout(binding = eObjDescs, scalar) buffer ObjDesc_ { ObjDesc i[]; } objDesc;
 layout(binding = eTextures) uniform sampler2D[] textureSamplers;
+layout(binding = eMaterials, scalar) buffer Materials_ { WaveFrontMaterial m[]; } materials; // All materials
+layout(binding = eMatIndices, scalar) buffer MatIndices_ { int i[]; } matIndices; // Material ID for each triangle
 // clang-format on
 
 
 void main()
 {
   // Material of the object
-  ObjDesc    objResource = objDesc.i[pcRaster.objIndex];
-  MatIndices matIndices  = MatIndices(objResource.materialIndexAddress);
-  Materials  materials   = Materials(objResource.materialAddress);
+  ObjDesc objResource = objDesc.i[pcRaster.objIndex];
 
-  int               matIndex = matIndices.i[gl_PrimitiveID];
-  WaveFrontMaterial mat      = materials.m[matIndex];
+  int               matIndex = matIndices.i[objResource.materialIndexOffset + gl_PrimitiveID];
+  WaveFrontMaterial mat      = materials.m[objResource.materialOffset + matIndex];
 
   vec3 N = normalize(i_worldNrm);
 
@@ -41,9 +41,13 @@ using uint = unsigned int;
 #endif
 
 START_BINDING(SceneBindings)
-  eGlobals  = 0,  // Global uniform containing camera matrices
-  eObjDescs = 1,  // Access to the object descriptions
-  eTextures = 2   // Access to textures
+  eGlobals    = 0,  // Global uniform containing camera matrices
+  eObjDescs   = 1,  // Access to the object descriptions
+  eTextures   = 2,  // Access to textures
+  eVertices   = 3,  // Vertices of all models, see GeometryPool
+  eIndices    = 4,  // Indices of all models
+  eMaterials  = 5,  // Materials of all models
+  eMatIndices = 6   // Material index of each triangle of all models
 END_BINDING();
 
 START_BINDING(RtxBindings)
@@ -54,13 +58,14 @@ END_BINDING();
 
 
 // Information of a obj model when referenced in a shader
+// The offsets are element indices in the scene-wide buffers (eVertices, eIndices, ...)
 struct ObjDesc
 {
-  int      txtOffset;             // Texture index offset in the array of textures
-  uint64_t vertexAddress;         // Address of the Vertex buffer
-  uint64_t indexAddress;          // Address of the index buffer
-  uint64_t materialAddress;       // Address of the material buffer
-  uint64_t materialIndexAddress;  // Address of the triangle material index buffer
+  int  txtOffset;            // Texture index offset in the array of textures
+  uint vertexOffset;         // First vertex of the model
+  uint indexOffset;          // First index of the model
+  uint materialOffset;       // First material of the model
+  uint materialIndexOffset;  // Material index of the first triangle of the model
 };
 
 // Uniform buffer set at each frame
@@ -82,6 +87,29 @@ struct PushConstantRaster
 };
 
 
+// Instance of the TLAS as kept by the application, expanded by instances.comp into a
+// VkAccelerationStructureInstanceKHR (48 bytes instead of 64, BLAS referenced by index)
+struct CompactInstance
+{
+  vec4 rotation;  // Quaternion x, y, z, w
+  vec3 position;
+  uint blasId;  // Index in PushConstantInstances::blasAddresses
+  vec3 scale;
+  uint customIndex;  // gl_InstanceCustomIndexEXT, 24 bits
+};
+
+// Push constant structure for the expansion of the compact instances
+struct PushConstantInstances
+{
+  uint64_t compactAddress;  // CompactInstance[count]
+  uint64_t blasAddresses;   // Device address of each BLAS
+  uint64_t recordAddress;   // VkAccelerationStructureInstanceKHR[count]
+  uint     first;           // First instance of the dispatch
+  uint     count;
+  uint     flags;  // VkGeometryInstanceFlagsKHR of all instances
+};
+
+
 // Push constant structure for the ray tracer
 struct PushConstantRay
 {
@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "tlas_instances.h"
+#include "nvh/nvprint.hpp"
+#include "nvvk/commands_vk.hpp"
+#include "nvvk/raytraceKHR_vk.hpp"
+#include "nvvk/shaders_vk.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TLAS_INSTANCES_SSE 1
+#endif
+
+
+namespace {
+constexpr size_t   kBatchSize     = 16384;        // Instances per task of the thread pool
+constexpr uint32_t kWorkgroupSize = 256;          // local_size_x of instances.comp
+constexpr uint32_t kMaxGroups     = 65535;        // Guaranteed maxComputeWorkGroupCount[0]
+constexpr uint32_t kCustomMask    = 0xFFu << 24;  // mask 0xFF, hit by all rays
+constexpr uint32_t kStride        = sizeof(VkAccelerationStructureInstanceKHR);
+
+constexpr VkMemoryPropertyFlags kHostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT  // Persistently mapped
+                                              | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+// Column-major 4x4 to the row-major 3x4 of the record, then custom index, mask, flags and BLAS.
+// The records are streamed: they are not read back by the CPU and the memory may be write-combined.
+inline void writeRecord(VkAccelerationStructureInstanceKHR& dst,
+                        const float*                        m,
+                        uint32_t                            blasId,
+                        VkDeviceAddress                     blas,
+                        uint32_t                            flags,
+                        bool                                aligned)
+{
+  const uint32_t customIndexMask = (blasId & 0xFFFFFF) | kCustomMask;
+  const uint32_t sbtOffsetFlags  = flags << 24;
+#ifdef TLAS_INSTANCES_SSE
+  __m128 c0 = _mm_loadu_ps(m);
+  __m128 c1 = _mm_loadu_ps(m + 4);
+  __m128 c2 = _mm_loadu_ps(m + 8);
+  __m128 c3 = _mm_loadu_ps(m + 12);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);  // c0..c2 are now the rows, c3 the (0,0,0,1) row
+  const __m128i tail = _mm_set_epi32(static_cast<int>(blas >> 32), static_cast<int>(blas),
+                                     static_cast<int>(sbtOffsetFlags), static_cast<int>(customIndexMask));
+  float* out = reinterpret_cast<float*>(&dst);
+  if(aligned)
+  {
+    _mm_stream_ps(out, c0);
+    _mm_stream_ps(out + 4, c1);
+    _mm_stream_ps(out + 8, c2);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(out + 12), tail);
+  }
+  else
+  {
+    _mm_storeu_ps(out, c0);
+    _mm_storeu_ps(out + 4, c1);
+    _mm_storeu_ps(out + 8, c2);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), tail);
+  }
+#else
+  (void)aligned;
+  for(int r = 0; r < 3; r++)
+    for(int c = 0; c < 4; c++)
+      dst.transform.matrix[r][c] = m[c * 4 + r];
+  std::memcpy(reinterpret_cast<uint8_t*>(&dst) + 48, &customIndexMask, 4);
+  std::memcpy(reinterpret_cast<uint8_t*>(&dst) + 52, &sbtOffsetFlags, 4);
+  dst.accelerationStructureReference = blas;
+#endif
+}
+
+// Same expansion as instances.comp
+glm::mat4 compactToMatrix(const CompactInstance& inst)
+{
+  const glm::vec4& q = inst.rotation;
+  const glm::vec3& s = inst.scale;
+  glm::mat4        m(1.f);
+  m[0] = glm::vec4(1 - 2 * (q.y * q.y + q.z * q.z), 2 * (q.x * q.y + q.w * q.z), 2 * (q.x * q.z - q.w * q.y), 0) * s.x;
+  m[1] = glm::vec4(2 * (q.x * q.y - q.w * q.z), 1 - 2 * (q.x * q.x + q.z * q.z), 2 * (q.y * q.z + q.w * q.x), 0) * s.y;
+  m[2] = glm::vec4(2 * (q.x * q.z + q.w * q.y), 2 * (q.y * q.z - q.w * q.x), 1 - 2 * (q.x * q.x + q.y * q.y), 0) * s.z;
+  m[3] = glm::vec4(inst.position, 1.f);
+  return m;
+}
+
+double secondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+}  // namespace
+
+
+void TlasInstances::setup(VkDevice                 device,
+                          nvvk::ResourceAllocator* allocator,
+                          uint32_t                 queueIndex,
+                          const std::string&       expandSpirv)
+{
+  m_device     = device;
+  m_alloc      = allocator;
+  m_queueIndex = queueIndex;
+
+  VkPushConstantRange        pushConstant{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstantInstances)};
+  VkPipelineLayoutCreateInfo layoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  layoutInfo.pushConstantRangeCount = 1;
+  layoutInfo.pPushConstantRanges    = &pushConstant;
+  vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_pipelineLayout);
+
+  VkComputePipelineCreateInfo pipelineInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+  pipelineInfo.layout = m_pipelineLayout;
+  pipelineInfo.stage  = nvvk::createShaderStageInfo(m_device, expandSpirv, VK_SHADER_STAGE_COMPUTE_BIT);
+  vkCreateComputePipelines(m_device, {}, 1, &pipelineInfo, nullptr, &m_pipeline);
+  vkDestroyShaderModule(m_device, pipelineInfo.stage.module, nullptr);
+}
+
+void TlasInstances::destroy()
+{
+  if(m_device == VK_NULL_HANDLE)
+    return;
+
+  release(m_blasTable);
+  release(m_records);
+  release(m_compact);
+  release(m_deviceRecords);
+  vkDestroyPipeline(m_device, m_pipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+  m_pipeline       = VK_NULL_HANDLE;
+  m_pipelineLayout = VK_NULL_HANDLE;
+  m_device         = VK_NULL_HANDLE;
+}
+
+void TlasInstances::reserve(MappedBuffer&         dst,
+                            VkDeviceSize          size,
+                            VkBufferUsageFlags    usage,
+                            VkMemoryPropertyFlags memory)
+{
+  if(size <= dst.size)
+    return;
+
+  release(dst);
+  dst.buffer = m_alloc->createBuffer(size, usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, memory);
+  VkBufferDeviceAddressInfo info{VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, nullptr, dst.buffer.buffer};
+  dst.address = vkGetBufferDeviceAddress(m_device, &info);
+  dst.data    = (memory & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? m_alloc->map(dst.buffer) : nullptr;
+  dst.size    = size;
+}
+
+void TlasInstances::release(MappedBuffer& dst)
+{
+  if(dst.size == 0)
+    return;
+  if(dst.data != nullptr)
+    m_alloc->unmap(dst.buffer);
+  m_alloc->destroy(dst.buffer);
+  dst = MappedBuffer{};
+}
+
+void TlasInstances::setBlasAddresses(const std::vector<VkDeviceAddress>& addresses)
+{
+  m_blasAddresses = addresses;
+  reserve(m_blasTable, std::max<size_t>(addresses.size(), 1) * sizeof(VkDeviceAddress),
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, kHostMemory);
+  std::memcpy(m_blasTable.data, addresses.data(), addresses.size() * sizeof(VkDeviceAddress));
+}
+
+//--------------------------------------------------------------------------------------------------
+// CPU path: each task of the pool writes a contiguous range of records with non-temporal stores,
+// fenced before the task returns so the records are complete when the build is submitted
+//
+VkDeviceAddress TlasInstances::write(const glm::mat4* transforms,
+                                     const uint32_t*  blasIds,
+                                     size_t           stride,
+                                     uint32_t         count,
+                                     ThreadPool&      pool)
+{
+  reserve(m_records, std::max(count, 1u) * VkDeviceSize(kStride),
+          VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          kHostMemory);
+
+  auto*                  records   = static_cast<VkAccelerationStructureInstanceKHR*>(m_records.data);
+  const uint8_t*         matrices  = reinterpret_cast<const uint8_t*>(transforms);
+  const uint8_t*         ids       = reinterpret_cast<const uint8_t*>(blasIds);
+  const VkDeviceAddress* addresses = m_blasAddresses.data();
+  const uint32_t         flags     = m_flags;
+  const bool             aligned   = (reinterpret_cast<uintptr_t>(records) & 15) == 0;
+  pool.parallelBatches(count, kBatchSize, [&](size_t begin, size_t end) {
+    for(size_t i = begin; i < end; i++)
+    {
+      const float* m = reinterpret_cast<const float*>(matrices + i * stride);
+      uint32_t     id;
+      std::memcpy(&id, ids + i * stride, sizeof(id));
+      writeRecord(records[i], m, id, addresses[id], flags, aligned);
+    }
+#ifdef TLAS_INSTANCES_SSE
+    _mm_sfence();
+#endif
+  });
+  return m_records.address;
+}
+
+//--------------------------------------------------------------------------------------------------
+// GPU path
+//
+void TlasInstances::writeCompact(const CompactInstance* instances, uint32_t count, ThreadPool& pool)
+{
+  reserve(m_compact, std::max(count, 1u) * VkDeviceSize(sizeof(CompactInstance)), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          kHostMemory);
+
+  auto* dst = static_cast<CompactInstance*>(m_compact.data);
+  pool.parallelBatches(count, kBatchSize, [&](size_t begin, size_t end) {
+    std::memcpy(dst + begin, instances + begin, (end - begin) * sizeof(CompactInstance));
+  });
+}
+
+VkDeviceAddress TlasInstances::cmdExpand(VkCommandBuffer cmdBuf, uint32_t count)
+{
+  reserve(m_deviceRecords, std::max(count, 1u) * VkDeviceSize(kStride),
+          VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+              | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  // A previous build may still read the records
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+  PushConstantInstances pc{};
+  pc.compactAddress = m_compact.address;
+  pc.blasAddresses  = m_blasTable.address;
+  pc.recordAddress  = m_deviceRecords.address;
+  pc.count          = count;
+  pc.flags          = m_flags;
+  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+  for(uint32_t first = 0; first < count; first += kMaxGroups * kWorkgroupSize)
+  {
+    pc.first = first;
+    vkCmdPushConstants(cmdBuf, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    vkCmdDispatch(cmdBuf, std::min(kMaxGroups, (count - first + kWorkgroupSize - 1) / kWorkgroupSize), 1, 1);
+  }
+
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                       &barrier, 0, nullptr, 0, nullptr);
+  return m_deviceRecords.address;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Instances/s of
+// - serial: the former createTopLevelAS loop into a std::vector, plus its copy to the mapped buffer
+// - write: the CPU path, from matrices and BLAS ids
+// - GPU: copy of the compact instances, then expansion (submit and wait)
+//
+void TlasInstances::benchmark(uint32_t maxCount)
+{
+  if(m_blasAddresses.empty())
+    return;
+
+  struct Input
+  {
+    glm::mat4 transform;
+    uint32_t  blasId;
+  };
+  using Clock           = std::chrono::high_resolution_clock;
+  const uint32_t nbBlas = static_cast<uint32_t>(m_blasAddresses.size());
+  ThreadPool&    pool   = ThreadPool::global();
+  LOGI("TLAS instances: %u BLAS, %u threads, %zu bytes per record, %zu per compact instance\n", nbBlas,
+       pool.size() + 1, size_t(kStride), sizeof(CompactInstance));
+  LOGI(" instances  serial Minst/s  write Minst/s  compact Minst/s  expand Minst/s  GPU path Minst/s\n");
+
+  nvvk::CommandPool cmdPool(m_device, m_queueIndex);
+  for(uint32_t count = 10000; count <= maxCount && count > 0; count *= 10)
+  {
+    // Random instances, the same ones as matrices for the CPU paths
+    std::vector<CompactInstance> compact(count);
+    std::vector<Input>           inputs(count);
+    pool.parallelBatches(count, kBatchSize, [&](size_t begin, size_t end) {
+      std::mt19937                          gen(static_cast<uint32_t>(begin));
+      std::normal_distribution<float>       axis(0.f, 1.f);
+      std::uniform_real_distribution<float> position(-100.f, 100.f);
+      std::uniform_real_distribution<float> scale(0.5f, 2.f);
+      for(size_t i = begin; i < end; i++)
+      {
+        CompactInstance& inst = compact[i];
+        inst.rotation         = glm::normalize(glm::vec4(axis(gen), axis(gen), axis(gen), axis(gen)));
+        inst.position         = glm::vec3(position(gen), position(gen), position(gen));
+        inst.scale            = glm::vec3(scale(gen));
+        inst.blasId           = static_cast<uint32_t>(gen() % nbBlas);
+        inst.customIndex      = inst.blasId;
+        inputs[i]             = {compactToMatrix(inst), inst.blasId};
+      }
+    });
+
+    // Buffers allocated outside of the timings
+    reserve(m_records, count * VkDeviceSize(kStride),
+            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            kHostMemory);
+    reserve(m_compact, count * VkDeviceSize(sizeof(CompactInstance)), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, kHostMemory);
+
+    auto startTime = Clock::now();
+    {
+      std::vector<VkAccelerationStructureInstanceKHR> tlas;
+      tlas.reserve(count);
+      for(const Input& input : inputs)
+      {
+        VkAccelerationStructureInstanceKHR rayInst{};
+        rayInst.transform                      = nvvk::toTransformMatrixKHR(input.transform);
+        rayInst.instanceCustomIndex            = input.blasId;
+        rayInst.accelerationStructureReference = m_blasAddresses[input.blasId];
+        rayInst.flags                          = m_flags;
+        rayInst.mask                           = 0xFF;
+        rayInst.instanceShaderBindingTableRecordOffset = 0;
+        tlas.emplace_back(rayInst);
+      }
+      std::memcpy(m_records.data, tlas.data(), tlas.size() * kStride);
+    }
+    const double serial = secondsSince(startTime);
+
+    startTime = Clock::now();
+    write(&inputs[0].transform, &inputs[0].blasId, sizeof(Input), count, pool);
+    const double cpu = secondsSince(startTime);
+
+    startTime = Clock::now();
+    writeCompact(compact.data(), count, pool);
+    const double copy = secondsSince(startTime);
+
+    VkCommandBuffer cmdBuf = cmdPool.createCommandBuffer();
+    cmdExpand(cmdBuf, count);
+    startTime = Clock::now();
+    cmdPool.submitAndWait(cmdBuf);
+    const double expand = secondsSince(startTime);
+
+    LOGI("%10u %15.1f %14.1f %16.1f %15.1f %17.1f\n", count, count / serial * 1e-6, count / cpu * 1e-6,
+         count / copy * 1e-6, count / expand * 1e-6, count / (copy + expand) * 1e-6);
+
+    // The GPU records must match the CPU ones, up to the rounding of the products
+    if(count == 10000)
+    {
+      nvvk::Buffer readback =
+          m_alloc->createBuffer(count * VkDeviceSize(kStride), VK_BUFFER_USAGE_TRANSFER_DST_BIT, kHostMemory);
+      cmdBuf = cmdPool.createCommandBuffer();
+      VkBufferCopy region{0, 0, count * VkDeviceSize(kStride)};
+      vkCmdCopyBuffer(cmdBuf, m_deviceRecords.buffer.buffer, readback.buffer, 1, &region);
+      cmdPool.submitAndWait(cmdBuf);
+
+      const auto* gpu        = static_cast<const VkAccelerationStructureInstanceKHR*>(m_alloc->map(readback));
+      const auto* cpuRecords = mappedRecords();
+      uint32_t    mismatches = 0;
+      for(uint32_t i = 0; i < count; i++)
+      {
+        bool same = std::memcmp(reinterpret_cast<const uint8_t*>(&gpu[i]) + 48,
+                                reinterpret_cast<const uint8_t*>(&cpuRecords[i]) + 48, 16)
+                    == 0;
+        for(int r = 0; r < 3; r++)
+          for(int c = 0; c < 4; c++)
+            same = same && std::abs(gpu[i].transform.matrix[r][c] - cpuRecords[i].transform.matrix[r][c]) < 1e-4f;
+        mismatches += same ? 0 : 1;
+      }
+      m_alloc->unmap(readback);
+      m_alloc->destroy(readback);
+      if(mismatches > 0)
+        LOGE("TLAS instances: %u of %u GPU records differ from the CPU ones\n", mismatches, count);
+    }
+  }
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "nvvk/resourceallocator_vk.hpp"
+#include "shaders/host_device.h"
+#include "thread_pool.h"
+
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Instance records of the TLAS (VkAccelerationStructureInstanceKHR), written where the build reads
+// them instead of going through a std::vector and a staging copy
+// - CPU path: write() converts the transforms on the thread pool, the 4x4 -> 3x4 transposition in
+//   SSE, and streams the records into a host-visible buffer that stays mapped
+// - GPU path: writeCompact() copies the application's CompactInstance array into a mapped buffer,
+//   cmdExpand() dispatches instances.comp which writes the records in device memory, fetching the
+//   BLAS addresses from the table of setBlasAddresses()
+// - The buffers grow to the largest count requested and are reused; the caller must not rewrite
+//   them while a build reading them is in flight
+// - benchmark() measures instances/s of the serial loop and of both paths, 10k to 10M instances
+//
+class TlasInstances
+{
+public:
+  void setup(VkDevice device, nvvk::ResourceAllocator* allocator, uint32_t queueIndex, const std::string& expandSpirv);
+  void destroy();
+
+  // Device address of each BLAS, indexed by the BLAS id of the instances
+  void setBlasAddresses(const std::vector<VkDeviceAddress>& addresses);
+
+  // CPU path: the transform and BLAS id of instance i are `i * stride` bytes after `transforms` and
+  // `blasIds`, so an array of structures is read in place. The BLAS id is also the custom index.
+  // Returns the device address of the records.
+  VkDeviceAddress write(const glm::mat4* transforms,
+                        const uint32_t*  blasIds,
+                        size_t           stride,
+                        uint32_t         count,
+                        ThreadPool&      pool = ThreadPool::global());
+
+  // GPU path: copies the compact instances, then cmdExpand() records the dispatch and the barrier
+  // for the build. Returns the device address of the records.
+  void writeCompact(const CompactInstance* instances, uint32_t count, ThreadPool& pool = ThreadPool::global());
+  VkDeviceAddress cmdExpand(VkCommandBuffer cmdBuf, uint32_t count);
+
+  const VkAccelerationStructureInstanceKHR* mappedRecords() const
+  {
+    return static_cast<const VkAccelerationStructureInstanceKHR*>(m_records.data);
+  }
+
+  // Table of instances/s from 10k to `maxCount` instances, random instances of the BLAS of
+  // setBlasAddresses(). The GPU records are checked against the CPU ones.
+  void benchmark(uint32_t maxCount);
+
+  VkGeometryInstanceFlagsKHR m_flags{VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR};
+
+private:
+  struct MappedBuffer
+  {
+    nvvk::Buffer    buffer;
+    VkDeviceAddress address{0};
+    void*           data{nullptr};  // Null for device-local memory
+    VkDeviceSize    size{0};
+  };
+  void reserve(MappedBuffer& dst, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory);
+  void release(MappedBuffer& dst);
+
+  VkDevice                 m_device{VK_NULL_HANDLE};
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  uint32_t                 m_queueIndex{0};
+  VkPipelineLayout         m_pipelineLayout{VK_NULL_HANDLE};
+  VkPipeline               m_pipeline{VK_NULL_HANDLE};
+
+  std::vector<VkDeviceAddress> m_blasAddresses;
+  MappedBuffer                 m_blasTable;      // Host-visible copy of m_blasAddresses
+  MappedBuffer                 m_records;        // CPU path, host-visible, persistently mapped
+  MappedBuffer                 m_compact;        // GPU path input, host-visible
+  MappedBuffer                 m_deviceRecords;  // GPU path output, device-local
+};
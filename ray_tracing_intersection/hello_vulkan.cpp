@@ -49,6 +49,7 @@ void HelloVulkan::setup(const VkInstance& instance, const VkDevice& device, cons
 {
   AppBaseVk::setup(instance, device, physicalDevice, queueFamily);
   m_alloc.init(instance, device, physicalDevice);
+  m_upload.init(&m_alloc, device, queueFamily);
   m_debug.setup(m_device);
   m_offscreenDepthFormat = nvvk::findDepthFormat(physicalDevice);
 }
@@ -211,20 +212,17 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
   model.nbVertices = static_cast<uint32_t>(loader.m_vertices.size());
 
   // Create the buffers on Device and copy vertices, indices and materials
-  nvvk::CommandPool  cmdBufGet(m_device, m_graphicsQueueIndex);
-  VkCommandBuffer    cmdBuf          = cmdBufGet.createCommandBuffer();
+  // The copies are batched with the following uploads and submitted without waiting, see UploadManager
   VkBufferUsageFlags flag            = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
   VkBufferUsageFlags rayTracingFlags =  // used also for building acceleration structures
       flag | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-  model.vertexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | rayTracingFlags);
-  model.indexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | rayTracingFlags);
-  model.matColorBuffer = m_alloc.createBuffer(cmdBuf, loader.m_materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
-  model.matIndexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_matIndx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
+  model.vertexBuffer   = m_upload.createBuffer(loader.m_vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | rayTracingFlags);
+  model.indexBuffer    = m_upload.createBuffer(loader.m_indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | rayTracingFlags);
+  model.matColorBuffer = m_upload.createBuffer(loader.m_materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
+  model.matIndexBuffer = m_upload.createBuffer(loader.m_matIndx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
   // Creates all textures found and find the offset for this model
   auto txtOffset = static_cast<uint32_t>(m_textures.size());
-  createTextureImages(cmdBuf, loader.m_textures);
-  cmdBufGet.submitAndWait(cmdBuf);
-  m_alloc.finalizeAndReleaseStaging();
+  createTextureImages(loader.m_textures);
 
   std::string objNb = std::to_string(m_objModel.size());
   m_debug.setObjectName(model.vertexBuffer.buffer, (std::string("vertex_" + objNb)));
@@ -271,19 +269,18 @@ void HelloVulkan::createUniformBuffer()
 //
 void HelloVulkan::createObjDescriptionBuffer()
 {
-  nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
-
-  auto cmdBuf = cmdGen.createCommandBuffer();
-  m_bObjDesc  = m_alloc.createBuffer(cmdBuf, m_objDesc, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-  cmdGen.submitAndWait(cmdBuf);
-  m_alloc.finalizeAndReleaseStaging();
+  // Last upload of the scene: the pending batch is submitted and all uploads are waited for once
+  m_bObjDesc = m_upload.createBuffer(m_objDesc, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_upload.waitIdle();
   m_debug.setObjectName(m_bObjDesc.buffer, "ObjDescs");
+  LOGI(" Uploads: %zu models, %.1f MB in %u queue submissions\n", m_objModel.size(),
+       m_upload.uploadedBytes() / (1024.0 * 1024.0), m_upload.submitCount());
 }
 
 //--------------------------------------------------------------------------------------------------
 // Creating all textures and samplers
 //
-void HelloVulkan::createTextureImages(const VkCommandBuffer& cmdBuf, const std::vector<std::string>& textures)
+void HelloVulkan::createTextureImages(const std::vector<std::string>& textures)
 {
   VkSamplerCreateInfo samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
   samplerCreateInfo.minFilter  = VK_FILTER_LINEAR;
@@ -304,12 +301,13 @@ void HelloVulkan::createTextureImages(const VkCommandBuffer& cmdBuf, const std::
     auto                   imageCreateInfo = nvvk::makeImage2DCreateInfo(imgSize, format);
 
     // Creating the dummy texture
-    nvvk::Image           image  = m_alloc.createImage(cmdBuf, bufferSize, color.data(), imageCreateInfo);
+    nvvk::Image           image  = m_upload.createImage(imageCreateInfo, bufferSize, color.data());
     VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
     texture                      = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
 
     // The image format must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-    nvvk::cmdBarrierImageLayout(cmdBuf, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    nvvk::cmdBarrierImageLayout(m_upload.commandBuffer(), texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     m_textures.push_back(texture);
   }
   else
@@ -340,8 +338,9 @@ void HelloVulkan::createTextureImages(const VkCommandBuffer& cmdBuf, const std::
       auto         imageCreateInfo = nvvk::makeImage2DCreateInfo(imgSize, format, VK_IMAGE_USAGE_SAMPLED_BIT, true);
 
       {
-        nvvk::Image image = m_alloc.createImage(cmdBuf, bufferSize, pixels, imageCreateInfo);
-        nvvk::cmdGenerateMipmaps(cmdBuf, image.image, format, imgSize, imageCreateInfo.mipLevels);
+        nvvk::Image image = m_upload.createImage(imageCreateInfo, bufferSize, pixels);
+        nvvk::cmdGenerateMipmaps(m_upload.commandBuffer(), image.image, format, imgSize, imageCreateInfo.mipLevels, 1,
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
         VkImageViewCreateInfo ivInfo  = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
         nvvk::Texture         texture = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
 
@@ -403,6 +402,7 @@ void HelloVulkan::destroyResources()
   m_alloc.destroy(m_spheresMatColorBuffer);
   m_alloc.destroy(m_spheresMatIndexBuffer);
 
+  m_upload.deinit();
   m_alloc.deinit();
 }
 
@@ -729,19 +729,14 @@ void HelloVulkan::createSpheres(uint32_t nbSpheres)
     matIdx[i] = i % 2;
   }
 
-  // Creating all buffers
-  using vkBU = VkBufferUsageFlagBits;
-  nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
-  auto              cmdBuf = genCmdBuf.createCommandBuffer();
-  m_spheresBuffer          = m_alloc.createBuffer(cmdBuf, m_spheres, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-  m_spheresAabbBuffer      = m_alloc.createBuffer(cmdBuf, aabbs,
-                                                  VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
-                                                      | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+  // Creating all buffers, in the same upload batches as the models
+  m_spheresBuffer     = m_upload.createBuffer(m_spheres, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_spheresAabbBuffer = m_upload.createBuffer(aabbs, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+                                                         | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
   m_spheresMatIndexBuffer =
-      m_alloc.createBuffer(cmdBuf, matIdx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+      m_upload.createBuffer(matIdx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
   m_spheresMatColorBuffer =
-      m_alloc.createBuffer(cmdBuf, materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
-  genCmdBuf.submitAndWait(cmdBuf);
+      m_upload.createBuffer(materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
 
   // Debug information
   m_debug.setObjectName(m_spheresBuffer.buffer, "spheres");
@@ -28,6 +28,7 @@
 
 // #VKRay
 #include "nvvk/raytraceKHR_vk.hpp"
+#include "upload_manager.h"
 
 //--------------------------------------------------------------------------------------------------
 // Simple rasterizer of OBJ objects
@@ -46,7 +47,7 @@ public:
   void updateDescriptorSet();
   void createUniformBuffer();
   void createObjDescriptionBuffer();
-  void createTextureImages(const VkCommandBuffer& cmdBuf, const std::vector<std::string>& textures);
+  void createTextureImages(const std::vector<std::string>& textures);
   void updateUniformBuffer(const VkCommandBuffer& cmdBuf);
   void onResize(int /*w*/, int /*h*/) override;
   void destroyResources();
@@ -99,8 +100,9 @@ public:
   std::vector<nvvk::Texture> m_textures;  // vector of all textures of the scene
 
 
-  nvvk::ResourceAllocatorDma m_alloc;  // Allocator for buffer, images, acceleration structures
-  nvvk::DebugUtil            m_debug;  // Utility to name objects
+  nvvk::ResourceAllocatorDma m_alloc;   // Allocator for buffer, images, acceleration structures
+  UploadManager              m_upload;  // Batched uploads of the models and spheres
+  nvvk::DebugUtil            m_debug;   // Utility to name objects
 
 
   // #Post - Draw the rendered image on a quad using a tonemapper
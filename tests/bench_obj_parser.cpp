@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "obj_loader.h"
+#include "obj_parser.h"
+#include "test_utils.h"
+
+#include <cmath>
+#include <cstring>
+
+//--------------------------------------------------------------------------------------------------
+// MB/s of the multithreaded ObjParser against tinyobj::ObjReader on a generated OBJ of about the
+// given size (default 256 MB): a grid of quads with positions, texture coordinates and normals.
+// ObjLoader is then run on both paths and must give the same vertices and indices.
+//
+// Usage: bench_obj_parser [MB]
+//
+
+int main(int argc, char** argv)
+{
+  const double sizeMB   = argc > 1 ? std::stod(argv[1]) : 256.0;
+  const auto   n        = static_cast<uint32_t>(std::sqrt(sizeMB * 1024.0 * 1024.0 / 150.0)) + 1;
+  std::string  filename = testDirectory() + "/bench_grid.obj";
+
+  auto start = std::chrono::high_resolution_clock::now();
+  writeGridObj(filename, n);
+  const double fileMB = static_cast<double>(std::filesystem::file_size(filename)) / (1024.0 * 1024.0);
+  printf("Generated %s: %.1f MB, %u quads in %.0f ms\n", filename.c_str(), fileMB, n * n, elapsedMs(start));
+
+  // Parsing only, without the conversion to VertexObj done by ObjLoader in both cases
+  start = std::chrono::high_resolution_clock::now();
+  tinyobj::ObjReader reader;
+  reader.ParseFromFile(filename);
+  const double tinyobjMs = elapsedMs(start);
+  CHECK(reader.Valid());
+
+  for(uint32_t threads = 1;; threads = ThreadPool::global().size())
+  {
+    ThreadPool pool(threads);
+    ObjParser  parser;
+    start          = std::chrono::high_resolution_clock::now();
+    bool   parsed  = parser.parse(filename, pool);
+    double parseMs = elapsedMs(start);
+    CHECK(parsed);
+    CHECK(parser.m_indices.size() == size_t(n) * n * 6);
+    printf("ObjParser, %2u threads: %8.1f ms, %7.1f MB/s\n", threads, parseMs, fileMB / (parseMs / 1000.0));
+    if(threads == ThreadPool::global().size())
+      break;
+  }
+  printf("tinyobj::ObjReader:     %8.1f ms, %7.1f MB/s\n", tinyobjMs, fileMB / (tinyobjMs / 1000.0));
+
+  // Same result through ObjLoader, without the processing after the parse
+  ObjLoader loaders[2];
+  for(int i = 0; i < 2; i++)
+  {
+    loaders[i].m_parallelParse = i == 1;
+    loaders[i].m_weld          = false;
+    loaders[i].m_optimize      = false;
+    loaders[i].m_useCache      = false;
+    loaders[i].loadModel(filename);
+  }
+  CHECK(loaders[0].m_vertices.size() == loaders[1].m_vertices.size());
+  CHECK(loaders[0].m_indices == loaders[1].m_indices);
+  CHECK(loaders[0].m_matIndx == loaders[1].m_matIndx);
+  if(loaders[0].m_vertices.size() == loaders[1].m_vertices.size())
+  {
+    CHECK(memcmp(loaders[0].m_vertices.data(), loaders[1].m_vertices.data(),
+                 loaders[0].m_vertices.size() * sizeof(VertexObj))
+          == 0);
+  }
+
+  std::filesystem::remove(filename);
+  return testResult();
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include "glb_import.h"
+#include "test_utils.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Writes a .glb of one triangle with POSITION (3 vertices), NORMAL and TEXCOORD_0 accessors of the
+// given counts, each view holding exactly its accessor
+//
+static void writeTriangleGlb(const std::string& filename, uint32_t normalCount, uint32_t uvCount)
+{
+  const uint32_t     positionBytes = 3 * 12;
+  const uint32_t     normalBytes   = normalCount * 12;
+  const uint32_t     uvBytes       = uvCount * 8;
+  std::vector<float> bin((positionBytes + normalBytes + uvBytes) / sizeof(float), 0.f);
+  const float        positions[9] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+  memcpy(bin.data(), positions, sizeof(positions));
+
+  char json[1024];
+  int  jsonSize = snprintf(
+      json, sizeof(json),
+      R"({"asset":{"version":"2.0"},"scene":0,"scenes":[{"nodes":[0]}],"nodes":[{"mesh":0}],)"
+      R"("meshes":[{"primitives":[{"attributes":{"POSITION":0,"NORMAL":1,"TEXCOORD_0":2}}]}],)"
+      R"("buffers":[{"byteLength":%u}],"bufferViews":[{"buffer":0,"byteOffset":0,"byteLength":%u},)"
+      R"({"buffer":0,"byteOffset":%u,"byteLength":%u},{"buffer":0,"byteOffset":%u,"byteLength":%u}],)"
+      R"("accessors":[{"bufferView":0,"componentType":5126,"count":3,"type":"VEC3"},)"
+      R"({"bufferView":1,"componentType":5126,"count":%u,"type":"VEC3"},)"
+      R"({"bufferView":2,"componentType":5126,"count":%u,"type":"VEC2"}]})",
+      positionBytes + normalBytes + uvBytes, positionBytes, positionBytes, normalBytes, positionBytes + normalBytes,
+      uvBytes, normalCount, uvCount);
+  const uint32_t jsonChunk   = (static_cast<uint32_t>(jsonSize) + 3) & ~3u;  // Padded with spaces
+  const uint32_t binChunk    = static_cast<uint32_t>(bin.size() * sizeof(float));
+  const uint32_t header[3]   = {0x46546C67, 2, 12 + 8 + jsonChunk + 8 + binChunk};  // "glTF", version, length
+  const uint32_t jsonHead[2] = {jsonChunk, 0x4E4F534A};                            // "JSON"
+  const uint32_t binHead[2]  = {binChunk, 0x004E4942};                             // "BIN"
+
+  std::ofstream out(filename, std::ios::binary);
+  out.write(reinterpret_cast<const char*>(header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(jsonHead), sizeof(jsonHead));
+  out.write(json, jsonSize);
+  out.write("   ", jsonChunk - jsonSize);
+  out.write(reinterpret_cast<const char*>(binHead), sizeof(binHead));
+  out.write(reinterpret_cast<const char*>(bin.data()), binChunk);
+}
+
+//--------------------------------------------------------------------------------------------------
+// GlbImport::load on generated files: a NORMAL or TEXCOORD_0 accessor with fewer elements than
+// POSITION is rejected (the loader falls back to tinygltf) instead of being read past its range
+//
+int main()
+{
+  const std::string filename = testDirectory() + "/triangle.glb";
+
+  // Valid file: the attributes of the 3 vertices point in the mapping
+  {
+    writeTriangleGlb(filename, 3, 3);
+    GlbImport       glb;
+    tinygltf::Model tmodel;
+    nvh::GltfScene  scene;
+    CHECK(glb.load(filename, tmodel, scene));
+    CHECK(scene.m_primMeshes.size() == 1 && scene.m_primMeshes[0].vertexCount == 3);
+    CHECK(glb.totalSize(GlbImport::ePositions) == 3 * 3 * sizeof(float));
+    CHECK(glb.totalSize(GlbImport::eNormals) == 3 * 3 * sizeof(float));
+    CHECK(glb.totalSize(GlbImport::eTexcoords) == 3 * 2 * sizeof(float));
+  }
+
+  // Short NORMAL, then short TEXCOORD_0: rejected, the scene is untouched
+  const uint32_t counts[2][2] = {{2, 3}, {3, 2}};
+  for(const auto& count : counts)
+  {
+    writeTriangleGlb(filename, count[0], count[1]);
+    GlbImport       glb;
+    tinygltf::Model tmodel;
+    nvh::GltfScene  scene;
+    CHECK(!glb.load(filename, tmodel, scene));
+    CHECK(scene.m_primMeshes.empty() && scene.m_nodes.empty());
+  }
+
+  std::filesystem::remove(filename);
+  return testResult();
+}
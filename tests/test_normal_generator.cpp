@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "normal_generator.h"
+#include "test_utils.h"
+
+#include <map>
+#include <random>
+#include <tuple>
+
+//--------------------------------------------------------------------------------------------------
+// NormalGenerator against scalar references:
+// - faceData() (SSE) against faceDataScalar(), on ranges not multiple of 4
+// - Flat normals are the face normals
+// - Smooth normals, area and angle weighted, against a naive reduction over all the corners
+//   sharing a position, for several crease angles and thread counts
+// The positions are on a coarse lattice, so many corners share positions and some triangles are
+// degenerate.
+//
+
+static bool nearlyEqual(const glm::vec3& a, const glm::vec3& b, float epsilon)
+{
+  return glm::length(a - b) <= epsilon;
+}
+
+static bool nearlyEqual(float a, float b, float epsilon)
+{
+  return std::fabs(a - b) <= epsilon * std::max(1.f, std::fabs(b));
+}
+
+// Normal of each corner: sum of the weighted face normals of the corners at the same position,
+// within the crease angle of the corner's face
+static std::vector<glm::vec3> referenceSmooth(const std::vector<VertexObj>& vertices,
+                                              const std::vector<uint32_t>&  indices,
+                                              bool                          angleWeighted,
+                                              float                         creaseAngle)
+{
+  const size_t                           nbFaces = indices.size() / 3;
+  std::vector<NormalGenerator::FaceData> faces(nbFaces);
+  NormalGenerator::faceDataScalar(vertices, indices, 0, nbFaces, faces.data());
+
+  std::map<std::tuple<float, float, float>, std::vector<uint32_t>> cornersAt;
+  for(uint32_t c = 0; c < indices.size(); c++)
+  {
+    const glm::vec3& p = vertices[indices[c]].pos;
+    cornersAt[{p.x, p.y, p.z}].push_back(c);
+  }
+
+  const float            cosCrease = std::cos(glm::radians(creaseAngle));
+  std::vector<glm::vec3> normals(indices.size());
+  for(const auto& entry : cornersAt)
+  {
+    for(uint32_t c : entry.second)
+    {
+      const NormalGenerator::FaceData& face = faces[c / 3];
+      glm::vec3                        sum(0.f);
+      for(uint32_t d : entry.second)
+      {
+        const NormalGenerator::FaceData& other = faces[d / 3];
+        if(d == c || glm::dot(other.normal, face.normal) >= cosCrease)
+          sum += other.normal * (angleWeighted ? other.angle[d % 3] : other.area2);
+      }
+      float length = glm::length(sum);
+      normals[c]   = length > 0.f ? sum / length : face.normal;
+    }
+  }
+  return normals;
+}
+
+int main()
+{
+  // Random triangles on a lattice, one vertex per corner as the loaders emit them
+  std::mt19937                       rng(3);
+  std::uniform_int_distribution<int> coord(0, 6);
+  std::vector<VertexObj>             vertices;
+  std::vector<uint32_t>              indices;
+  for(uint32_t c = 0; c < 3 * 30001; c++)
+  {
+    VertexObj v{};
+    v.pos = glm::vec3(float(coord(rng)), float(coord(rng)), float(coord(rng)) * 0.5f);
+    indices.push_back(static_cast<uint32_t>(vertices.size()));
+    vertices.push_back(v);
+  }
+  const size_t nbFaces = indices.size() / 3;
+
+  // SIMD face data, on a range whose start and length are not multiples of 4
+  {
+    const size_t                           begin = 1, end = nbFaces - 2;
+    std::vector<NormalGenerator::FaceData> simd(nbFaces), scalar(nbFaces);
+    NormalGenerator::faceData(vertices, indices, begin, end, simd.data());
+    NormalGenerator::faceDataScalar(vertices, indices, begin, end, scalar.data());
+    size_t mismatches = 0;
+    for(size_t f = 0; f < end - begin; f++)
+    {
+      bool same = nearlyEqual(simd[f].normal, scalar[f].normal, 1e-5f);
+      same      = same && nearlyEqual(simd[f].area2, scalar[f].area2, 1e-5f);
+      for(int k = 0; k < 3; k++)
+        same = same && nearlyEqual(simd[f].angle[k], scalar[f].angle[k], 1e-5f);
+      mismatches += same ? 0 : 1;
+    }
+    printf("faceData: %zu of %zu triangles differ from faceDataScalar\n", mismatches, end - begin);
+    CHECK(mismatches == 0);
+  }
+
+  // Flat: the face normal on the three corners
+  {
+    std::vector<VertexObj> flat = vertices;
+    NormalGenerator::generate(flat, indices, NormalMode::eFlat);
+    std::vector<NormalGenerator::FaceData> faces(nbFaces);
+    NormalGenerator::faceDataScalar(vertices, indices, 0, nbFaces, faces.data());
+    size_t mismatches = 0;
+    for(size_t c = 0; c < indices.size(); c++)
+      mismatches += nearlyEqual(flat[indices[c]].nrm, faces[c / 3].normal, 1e-5f) ? 0 : 1;
+    printf("flat: %zu of %zu corners differ\n", mismatches, indices.size());
+    CHECK(mismatches == 0);
+  }
+
+  // Smooth
+  for(NormalMode mode : {NormalMode::eSmoothArea, NormalMode::eSmoothAngle})
+  {
+    for(float crease : {30.f, 60.f, 180.f})
+    {
+      const bool                   angleWeighted = mode == NormalMode::eSmoothAngle;
+      const std::vector<glm::vec3> reference     = referenceSmooth(vertices, indices, angleWeighted, crease);
+      for(uint32_t threads : {1u, 3u})
+      {
+        ThreadPool             pool(threads);
+        std::vector<VertexObj> smooth = vertices;
+        NormalGenerator::generate(smooth, indices, mode, crease, pool);
+        float maxError = 0.f;
+        for(size_t c = 0; c < indices.size(); c++)
+          maxError = std::max(maxError, glm::length(smooth[indices[c]].nrm - reference[c]));
+        printf("%s, crease %3.0f, %u threads: max difference %g\n", angleWeighted ? "angle" : "area ", crease,
+               threads, maxError);
+        CHECK(maxError <= 1e-4f);
+      }
+    }
+  }
+
+  return testResult();
+}
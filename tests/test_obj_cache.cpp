@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "obj_cache.h"
+#include "test_utils.h"
+
+#include <cstring>
+#include <fstream>
+
+//--------------------------------------------------------------------------------------------------
+// ObjCache: a warm load gives the result of the cold load, and a cache that does not match its
+// sources or is corrupt is rejected, the load then parses the OBJ again
+//
+
+static void writeFile(const std::string& filename, const std::string& text)
+{
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  out << text;
+}
+
+static std::string readFile(const std::string& filename)
+{
+  std::ifstream in(filename, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeScene(const std::string& dir)
+{
+  writeFile(dir + "/cache_test.obj",
+            "mtllib cache_test.mtl\n"
+            "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+            "usemtl red\n"
+            "f 1 2 3 4\n");
+  writeFile(dir + "/cache_test.mtl",
+            "newmtl red\n"
+            "Kd 0.8 0.1 0.1\n"
+            "map_Kd red.png\n");
+}
+
+static void load(const std::string& filename, ObjLoader& loader)
+{
+  loader.m_useCache = true;
+  loader.loadModel(filename);
+}
+
+static bool sameResult(const ObjLoader& a, const ObjLoader& b)
+{
+  return a.m_vertices.size() == b.m_vertices.size()
+         && memcmp(a.m_vertices.data(), b.m_vertices.data(), a.m_vertices.size() * sizeof(VertexObj)) == 0
+         && a.m_indices == b.m_indices && a.m_matIndx == b.m_matIndx && a.m_textures == b.m_textures
+         && a.m_materials.size() == b.m_materials.size()
+         && memcmp(a.m_materials.data(), b.m_materials.data(), a.m_materials.size() * sizeof(MaterialObj)) == 0;
+}
+
+int main()
+{
+  const std::string dir       = testDirectory();
+  const std::string filename  = dir + "/cache_test.obj";
+  const std::string cacheName = ObjCache::cacheFilename(filename);
+  writeScene(dir);
+  std::filesystem::remove(cacheName);
+
+  // Cold load writes the cache, the warm load reads it
+  ObjLoader cold;
+  load(filename, cold);
+  CHECK(std::filesystem::exists(cacheName));
+  CHECK(cold.m_textures.size() == 1 && cold.m_textures[0] == "red.png");
+  ObjLoader warm;
+  load(filename, warm);
+  CHECK(sameResult(cold, warm));
+
+  // Texture names section without its terminating null: rejected, not read past the section
+  {
+    std::string cache = readFile(cacheName);
+    size_t      pos   = cache.find(std::string("red.png") + '\0');
+    CHECK(pos != std::string::npos);
+    if(pos != std::string::npos)
+    {
+      cache[pos + 7] = 'x';
+      writeFile(cacheName, cache);
+      ObjLoader corrupt;
+      load(filename, corrupt);
+      CHECK(sameResult(cold, corrupt));
+    }
+  }
+
+  // Edited MTL: the warm load must not return the old materials and texture names
+  {
+    const std::string mtlName = dir + "/cache_test.mtl";
+    auto              time    = std::filesystem::last_write_time(mtlName);
+    writeFile(mtlName,
+              "newmtl red\n"
+              "Kd 0.1 0.8 0.1\n"
+              "map_Kd green.png\n");
+    std::filesystem::last_write_time(mtlName, time + std::chrono::seconds(2));
+    ObjLoader edited;
+    load(filename, edited);
+    CHECK(edited.m_textures.size() == 1 && edited.m_textures[0] == "green.png");
+    CHECK(!edited.m_materials.empty() && edited.m_materials[0].diffuse.y == 0.8f);
+
+    // The cache written by that load is then used
+    ObjLoader warmEdited;
+    load(filename, warmEdited);
+    CHECK(sameResult(edited, warmEdited));
+    writeScene(dir);
+    ObjLoader restored;
+    load(filename, restored);
+    CHECK(sameResult(cold, restored));
+  }
+
+  // Streaming load: the cache of the regular load is not used, the streaming one writes its own
+  {
+    const std::string regularCache = readFile(cacheName);
+    ObjLoader         streaming;
+    streaming.m_streamWindow = 1024 * 1024;
+    load(filename, streaming);
+    const std::string streamingCache = readFile(cacheName);
+    CHECK(streamingCache != regularCache);
+    ObjLoader warmStreaming;
+    warmStreaming.m_streamWindow = 1024 * 1024;
+    load(filename, warmStreaming);
+    CHECK(sameResult(streaming, warmStreaming));
+    CHECK(readFile(cacheName) == streamingCache);
+    ObjLoader regular;
+    load(filename, regular);
+    CHECK(sameResult(cold, regular));
+  }
+
+  // Truncated cache: rejected
+  {
+    std::string cache = readFile(cacheName);
+    writeFile(cacheName, cache.substr(0, cache.size() / 2));
+    ObjLoader truncated;
+    load(filename, truncated);
+    CHECK(sameResult(cold, truncated));
+  }
+
+  std::filesystem::remove(cacheName);
+  return testResult();
+}
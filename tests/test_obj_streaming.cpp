@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "obj_parser.h"
+#include "test_utils.h"
+
+#include <cstring>
+
+//--------------------------------------------------------------------------------------------------
+// ObjParser::parseStreaming on a generated OBJ of about the given size (default 32 MB), read in
+// windows of 1 MB:
+// - The peak it reports is bounded by the window, the attributes read and the final mesh, with the
+//   growth of the vectors and the weld map, and stays below what the parallel parse holds (the
+//   whole text and one vertex per face corner)
+// - It gives the same triangles, in the same order, as the parallel parse
+//
+// Usage: test_obj_streaming [MB]
+//
+int main(int argc, char** argv)
+{
+  const double sizeMB     = argc > 1 ? std::stod(argv[1]) : 32.0;
+  const size_t windowSize = 1024 * 1024;
+  const auto   n          = static_cast<uint32_t>(std::sqrt(sizeMB * 1024.0 * 1024.0 / 150.0)) + 1;
+  std::string  filename   = testDirectory() + "/streaming_grid.obj";
+  writeGridObj(filename, n);
+  const size_t fileBytes = std::filesystem::file_size(filename);
+
+  ObjParser streaming;
+  CHECK(streaming.parseStreaming(filename, windowSize));
+  ObjParser parallel;
+  CHECK(parallel.parse(filename));
+  std::filesystem::remove(filename);
+
+  // Peak against the budget
+  const size_t nbAttributes   = size_t(n + 1) * (n + 1);  // Each of v, vt, vn
+  const size_t attributeBytes = nbAttributes * (3 + 3 + 2 + 3) * sizeof(float);  // Positions, colors, uv, normals
+  const size_t indexBytes     = (streaming.m_indices.size() + streaming.m_matIndx.size()) * sizeof(uint32_t);
+  const size_t meshBytes      = streaming.m_vertices.size() * sizeof(VertexObj) + indexBytes;
+  const size_t weldMapBytes   = streaming.m_vertices.size() * (sizeof(int32_t) * 4 + 3 * sizeof(void*));
+  const size_t budget         = 3 * windowSize + 2 * (attributeBytes + meshBytes + weldMapBytes);
+  const size_t expanded       = fileBytes + parallel.m_vertices.size() * sizeof(VertexObj);
+  printf("%.1f MB, %zu triangles: streaming peak %.1f MB, budget %.1f MB, parallel parse holds %.1f MB\n",
+         fileBytes / (1024.0 * 1024.0), streaming.m_indices.size() / 3, streaming.m_peakBytes / (1024.0 * 1024.0),
+         budget / (1024.0 * 1024.0), expanded / (1024.0 * 1024.0));
+  CHECK(streaming.m_peakBytes > 0);
+  CHECK(streaming.m_peakBytes <= budget);
+  CHECK(streaming.m_peakBytes < expanded);
+
+  // Welded on (v, vt, vn): one vertex per grid point
+  CHECK(streaming.m_welded);
+  CHECK(streaming.m_vertices.size() == nbAttributes);
+
+  // Same triangles: each corner of the streaming result is the vertex of the same parallel corner
+  CHECK(streaming.m_indices.size() == parallel.m_indices.size());
+  CHECK(streaming.m_matIndx == parallel.m_matIndx);
+  size_t mismatches = 0;
+  for(size_t c = 0; c < std::min(streaming.m_indices.size(), parallel.m_indices.size()); c++)
+  {
+    const VertexObj& a = streaming.m_vertices[streaming.m_indices[c]];
+    const VertexObj& b = parallel.m_vertices[parallel.m_indices[c]];
+    mismatches += memcmp(&a, &b, sizeof(VertexObj)) != 0 ? 1 : 0;
+  }
+  CHECK(mismatches == 0);
+
+  return testResult();
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "geometry_pool.h"
+#include "obj_loader.h"
+#include "test_utils.h"
+#include "upload_manager.h"
+
+#include "nvvk/context_vk.hpp"
+#include "nvvk/memallocator_dma_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include <cstring>
+
+//--------------------------------------------------------------------------------------------------
+// The scene loading of ray_tracing_instances on 2000 distinct generated OBJ files: each model is
+// loaded with ObjLoader and appended to a GeometryPool through one UploadManager, as loadModel()
+// does (files are all different, so nothing is shared by the model registry).
+// - The ring is small (1 MB, batches of 256 KB): it wraps many times, the CPU waits when it is full
+//   and the GPU is behind, and every 500th model has more vertices than the ring holds (temporary
+//   staging)
+// - The number of queue submissions is bounded by the bytes uploaded over the batch size, below one
+//   per model
+// - The streams read back from the GPU equal the concatenation of the loaded models
+// Skipped (exit code 77) without a Vulkan 1.2 device supporting acceleration structures.
+//
+// Usage: test_upload_manager [models]
+//
+int main(int argc, char** argv)
+{
+  const uint32_t     nbModels   = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 2000u;
+  const VkDeviceSize ringSize   = 1024 * 1024;
+  const VkDeviceSize batchBytes = 256 * 1024;
+
+  // Headless: the buffers of the pool are acceleration structure build inputs
+  nvvk::ContextCreateInfo                          contextInfo;
+  VkPhysicalDeviceAccelerationStructureFeaturesKHR accelFeature{};
+  accelFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+  contextInfo.setVersion(1, 2);
+  contextInfo.addDeviceExtension(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, false, &accelFeature);
+  contextInfo.addDeviceExtension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
+
+  nvvk::Context vkctx{};
+  if(!vkctx.initInstance(contextInfo))
+  {
+    printf("No Vulkan 1.2 instance: skipped\n");
+    return 77;
+  }
+  auto compatibleDevices = vkctx.getCompatibleDevices(contextInfo);
+  if(compatibleDevices.empty() || !vkctx.initDevice(compatibleDevices[0], contextInfo))
+  {
+    printf("No compatible device: skipped\n");
+    vkctx.deinit();
+    return 77;
+  }
+
+  nvvk::ResourceAllocatorDma alloc;
+  alloc.init(vkctx.m_instance, vkctx.m_device, vkctx.m_physicalDevice);
+  UploadManager upload;
+  upload.init(&alloc, vkctx.m_device, vkctx.m_queueGCT.familyIndex, ringSize, batchBytes);
+  GeometryPool geometry;
+  geometry.init(&alloc, vkctx.m_device, &upload);
+
+  // Generated models: grids of 2x2 to 14x14 quads, and of 180x180 quads (1.4 MB of vertices)
+  const std::string directory = testDirectory() + "/upload";
+  std::filesystem::create_directories(directory);
+  std::vector<VertexObj> expectedVertices;
+  std::vector<uint32_t>  expectedIndices;
+  std::vector<uint32_t>  expectedMatIndx;
+  uint32_t               largeModels = 0;
+  auto                   start       = std::chrono::high_resolution_clock::now();
+  for(uint32_t i = 0; i < nbModels; i++)
+  {
+    const bool        large    = i % 500 == 499;
+    const std::string filename = directory + "/model_" + std::to_string(i) + ".obj";
+    writeGridObj(filename, large ? 180 : 2 + i % 13);
+
+    ObjLoader loader;
+    loader.m_useCache = false;
+    loader.loadModel(filename);
+    std::filesystem::remove(filename);
+    if(large)
+      largeModels += sizeof(VertexObj) * loader.m_vertices.size() > ringSize ? 1 : 0;
+
+    CHECK(geometry.add(GeometryPool::eVertices, loader.m_vertices) == expectedVertices.size());
+    CHECK(geometry.add(GeometryPool::eIndices, loader.m_indices) == expectedIndices.size());
+    geometry.add(GeometryPool::eMaterials, loader.m_materials);
+    CHECK(geometry.add(GeometryPool::eMaterialIndices, loader.m_matIndx) == expectedMatIndx.size());
+    expectedVertices.insert(expectedVertices.end(), loader.m_vertices.begin(), loader.m_vertices.end());
+    expectedIndices.insert(expectedIndices.end(), loader.m_indices.begin(), loader.m_indices.end());
+    expectedMatIndx.insert(expectedMatIndx.end(), loader.m_matIndx.begin(), loader.m_matIndx.end());
+  }
+  upload.waitIdle();
+  const double loadMs = elapsedMs(start);
+
+  // Each submission holds a full batch, except the last one and, at most once per large model, a batch
+  // submitted early because its indices (780 KB) did not fit beside it in the ring
+  const uint32_t submitBound = static_cast<uint32_t>(upload.uploadedBytes() / batchBytes) + 1 + largeModels;
+  printf("%u models: %.1f MB in %u queue submissions (bound %u), %u geometry allocations, %.2f ms\n", nbModels,
+         upload.uploadedBytes() / (1024.0 * 1024.0), upload.submitCount(), submitBound, geometry.allocationCount(),
+         loadMs);
+  CHECK(largeModels == nbModels / 500);
+  CHECK(upload.uploadedBytes() > 8 * ringSize);  // The ring wrapped
+  CHECK(upload.submitCount() <= submitBound);
+  CHECK(upload.submitCount() < nbModels);
+
+  // Streams read back after all uploads, through the same batches
+  auto readBack = [&](GeometryPool::Stream stream, const void* expected, size_t expectedBytes) {
+    const VkDeviceSize size = geometry.size(stream);
+    CHECK(size == expectedBytes);
+    if(size == 0 || size != expectedBytes)
+      return;
+
+    const VkMemoryPropertyFlags hostFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    nvvk::Buffer                readback  = alloc.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostFlags);
+    VkCommandBuffer cmdBuf = upload.commandBuffer();
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+    VkBufferCopy region{0, 0, size};
+    vkCmdCopyBuffer(cmdBuf, geometry.buffer(stream).buffer, readback.buffer, 1, &region);
+    upload.waitIdle();
+
+    const void* data = alloc.map(readback);
+    CHECK(memcmp(data, expected, size) == 0);
+    alloc.unmap(readback);
+    alloc.destroy(readback);
+  };
+  readBack(GeometryPool::eVertices, expectedVertices.data(), sizeof(VertexObj) * expectedVertices.size());
+  readBack(GeometryPool::eIndices, expectedIndices.data(), sizeof(uint32_t) * expectedIndices.size());
+  readBack(GeometryPool::eMaterialIndices, expectedMatIndx.data(), sizeof(uint32_t) * expectedMatIndx.size());
+
+  geometry.deinit();
+  upload.deinit();
+  alloc.deinit();
+  vkctx.deinit();
+  return testResult();
+}
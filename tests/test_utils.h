@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdio.h>
+#include <string>
+
+//--------------------------------------------------------------------------------------------------
+// Minimal checks for the tests: a failed CHECK is reported and the test exits with failure from
+// testResult(), after running the remaining checks
+//
+inline int g_testFailures = 0;
+
+#define CHECK(cond)                                                                                                    \
+  do                                                                                                                   \
+  {                                                                                                                    \
+    if(!(cond))                                                                                                        \
+    {                                                                                                                  \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);                                         \
+      g_testFailures++;                                                                                                \
+    }                                                                                                                  \
+  } while(0)
+
+inline int testResult()
+{
+  if(g_testFailures > 0)
+    fprintf(stderr, "%d check(s) failed\n", g_testFailures);
+  else
+    printf("All checks passed\n");
+  return g_testFailures > 0 ? 1 : 0;
+}
+
+// Directory for the generated inputs, created in the working directory of the test
+inline std::string testDirectory()
+{
+  std::filesystem::path dir = std::filesystem::current_path() / "test_data";
+  std::filesystem::create_directories(dir);
+  return dir.string();
+}
+
+inline double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// OBJ grid of (n+1)^2 vertices with texture coordinates and normals, and n^2 quads: about 150 bytes
+// per quad
+inline void writeGridObj(const std::string& filename, uint32_t n)
+{
+  std::ofstream out(filename, std::ios::binary);
+  char          line[256];
+  for(uint32_t y = 0; y <= n; y++)
+  {
+    for(uint32_t x = 0; x <= n; x++)
+    {
+      float u = static_cast<float>(x) / n;
+      float v = static_cast<float>(y) / n;
+      out.write(line, snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", u, 0.1f * std::sin(u * 20.f), v));
+      out.write(line, snprintf(line, sizeof(line), "vt %.6f %.6f\n", u, v));
+      out.write(line, snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", 0.f, 1.f, 0.f));
+    }
+  }
+  for(uint32_t y = 0; y < n; y++)
+  {
+    for(uint32_t x = 0; x < n; x++)
+    {
+      uint32_t a = y * (n + 1) + x + 1;  // OBJ indices start at 1
+      uint32_t b = a + 1;
+      uint32_t c = b + n + 1;
+      uint32_t d = a + n + 1;
+      int size =
+          snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c, d, d, d);
+      out.write(line, size);
+    }
+  }
+}